@@ -0,0 +1,364 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include "src/rmf_traffic/DetectConflictInternal.hpp"
+
+#include <rmf_traffic/Conflict.hpp>
+#include <rmf_traffic/geometry/Box.hpp>
+#include <rmf_traffic/geometry/Circle.hpp>
+#include <rmf_traffic/geometry/SimplePolygon.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// This executable measures the performance of the conflict detection kernels.
+// Each case is warmed up, then timed over a number of samples, where each
+// sample is the mean duration of a batch of calls. The results are printed
+// as one line per case, either as CSV (the default) or as JSON objects.
+//
+// Usage: benchmark_conflict [--samples N] [--batch N] [--warmup N] [--json]
+
+namespace {
+
+using namespace std::chrono_literals;
+
+//==============================================================================
+struct Settings
+{
+  std::size_t samples = 200;
+  std::size_t batch = 20;
+  std::size_t warmup = 50;
+  bool json = false;
+};
+
+//==============================================================================
+struct Statistics
+{
+  double min;
+  double p50;
+  double p90;
+  double p99;
+  double max;
+  double mean;
+};
+
+//==============================================================================
+Statistics compute_statistics(std::vector<double> samples)
+{
+  std::sort(samples.begin(), samples.end());
+  const auto percentile = [&](const double p) -> double
+  {
+    const std::size_t index = std::min(
+          samples.size()-1,
+          static_cast<std::size_t>(p * static_cast<double>(samples.size())));
+    return samples[index];
+  };
+
+  double total = 0.0;
+  for(const double s : samples)
+    total += s;
+
+  return Statistics{
+    samples.front(),
+    percentile(0.50),
+    percentile(0.90),
+    percentile(0.99),
+    samples.back(),
+    total / static_cast<double>(samples.size())
+  };
+}
+
+//==============================================================================
+class Reporter
+{
+public:
+
+  Reporter(const Settings& settings)
+    : _settings(settings)
+  {
+    if(!_settings.json)
+    {
+      std::cout << "kernel,shape_a,shape_b,segments,overlap,result,"
+                << "min_ns,p50_ns,p90_ns,p99_ns,max_ns,mean_ns" << std::endl;
+    }
+  }
+
+  void run(
+      const std::string& kernel,
+      const std::string& shape_a,
+      const std::string& shape_b,
+      const std::size_t segments,
+      const double overlap,
+      const std::function<bool()>& f)
+  {
+    bool result = false;
+    for(std::size_t i=0; i < _settings.warmup; ++i)
+      result = f();
+
+    std::vector<double> samples;
+    samples.reserve(_settings.samples);
+    for(std::size_t s=0; s < _settings.samples; ++s)
+    {
+      const auto start = std::chrono::steady_clock::now();
+      for(std::size_t i=0; i < _settings.batch; ++i)
+        result = f();
+      const auto finish = std::chrono::steady_clock::now();
+
+      const double ns = static_cast<double>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+              finish - start).count());
+      samples.push_back(ns / static_cast<double>(_settings.batch));
+    }
+
+    const Statistics stats = compute_statistics(std::move(samples));
+
+    if(_settings.json)
+    {
+      std::cout << "{\"kernel\": \"" << kernel
+                << "\", \"shape_a\": \"" << shape_a
+                << "\", \"shape_b\": \"" << shape_b
+                << "\", \"segments\": " << segments
+                << ", \"overlap\": " << overlap
+                << ", \"result\": " << (result? "true" : "false")
+                << ", \"min_ns\": " << stats.min
+                << ", \"p50_ns\": " << stats.p50
+                << ", \"p90_ns\": " << stats.p90
+                << ", \"p99_ns\": " << stats.p99
+                << ", \"max_ns\": " << stats.max
+                << ", \"mean_ns\": " << stats.mean
+                << "}" << std::endl;
+    }
+    else
+    {
+      std::cout << kernel << "," << shape_a << "," << shape_b << ","
+                << segments << "," << overlap << ","
+                << (result? 1 : 0) << ","
+                << stats.min << "," << stats.p50 << "," << stats.p90 << ","
+                << stats.p99 << "," << stats.max << "," << stats.mean
+                << std::endl;
+    }
+  }
+
+private:
+  Settings _settings;
+};
+
+//==============================================================================
+struct NamedConvexShape
+{
+  std::string name;
+  rmf_traffic::geometry::ConstFinalConvexShapePtr shape;
+};
+
+//==============================================================================
+struct NamedShape
+{
+  std::string name;
+  rmf_traffic::geometry::ConstFinalShapePtr shape;
+};
+
+//==============================================================================
+/// Make a trajectory that zig-zags along the x axis, spending one second on
+/// each segment.
+rmf_traffic::Trajectory make_trajectory(
+    const rmf_traffic::geometry::ConstFinalConvexShapePtr& shape,
+    const std::size_t num_segments,
+    const rmf_traffic::Time start_time,
+    const double y_offset)
+{
+  const auto profile = rmf_traffic::Trajectory::Profile::make_guided(shape);
+
+  rmf_traffic::Trajectory trajectory("test_map");
+  for(std::size_t i=0; i <= num_segments; ++i)
+  {
+    const double x = static_cast<double>(i);
+    const double y = y_offset + ((i%2 == 0)? 0.0 : 0.5);
+    trajectory.insert(
+          start_time + std::chrono::seconds(i),
+          profile,
+          Eigen::Vector3d(x, y, 0.0),
+          Eigen::Vector3d(1.0, 0.0, 0.0));
+  }
+
+  return trajectory;
+}
+
+//==============================================================================
+Settings parse_settings(int argc, char* argv[])
+{
+  Settings settings;
+  for(int i=1; i < argc; ++i)
+  {
+    const auto next = [&]() -> std::size_t
+    {
+      if(i+1 >= argc)
+      {
+        std::cerr << "Missing value for argument [" << argv[i] << "]"
+                  << std::endl;
+        std::exit(1);
+      }
+
+      return std::stoul(argv[++i]);
+    };
+
+    if(std::strcmp(argv[i], "--samples") == 0)
+      settings.samples = std::max<std::size_t>(1, next());
+    else if(std::strcmp(argv[i], "--batch") == 0)
+      settings.batch = std::max<std::size_t>(1, next());
+    else if(std::strcmp(argv[i], "--warmup") == 0)
+      settings.warmup = next();
+    else if(std::strcmp(argv[i], "--json") == 0)
+      settings.json = true;
+    else
+    {
+      std::cerr << "Unknown argument [" << argv[i] << "]\n"
+                << "Usage: " << argv[0]
+                << " [--samples N] [--batch N] [--warmup N] [--json]"
+                << std::endl;
+      std::exit(1);
+    }
+  }
+
+  return settings;
+}
+
+} // anonymous namespace
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+  using namespace rmf_traffic;
+
+  const Settings settings = parse_settings(argc, argv);
+  Reporter reporter(settings);
+
+  // Trajectory profiles must be convex, so only regions get to use the
+  // SimplePolygon.
+  const std::vector<NamedConvexShape> convex_shapes = {
+    {"circle", geometry::make_final_convex<geometry::Circle>(0.5)},
+    {"box", geometry::make_final_convex<geometry::Box>(1.0, 0.6)}
+  };
+
+  const std::vector<NamedShape> region_shapes = {
+    {"circle", geometry::make_final<geometry::Circle>(1.0)},
+    {"box", geometry::make_final<geometry::Box>(2.0, 1.0)},
+    {"polygon", geometry::make_final<geometry::SimplePolygon>(
+       std::vector<Eigen::Vector2d>{
+         {1.0, 1.0}, {0.0, 2.0}, {-1.0, 1.0}, {-1.0, -1.0}, {1.0, -1.0}})}
+  };
+
+  const std::vector<std::size_t> segment_counts = {1, 10, 50};
+  const std::vector<double> overlaps = {0.0, 0.5, 1.0};
+
+  const Time start_time = std::chrono::steady_clock::now();
+
+  for(const auto& shape_a : convex_shapes)
+  {
+    for(const auto& shape_b : convex_shapes)
+    {
+      for(const std::size_t segments : segment_counts)
+      {
+        for(const double overlap : overlaps)
+        {
+          // The overlap ratio is the fraction of the duration of trajectory_a
+          // that trajectory_b also occupies. With no overlap, trajectory_b
+          // starts one second after trajectory_a finishes.
+          const Duration duration = std::chrono::seconds(segments);
+          const Duration offset = overlap > 0.0?
+                std::chrono::duration_cast<Duration>((1.0 - overlap)*duration)
+              : duration + 1s;
+
+          const Trajectory trajectory_a = make_trajectory(
+                shape_a.shape, segments, start_time, 0.0);
+          const Trajectory trajectory_b = make_trajectory(
+                shape_b.shape, segments, start_time + offset, 0.3);
+
+          reporter.run("broad_phase", shape_a.name, shape_b.name,
+                       segments, overlap, [&]()
+          {
+            return DetectConflict::broad_phase(trajectory_a, trajectory_b);
+          });
+
+          reporter.run("between", shape_a.name, shape_b.name,
+                       segments, overlap, [&]()
+          {
+            return !DetectConflict::between(
+                  trajectory_a, trajectory_b).empty();
+          });
+
+          // The narrow phase is only valid for trajectories that overlap in
+          // time.
+          if(overlap > 0.0)
+          {
+            reporter.run("narrow_phase", shape_a.name, shape_b.name,
+                         segments, overlap, [&]()
+            {
+              return !DetectConflict::narrow_phase(
+                    trajectory_a, trajectory_b).empty();
+            });
+          }
+        }
+      }
+    }
+  }
+
+  for(const auto& shape : convex_shapes)
+  {
+    for(const auto& region_shape : region_shapes)
+    {
+      for(const std::size_t segments : segment_counts)
+      {
+        for(const double overlap : overlaps)
+        {
+          // Here the overlap ratio is the fraction of the trajectory's duration
+          // that is covered by the time bounds of the region.
+          const Trajectory trajectory = make_trajectory(
+                shape.shape, segments, start_time, 0.0);
+
+          const Duration duration = std::chrono::seconds(segments);
+          const Time lower_bound = overlap > 0.0?
+                start_time + std::chrono::duration_cast<Duration>(
+                  (1.0 - overlap)*duration)
+              : start_time + duration + 1s;
+          const Time upper_bound = lower_bound + duration;
+
+          internal::Spacetime region;
+          region.lower_time_bound = &lower_bound;
+          region.upper_time_bound = &upper_bound;
+          region.pose = Eigen::Isometry2d::Identity();
+          region.pose.translate(
+                Eigen::Vector2d(static_cast<double>(segments), 0.0));
+          region.shape = region_shape.shape;
+
+          reporter.run("detect_conflicts", shape.name, region_shape.name,
+                       segments, overlap, [&]()
+          {
+            return internal::detect_conflicts(trajectory, region, nullptr);
+          });
+        }
+      }
+    }
+  }
+
+  return 0;
+}
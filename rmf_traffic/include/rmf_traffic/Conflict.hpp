@@ -20,6 +20,8 @@
 
 #include <rmf_traffic/Trajectory.hpp>
 #include <exception>
+#include <utility>
+#include <vector>
 
 namespace rmf_traffic {
 
@@ -106,6 +108,58 @@ public:
       const bool quit_after_one = false);
   // TODO(MXG): Replace quit_after_one with a DetectConflict::Options class
 
+  /// Checks if there are any conflicts between the two Trajectory views. Only
+  /// the motions that take place within both of the time windows will be
+  /// checked.
+  ///
+  /// The Trajectory of each View must have at least 2 segments, just like the
+  /// Trajectory overload of this function.
+  static std::vector<ConflictData> between(
+      const Trajectory::View& view_a,
+      const Trajectory::View& view_b,
+      const bool quit_after_one = false);
+
+  /// Checks if there is any overlap in the map name and time windows of the
+  /// two Trajectory views.
+  static bool broad_phase(
+      const Trajectory::View& view_a,
+      const Trajectory::View& view_b);
+
+  /// Same as the Trajectory overload of narrow_phase(), except the check will
+  /// be restricted to the time windows of the views. The same assumptions
+  /// apply, except that an empty view is allowed and will never have any
+  /// conflicts.
+  static std::vector<ConflictData> narrow_phase(
+      const Trajectory::View& view_a,
+      const Trajectory::View& view_b,
+      const bool quit_after_one = false);
+
+  /// A pair of indices into a list of Trajectories. The first index is always
+  /// less than the second.
+  using IndexPair = std::pair<std::size_t, std::size_t>;
+
+  /// Find every pair of Trajectories in the list that are in conflict with
+  /// each other.
+  ///
+  /// Instead of testing every possible pair, the Trajectories are grouped by
+  /// map and swept in order of their start times, and only pairs whose time
+  /// spans and spatial extents both overlap will be handed to between().
+  ///
+  /// \param[in] trajectories
+  ///   The Trajectories to check. None of these may be a nullptr, and each must
+  ///   have at least 2 segments.
+  ///
+  /// \param[in] num_threads
+  ///   The number of threads that should be used to run the narrow phase on
+  ///   the candidate pairs. A value of 0 or 1 will run everything on the
+  ///   calling thread.
+  ///
+  /// \return the pairs of indices of conflicting Trajectories, sorted in
+  /// ascending order.
+  static std::vector<IndexPair> all_pairs(
+      const std::vector<const Trajectory*>& trajectories,
+      std::size_t num_threads = 1);
+
   class Implementation;
 };
 
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef RMF_TRAFFIC__SERIALIZATION_HPP
+#define RMF_TRAFFIC__SERIALIZATION_HPP
+
+#include <rmf_traffic/Trajectory.hpp>
+#include <rmf_traffic/schedule/Database.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace rmf_traffic {
+namespace serialization {
+
+//==============================================================================
+/// The version of the binary format that is produced by the encode()
+/// functions. Buffers with a newer format version will be rejected by the
+/// decode functions.
+constexpr uint8_t FormatVersion = 1;
+
+//==============================================================================
+/// A buffer of encoded bytes
+using Buffer = std::vector<uint8_t>;
+
+//==============================================================================
+/// Options that influence how data gets encoded. Decoding does not need any
+/// options, because the choices that were made are stored in the buffer.
+class Options
+{
+public:
+
+  /// Constructor
+  ///
+  /// \param[in] position_resolution
+  ///   The resolution that positions and velocities will be quantized to. Use
+  ///   0.0 to encode them losslessly.
+  Options(double position_resolution = 0.0);
+
+  /// Set the resolution that positions and velocities will be quantized to.
+  /// This applies to each component, so it is in meters for translational
+  /// values and radians for rotational values. When this is greater than 0.0,
+  /// every value will be rounded to the nearest multiple of the resolution,
+  /// and positions will be stored as deltas from the previous segment, which
+  /// usually makes the encoding several times smaller. Use 0.0 (the default)
+  /// to store the exact values.
+  Options& position_resolution(double resolution);
+
+  /// Get the resolution that positions and velocities will be quantized to.
+  double position_resolution() const;
+
+  class Implementation;
+private:
+  rmf_utils::impl_ptr<Implementation> _pimpl;
+};
+
+//==============================================================================
+/// Encode a Trajectory into a compact binary buffer.
+///
+/// Only Box and Circle profile shapes are supported. A std::runtime_error will
+/// be thrown if the trajectory uses any other kind of shape, or if a position
+/// or velocity is too large to be quantized with the position_resolution of
+/// the options.
+Buffer encode(const Trajectory& trajectory, const Options& options = Options());
+
+/// Encode a Database::Change into a compact binary buffer.
+///
+/// A std::runtime_error will be thrown if the Change refers to a nullptr
+/// trajectory.
+Buffer encode(
+    const schedule::Database::Change& change,
+    const Options& options = Options());
+
+/// Encode a Database::Patch into a compact binary buffer. The profiles of all
+/// the trajectories in the Patch will be stored in one shared table, so they
+/// are only encoded once.
+Buffer encode(
+    const schedule::Database::Patch& patch,
+    const Options& options = Options());
+
+//==============================================================================
+/// Decode a Trajectory from a buffer that was produced by encode(). Segments
+/// are written directly into the storage of the new Trajectory, and segments
+/// that use the same profile will share a single Profile object.
+///
+/// A std::runtime_error will be thrown if the buffer is malformed, does not
+/// contain a Trajectory, or uses a newer FormatVersion.
+Trajectory decode_trajectory(const uint8_t* data, std::size_t size);
+
+/// Overload of decode_trajectory() for a whole buffer.
+Trajectory decode_trajectory(const Buffer& buffer);
+
+/// Decode a Database::Change from a buffer that was produced by encode().
+schedule::Database::Change decode_change(const uint8_t* data, std::size_t size);
+
+/// Overload of decode_change() for a whole buffer.
+schedule::Database::Change decode_change(const Buffer& buffer);
+
+/// Decode a Database::Patch from a buffer that was produced by encode().
+schedule::Database::Patch decode_patch(const uint8_t* data, std::size_t size);
+
+/// Overload of decode_patch() for a whole buffer.
+schedule::Database::Patch decode_patch(const Buffer& buffer);
+
+} // namespace serialization
+} // namespace rmf_traffic
+
+#endif // RMF_TRAFFIC__SERIALIZATION_HPP
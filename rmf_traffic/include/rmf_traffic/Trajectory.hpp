@@ -39,6 +39,15 @@ class TrajectoryIteratorImplementation;
 } // namespace detail
 
 //==============================================================================
+/// A sequence of Segments that describes the motion of a robot on one map.
+///
+/// Copies of a Trajectory share their Segment data until one of them gets
+/// modified, at which point the one being modified makes its own copy of the
+/// data. This sharing is thread-safe: different Trajectory objects may be read,
+/// modified, or destroyed on different threads at the same time, even if they
+/// are copies of each other. As with standard containers, a single Trajectory
+/// object may be read from several threads at once, but it must not be
+/// modified while any other thread is using it.
 class Trajectory
 {
 public:
@@ -346,6 +355,40 @@ public:
   /// Insert a copy of another Trajectory's Segment into this one.
   InsertionResult insert(const Segment& other);
 
+  /// Add a Segment to this Trajectory without getting back an iterator to it.
+  ///
+  /// This has the same effect as insert(), but it is meant for building up a
+  /// Trajectory whose Segments are already in time order. A Segment that
+  /// finishes after the current last Segment is simply added to the end, and
+  /// because no iterator is returned, the Trajectory does not need to set up
+  /// any of its iterator bookkeeping until it is actually inspected.
+  ///
+  /// Segments that are out of order will still be inserted in the correct
+  /// place, and a Segment whose finish_time matches an existing Segment will
+  /// be ignored, exactly like insert().
+  void push_back(
+      Time finish_time,
+      ConstProfilePtr profile,
+      Eigen::Vector3d position,
+      Eigen::Vector3d velocity);
+
+  /// Make room for the Trajectory to hold the given number of Segments without
+  /// needing to reallocate its storage.
+  void reserve(std::size_t size);
+
+  /// Join a copy of another Trajectory onto the end of this one.
+  ///
+  /// If the first Segment of other finishes at the exact same time as the
+  /// last Segment of this Trajectory, that is treated as the point where the
+  /// two Trajectories join, and the Segment of this Trajectory is kept.
+  ///
+  /// \warning Apart from that joining point, every Segment of other must
+  /// finish after this Trajectory finishes, or else a std::invalid_argument
+  /// exception will be thrown and this Trajectory will be left unchanged.
+  ///
+  /// \note The map name of this Trajectory is not changed.
+  Trajectory& append(const Trajectory& other);
+
   /// Find the Segment of this Trajectory that is active during the given time.
   ///
   /// \note This will return Trajectory::end() if the time is before the
@@ -361,6 +404,38 @@ public:
   /// const-qualified version of find()
   const_iterator find(Time time) const;
 
+  /// Find the Segment of this Trajectory that is active during the given time,
+  /// starting the search from a hint. This gives the same result as
+  /// find(time), but it takes constant time when the answer is at or near the
+  /// hint. When scanning through a Trajectory with increasing times, pass in
+  /// the iterator that was found for the previous time.
+  ///
+  /// \param[in] time
+  ///   The time of interest.
+  ///
+  /// \param[in] hint
+  ///   Where to start searching from. Any iterator of this Trajectory,
+  ///   including end(), is a valid hint.
+  iterator find(Time time, const_iterator hint);
+
+  /// const-qualified version of find(Time, const_iterator)
+  const_iterator find(Time time, const_iterator hint) const;
+
+  /// Compute the position of this Trajectory at each of the given times. The
+  /// times may come in any order, but sorted times are the fastest, because
+  /// each lookup starts from where the previous one ended.
+  ///
+  /// \warning A std::invalid_argument exception will be thrown if any of the
+  /// times are outside of the range [start_time(), finish_time()], or if this
+  /// Trajectory is empty.
+  ///
+  /// \param[in] times
+  ///   The times to sample.
+  ///
+  /// \return the positions at each of the times, in the same order.
+  std::vector<Eigen::Vector3d> sample_positions(
+      const std::vector<Time>& times) const;
+
   /// Erase the specified segment.
   ///
   /// \return an iterator following the last removed element
@@ -435,6 +510,10 @@ public:
   /// detection, the Trajectory must have a size of at least 2.
   std::size_t size() const;
 
+  /// A non-owning view of the part of a Trajectory that falls within a window
+  /// of time. See the definition of Trajectory::View below.
+  class View;
+
   /// \internal Used internally by unit and integration tests so we can test
   /// private imeplementation details.
   class Debug;
@@ -537,6 +616,69 @@ struct Trajectory::InsertionResult
   bool inserted;
 };
 
+//==============================================================================
+/// A View refers to the part of an existing Trajectory that falls within a
+/// window of time, without copying any of the Trajectory's data. This can be
+/// used to restrict expensive operations, like conflict detection, to only the
+/// relevant portion of a Trajectory.
+///
+/// The View contains every Segment whose motion overlaps the time window,
+/// including the Segment whose motion carries the Trajectory past the end of
+/// the window.
+///
+/// \warning A View holds a reference to its Trajectory, so the Trajectory must
+/// outlive the View, and the View must not be used after the Trajectory has
+/// been modified.
+class Trajectory::View
+{
+public:
+
+  /// View an entire Trajectory
+  View(const Trajectory& trajectory);
+
+  /// View the part of a Trajectory that falls within [start, finish]. The
+  /// window will be clipped to the time span of the Trajectory.
+  View(const Trajectory& trajectory, Time start, Time finish);
+
+  /// Get the Trajectory that is being viewed
+  const Trajectory& get_trajectory() const;
+
+  /// Get the time that this View starts, which is the later of the requested
+  /// start time and the start of the Trajectory. This will return a nullptr if
+  /// the View is empty.
+  const Time* start_time() const;
+
+  /// Get the time that this View finishes, which is the earlier of the
+  /// requested finish time and the finish of the Trajectory. This will return
+  /// a nullptr if the View is empty.
+  const Time* finish_time() const;
+
+  /// Get the duration of the time window of this View.
+  Duration duration() const;
+
+  /// Get an iterator to the first Segment in the View. If the window starts
+  /// after the Trajectory starts, this is the Segment whose motion is active at
+  /// the start of the window.
+  const_iterator begin() const;
+
+  /// Get an iterator to the element after the last Segment in the View.
+  const_iterator end() const;
+
+  /// Get the number of Segments in the View.
+  std::size_t size() const;
+
+  /// True if the View does not overlap the Trajectory at all.
+  bool empty() const;
+
+private:
+  // A View is meant to be cheap to create and pass around, so unlike most
+  // classes in this library it does not keep its fields behind a pimpl.
+  const Trajectory* _trajectory;
+  Time _start;
+  Time _finish;
+  bool _empty;
+};
+
 } // namespace rmf_traffic
 
 #endif // RMF_TRAFFIC__TRAJECTORY_HPP
@@ -173,6 +173,17 @@ public:
     /// Get the set of schedule IDs that should be ignored.
     std::unordered_set<schedule::Version> ignore_schedule_ids() const;
 
+    /// Set the number of threads that the planner may use when checking a
+    /// candidate trajectory against the schedule. When this is greater than 1,
+    /// the planner will keep a small pool of worker threads alive while it is
+    /// planning, and large schedule views will be split across them. The
+    /// resulting plan is the same regardless of this setting. The default is
+    /// 1, which means all validation happens on the planning thread.
+    Options& validation_threads(std::size_t num_threads);
+
+    /// Get the number of threads that the planner may use for validation.
+    std::size_t validation_threads() const;
+
     class Implementation;
   private:
     rmf_utils::impl_ptr<Implementation> _pimpl;
@@ -22,6 +22,8 @@
 
 #include <rmf_utils/macros.hpp>
 
+#include <unordered_set>
+
 namespace rmf_traffic {
 namespace schedule {
 
@@ -356,6 +358,69 @@ public:
     rmf_utils::impl_ptr<Implementation> _pimpl;
   };
 
+  /// A set of changes that can be applied to a Database all at once. The
+  /// functions of a Batch take the same arguments as the Database functions
+  /// with the same names. A change in the Batch may refer to the version that
+  /// an earlier change in the same Batch will produce.
+  ///
+  /// \sa apply()
+  class Batch
+  {
+  public:
+
+    /// Create an empty Batch
+    Batch();
+
+    /// Add an insertion to this Batch.
+    Batch& insert(Trajectory trajectory);
+
+    /// Add an interruption to this Batch.
+    Batch& interrupt(
+        Version id,
+        Trajectory interruption_trajectory,
+        Duration delay);
+
+    /// Add a delay to this Batch.
+    Batch& delay(Version id, Time from, Duration delay);
+
+    /// Add a replacement to this Batch.
+    Batch& replace(Version previous_id, Trajectory trajectory);
+
+    /// Add an erasure to this Batch.
+    Batch& erase(Version id);
+
+    /// Get the number of changes in this Batch.
+    std::size_t size() const;
+
+    class Implementation;
+  private:
+    rmf_utils::impl_ptr<Implementation> _pimpl;
+  };
+
+  /// An immutable copy of the latest version of each Trajectory in a Database
+  /// that has not been erased. A Snapshot can be queried from any thread, even
+  /// while the Database that it came from keeps changing, and the Views that
+  /// it produces stay valid for as long as they exist. Copying a Snapshot is
+  /// cheap, and its data is released once the last copy is gone.
+  ///
+  /// \sa snapshot()
+  class Snapshot
+  {
+  public:
+
+    /// Query this Snapshot for the Trajectories that match the parameters.
+    /// Unlike Viewer::query(), the View will never contain erasures.
+    Viewer::View query(const Query& parameters) const;
+
+    /// Get the version of the Database when this Snapshot was taken.
+    Version latest_version() const;
+
+    class Implementation;
+  private:
+    Snapshot();
+    rmf_utils::impl_ptr<Implementation> _pimpl;
+  };
+
   /// Initialize a Database
   Database();
 
@@ -444,6 +509,35 @@ public:
   /// \return the new version of this database.
   Version erase(Version id);
 
+  /// Apply a whole Batch of changes to this Database. Each change gets the
+  /// next version number in the order that it was added to the Batch, exactly
+  /// as if the individual functions had been called one after another. Every
+  /// change is checked before any of them are applied, so if one of them
+  /// refers to a version that does not exist, an exception will be thrown and
+  /// the Database will not be modified.
+  ///
+  /// This is faster than making the changes one at a time, especially when
+  /// the same Trajectory gets changed more than once in the Batch, because
+  /// the spatial and temporal indexes only get updated for the final result.
+  ///
+  /// \return The new version of this database.
+  Version apply(Batch batch);
+
+  /// Take a Snapshot of the current state of this Database. Like every other
+  /// function of the Database, this must not be called while the Database is
+  /// being changed, but the Snapshot itself can be used at any time
+  /// afterwards.
+  ///
+  /// Only the maps that have changed since the last Snapshot was taken need to
+  /// be copied, and no copying is needed at all if nothing has changed.
+  Snapshot snapshot() const;
+
+  /// Take a Snapshot of only some of the maps in this Database. Queries of the
+  /// Snapshot will not find anything on the other maps. This is cheaper than
+  /// snapshot() when other maps have changed, because their changes do not
+  /// need to be copied.
+  Snapshot snapshot(const std::unordered_set<std::string>& maps) const;
+
   /// Throw away all Trajectories up to the specified time.
   ///
   /// \param[in] time
@@ -455,6 +549,26 @@ public:
   /// this version number will remain the same.
   Version cull(Time time);
 
+  /// Tell the Database about the oldest version that any remote mirror still
+  /// needs to be updated from. Every remote mirror that has received at least
+  /// this version can keep being updated incrementally. Once this has been
+  /// set, the Database will periodically discard the versions of each
+  /// Trajectory that such a mirror could no longer know about, so a lineage
+  /// that gets changed many times only keeps its recent history.
+  ///
+  /// A remote mirror that is further behind than this version will not be
+  /// updated correctly and should be rebuilt from scratch. A mirror that does
+  /// not know about any version yet is always safe.
+  ///
+  /// By default the whole history of each Trajectory is kept until it gets
+  /// culled.
+  void set_oldest_needed_version(Version version);
+
+  /// Set how many new versions will be added to the Database between each
+  /// compaction of its history. The default is 100. This has no effect until
+  /// set_oldest_needed_version() has been called.
+  void set_compaction_interval(std::size_t versions);
+
 };
 
 } // namespace schedule
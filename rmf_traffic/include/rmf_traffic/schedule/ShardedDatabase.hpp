@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef RMF_TRAFFIC__SCHEDULE__SHARDEDDATABASE_HPP
+#define RMF_TRAFFIC__SCHEDULE__SHARDEDDATABASE_HPP
+
+#include <rmf_traffic/schedule/Database.hpp>
+
+#include <rmf_utils/impl_ptr.hpp>
+
+#include <unordered_set>
+
+namespace rmf_traffic {
+namespace schedule {
+
+//==============================================================================
+/// A schedule database that keeps the Trajectories of each map in a separate
+/// shard. Every shard has its own timeline, entry index, change history and
+/// lock, so changes to different maps can be made from different threads at
+/// the same time. Version numbers still come from one counter that is shared
+/// by every shard, and changes() merges the history of the shards into a
+/// single Patch, so a Mirror can be kept up to date with it exactly like it
+/// would be with a Database.
+///
+/// Unlike a Database, every function of this class is safe to call from any
+/// thread at any time.
+///
+/// A replacement that moves a Trajectory onto a different map is reported by
+/// changes() as an erasure on the old map and an insertion on the new map that
+/// both have the version of the replacement.
+class ShardedDatabase
+{
+public:
+
+  using Change = Database::Change;
+  using Patch = Database::Patch;
+  using Batch = Database::Batch;
+  using Snapshot = Database::Snapshot;
+
+  /// Initialize a ShardedDatabase
+  ShardedDatabase();
+
+  /// Get the changes in this database that match the given Query parameters.
+  /// Only the shards of the maps that the Query refers to will be locked.
+  Patch changes(const Query& parameters) const;
+
+  /// Insert a Trajectory into the shard of its map.
+  ///
+  /// \return The database id for this new Trajectory.
+  Version insert(Trajectory trajectory);
+
+  /// Interrupt a Trajectory. This works the same as Database::interrupt().
+  ///
+  /// \return The updated ID for this modified Trajectory.
+  Version interrupt(
+      Version id,
+      Trajectory interruption_trajectory,
+      Duration delay);
+
+  /// Delay a Trajectory. This works the same as Database::delay().
+  ///
+  /// \return The updated ID for this modified Trajectory.
+  Version delay(
+      Version id,
+      Time from,
+      Duration delay);
+
+  /// Replace an existing Trajectory with a new one, which may be on a
+  /// different map.
+  ///
+  /// \return The updated ID of the revised trajectory.
+  Version replace(Version previous_id, Trajectory trajectory);
+
+  /// Erase a Trajectory from this database.
+  ///
+  /// \return The new version of this database.
+  Version erase(Version id);
+
+  /// Apply a whole Batch of changes. Only the shards that the Batch touches
+  /// get locked, and the changes receive one consecutive block of versions in
+  /// the order that they were added to the Batch. Every change is checked
+  /// before any of them are applied, so if one of them refers to a version
+  /// that does not exist, an exception will be thrown and the database will
+  /// not be modified.
+  ///
+  /// \warning Unlike Database::apply(), a change in the Batch cannot refer to
+  /// the version that an earlier change in the same Batch will produce,
+  /// because other threads may take versions in the meantime.
+  ///
+  /// \return The last version that was given to the Batch.
+  Version apply(Batch batch);
+
+  /// Take a Snapshot of every shard at once.
+  Snapshot snapshot() const;
+
+  /// Take a Snapshot of only some maps. Only the shards of those maps will be
+  /// locked.
+  Snapshot snapshot(const std::unordered_set<std::string>& maps) const;
+
+  /// Query this database for the Trajectories that match the parameters. Like
+  /// Snapshot::query(), the View will never contain erasures.
+  Viewer::View query(const Query& parameters) const;
+
+  /// Get the oldest version that any shard still has an entry for. If the
+  /// database is empty, this is the latest version.
+  Version oldest_version() const;
+
+  /// Get the latest version that has been given to any change. A change that
+  /// is still being applied by another thread might already have a version.
+  Version latest_version() const;
+
+  /// Set the size of the cells of the spatial index of every shard.
+  ///
+  /// \sa Viewer::set_spatial_cell_size()
+  void set_spatial_cell_size(double cell_size);
+
+  /// Get the size of the cells of the spatial index.
+  double get_spatial_cell_size() const;
+
+  /// Throw away all Trajectories up to the specified time. Every shard gets
+  /// locked while this happens.
+  ///
+  /// \return The new version of the schedule database. If nothing was culled,
+  /// this version number will remain the same.
+  Version cull(Time time);
+
+  /// Tell every shard about the oldest version that any remote mirror still
+  /// needs to be updated from.
+  ///
+  /// \sa Database::set_oldest_needed_version()
+  void set_oldest_needed_version(Version version);
+
+  /// Set how many new versions each shard will add between each compaction of
+  /// its history.
+  ///
+  /// \sa Database::set_compaction_interval()
+  void set_compaction_interval(std::size_t versions);
+
+  class Implementation;
+private:
+  rmf_utils::unique_impl_ptr<Implementation> _pimpl;
+};
+
+} // namespace schedule
+} // namespace rmf_traffic
+
+#endif // RMF_TRAFFIC__SCHEDULE__SHARDEDDATABASE_HPP
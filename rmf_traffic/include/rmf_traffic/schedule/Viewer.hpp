@@ -88,6 +88,25 @@ public:
   /// Get the latest version number of this Database.
   Version latest_version() const;
 
+  /// Set the size of the cells of the spatial index for this Viewer. When the
+  /// size is greater than zero, each map gets a 2D grid of square cells with
+  /// this side length, in meters. Each trajectory is sorted into the cells
+  /// that its bounding box overlaps. After that, region queries only inspect
+  /// the trajectories that are in the same cells as the region. Smaller cells
+  /// give tighter results for small regions but use more memory. Something
+  /// close to the size of a typical query region is a good starting point.
+  ///
+  /// The default is 0.0, which disables the spatial index, so queries only
+  /// filter trajectories by time. Changing this value will rebuild the index.
+  ///
+  /// \warning A std::invalid_argument exception will be thrown if the size is
+  /// negative or not finite.
+  void set_spatial_cell_size(double cell_size);
+
+  /// Get the size of the cells of the spatial index. This is 0.0 when the
+  /// spatial index is disabled.
+  double get_spatial_cell_size() const;
+
 
   // The Debug class is for internal testing use only. Its definition is not
   // visible to downstream users.
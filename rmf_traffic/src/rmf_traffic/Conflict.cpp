@@ -22,10 +22,18 @@
 
 #include <rmf_traffic/Conflict.hpp>
 
+#include <rmf_utils/optional.hpp>
+
 #include <fcl/continuous_collision.h>
 #include <fcl/ccd/motion.h>
 
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
 namespace rmf_traffic {
 
@@ -114,22 +122,28 @@ std::vector<ConflictData> DetectConflict::between(
     const Trajectory& trajectory_b,
     const bool quit_after_one)
 {
-  if(!broad_phase(trajectory_a, trajectory_b))
+  return between(
+        Trajectory::View(trajectory_a),
+        Trajectory::View(trajectory_b),
+        quit_after_one);
+}
+
+//==============================================================================
+std::vector<ConflictData> DetectConflict::between(
+    const Trajectory::View& view_a,
+    const Trajectory::View& view_b,
+    const bool quit_after_one)
+{
+  if(!broad_phase(view_a, view_b))
     return {};
 
-  return narrow_phase(trajectory_a, trajectory_b, quit_after_one);
+  return narrow_phase(view_a, view_b, quit_after_one);
 }
 
 //==============================================================================
 
 namespace {
 
-struct BoundingBox
-{
-  Eigen::Vector2d min;
-  Eigen::Vector2d max;
-};
-
 double evaluate_spline(
     const Eigen::Vector4d& coeffs,
     const double t)
@@ -196,7 +210,11 @@ std::array<double, 2> get_local_extrema(
   return extrema;
 }
 
-BoundingBox get_bounding_box(const rmf_traffic::Spline& spline)
+} // anonymous namespace
+
+namespace internal {
+//==============================================================================
+BoundingBox get_bounding_box(const Spline& spline)
 {
   BoundingBox bounding_box;
 
@@ -220,6 +238,7 @@ BoundingBox get_bounding_box(const rmf_traffic::Spline& spline)
   return bounding_box;
 }
 
+//==============================================================================
 bool overlap(const BoundingBox& box_a, const BoundingBox& box_b)
 {
   for (std::size_t i=0; i < 2; ++i)
@@ -234,6 +253,44 @@ bool overlap(const BoundingBox& box_a, const BoundingBox& box_b)
   return true;
 }
 
+//==============================================================================
+BoundingBox get_bounding_box(const Trajectory& trajectory)
+{
+  auto it = ++trajectory.begin();
+  BoundingBox box = get_bounding_box(Spline(it));
+  for(++it; it != trajectory.end(); ++it)
+  {
+    const BoundingBox segment_box = get_bounding_box(Spline(it));
+    box.min = box.min.cwiseMin(segment_box.min);
+    box.max = box.max.cwiseMax(segment_box.max);
+  }
+
+  return box;
+}
+
+//==============================================================================
+BoundingBox get_bounding_box(
+    const Eigen::Isometry2d& pose,
+    const geometry::FinalShape& shape)
+{
+  // The characteristic length is the radius of a circle around the origin of
+  // the shape which contains the whole shape, so it gives a conservative box.
+  const double char_length = shape.get_characteristic_length();
+  assert(char_length >= 0.0);
+
+  const Eigen::Vector2d p = pose.translation();
+  const Eigen::Vector2d r{char_length, char_length};
+  return BoundingBox{p - r, p + r};
+}
+
+} // namespace internal
+
+namespace {
+
+using internal::BoundingBox;
+using internal::get_bounding_box;
+using internal::overlap;
+
 //==============================================================================
 std::shared_ptr<fcl::SplineMotion> make_uninitialized_fcl_spline_motion()
 {
@@ -251,47 +308,45 @@ std::shared_ptr<fcl::SplineMotion> make_uninitialized_fcl_spline_motion()
 }
 
 //==============================================================================
-std::tuple<Trajectory::const_iterator, Trajectory::const_iterator>
-get_initial_iterators(
-    const Trajectory& trajectory_a,
-    const Trajectory& trajectory_b)
+void check_segment_num(
+    const Trajectory::View& view_a,
+    const Trajectory::View& view_b)
 {
-  std::size_t min_size = std::min(trajectory_a.size(), trajectory_b.size());
+  const std::size_t min_size = std::min(
+        view_a.get_trajectory().size(), view_b.get_trajectory().size());
   if(min_size < 2)
   {
     throw invalid_trajectory_error::Implementation
         ::make_segment_num_error(min_size);
   }
+}
 
-  const Time& t_a0 = *trajectory_a.start_time();
-  const Time& t_b0 = *trajectory_b.start_time();
+//==============================================================================
+/// Get the first Segment whose motion is in effect at the given time. The
+/// first Segment of a Trajectory never has any motion leading up to it, so it
+/// always gets skipped.
+Trajectory::const_iterator first_motion(
+    const Trajectory::View& view,
+    const Time time)
+{
+  const Trajectory& trajectory = view.get_trajectory();
+  if(time <= *trajectory.start_time())
+    return ++trajectory.begin();
 
-  Trajectory::const_iterator a_it;
-  Trajectory::const_iterator b_it;
+  return trajectory.find(time);
+}
 
-  if(t_a0 < t_b0)
-  {
-    // Trajectory `a` starts first, so we begin evaluating at the time
-    // that `b` begins
-    a_it = trajectory_a.find(t_b0);
-    b_it = ++trajectory_b.begin();
-  }
-  else if(t_b0 < t_a0)
-  {
-    // Trajectory `b` starts first, so we begin evaluating at the time
-    // that `a` begins
-    a_it = ++trajectory_a.begin();
-    b_it = trajectory_b.find(t_a0);
-  }
-  else
-  {
-    // The Trajectories begin at the exact same time, so both will begin
-    // from their start
-    a_it = ++trajectory_a.begin();
-    b_it = ++trajectory_b.begin();
-  }
+//==============================================================================
+std::tuple<Trajectory::const_iterator, Trajectory::const_iterator>
+get_initial_iterators(
+    const Trajectory::View& view_a,
+    const Trajectory::View& view_b)
+{
+  check_segment_num(view_a, view_b);
 
-  return {a_it, b_it};
+  // We begin evaluating at the time when both views have started
+  const Time start_time = std::max(*view_a.start_time(), *view_b.start_time());
+  return {first_motion(view_a, start_time), first_motion(view_b, start_time)};
 }
 
 //==============================================================================
@@ -304,49 +359,123 @@ fcl::ContinuousCollisionRequest make_fcl_request()
   return request;
 }
 
+//==============================================================================
+/// A ContinuousCollisionObject that gets rebuilt only when the collision
+/// geometry it refers to changes. The motion that it refers to is owned by the
+/// ConflictWorkspace and gets updated in-place.
+class CachedCollisionObject
+{
+public:
+
+  const fcl::ContinuousCollisionObject& get(
+      const geometry::CollisionGeometryPtr& geometry,
+      const std::shared_ptr<fcl::MotionBase>& motion)
+  {
+    // The cached object holds a shared reference to its geometry, so the
+    // address cannot be recycled by a different geometry while it is cached.
+    if(!_object || _geometry != geometry.get())
+    {
+      _object = fcl::ContinuousCollisionObject(geometry, motion);
+      _geometry = geometry.get();
+    }
+
+    return *_object;
+  }
+
+private:
+  const fcl::CollisionGeometry* _geometry = nullptr;
+  rmf_utils::optional<fcl::ContinuousCollisionObject> _object;
+};
+
+//==============================================================================
+/// The FCL objects that are needed by the narrow phase of conflict detection.
+/// These are expensive to allocate, and conflict detection gets called very
+/// frequently by the planner, so we keep one workspace per thread and reuse it
+/// across calls.
+struct ConflictWorkspace
+{
+  ConflictWorkspace()
+    : motion_a(make_uninitialized_fcl_spline_motion()),
+      motion_b(make_uninitialized_fcl_spline_motion()),
+      motion_region(std::make_shared<internal::StaticMotion>()),
+      request(make_fcl_request())
+  {
+    // Do nothing
+  }
+
+  std::shared_ptr<fcl::SplineMotion> motion_a;
+  std::shared_ptr<fcl::SplineMotion> motion_b;
+  std::shared_ptr<internal::StaticMotion> motion_region;
+
+  CachedCollisionObject object_a;
+  CachedCollisionObject object_b;
+  std::vector<CachedCollisionObject> objects_region;
+
+  const fcl::ContinuousCollisionRequest request;
+
+  static ConflictWorkspace& get()
+  {
+    static thread_local ConflictWorkspace workspace;
+    return workspace;
+  }
+};
+
 } // anonymous namespace
 
+//==============================================================================
 bool DetectConflict::broad_phase(
     const Trajectory& trajectory_a,
     const Trajectory& trajectory_b)
 {
-  std::size_t min_size = std::min(trajectory_a.size(), trajectory_b.size());
-  if(min_size < 2)
-  {
-    throw invalid_trajectory_error::Implementation
-        ::make_segment_num_error(min_size);
-  }
+  return broad_phase(
+        Trajectory::View(trajectory_a), Trajectory::View(trajectory_b));
+}
+
+//==============================================================================
+bool DetectConflict::broad_phase(
+    const Trajectory::View& view_a,
+    const Trajectory::View& view_b)
+{
+  check_segment_num(view_a, view_b);
+
+  const Trajectory& trajectory_a = view_a.get_trajectory();
+  const Trajectory& trajectory_b = view_b.get_trajectory();
 
   if(trajectory_a.get_map_name() != trajectory_b.get_map_name())
     return false;
 
-  const auto* t_a0 = trajectory_a.start_time();
-  const auto* t_bf = trajectory_b.finish_time();
+  if(view_a.empty() || view_b.empty())
+  {
+    // One of the views does not cover any part of its trajectory, so there is
+    // nothing that could conflict.
+    return false;
+  }
 
-  // Neither of these can be null, because both trajectories should have at
-  // least two elements.
+  const auto* t_a0 = view_a.start_time();
+  const auto* t_bf = view_b.finish_time();
+
+  // Neither of these can be null, because both views are non-empty.
   assert(t_a0 != nullptr);
   assert(t_bf != nullptr);
 
   if(*t_bf < *t_a0)
   {
-    // If Trajectory `b` finishes before Trajectory `a` starts, then there
-    // cannot be any conflict.
+    // If View `b` finishes before View `a` starts, then there cannot be any
+    // conflict.
     return false;
   }
 
-  const auto* t_b0 = trajectory_b.start_time();
-  const auto* t_af = trajectory_a.finish_time();
+  const auto* t_b0 = view_b.start_time();
+  const auto* t_af = view_a.finish_time();
 
-  // Neither of these can be null, because both trajectories should have at
-  // least two elements.
+  // Neither of these can be null, because both views are non-empty.
   assert(t_b0 != nullptr);
   assert(t_af != nullptr);
 
   if(*t_af < *t_b0)
   {
-    // If Trajectory `a` finished before Trajectory `b` starts, then there
-    // cannot be any conflict.
+    // If View `a` finished before View `b` starts, then there cannot be any
+    // conflict.
     return false;
   }
 
@@ -354,14 +483,17 @@ bool DetectConflict::broad_phase(
   // bounding boxes
   Trajectory::const_iterator a_it;
   Trajectory::const_iterator b_it;
-  std::tie(a_it, b_it) = get_initial_iterators(trajectory_a, trajectory_b);
+  std::tie(a_it, b_it) = get_initial_iterators(view_a, view_b);
   assert(a_it != trajectory_a.end());
   assert(b_it != trajectory_b.end());
 
+  const Trajectory::const_iterator a_end = view_a.end();
+  const Trajectory::const_iterator b_end = view_b.end();
+
   Spline spline_a(a_it);
   Spline spline_b(b_it);
 
-  while(a_it != trajectory_a.end() && b_it != trajectory_b.end())
+  while(a_it != a_end && b_it != b_end)
   {
     // Increment a_it until spline_a will overlap with spline_b
     if(a_it->get_finish_time() < spline_b.start_time())
@@ -422,31 +554,73 @@ std::vector<ConflictData> DetectConflict::narrow_phase(
     const Trajectory& trajectory_b,
     const bool quit_after_one)
 {
+  return narrow_phase(
+        Trajectory::View(trajectory_a),
+        Trajectory::View(trajectory_b),
+        quit_after_one);
+}
+
+//==============================================================================
+std::vector<ConflictData> DetectConflict::narrow_phase(
+    const Trajectory::View& view_a,
+    const Trajectory::View& view_b,
+    const bool quit_after_one)
+{
+  // An empty view has no start or finish time, and there is no motion in it
+  // that could conflict with anything.
+  check_segment_num(view_a, view_b);
+  if(view_a.empty() || view_b.empty())
+    return {};
+
   Trajectory::const_iterator a_it;
   Trajectory::const_iterator b_it;
-  std::tie(a_it, b_it) = get_initial_iterators(trajectory_a, trajectory_b);
+  std::tie(a_it, b_it) = get_initial_iterators(view_a, view_b);
 
   // Verify that neither trajectory has run into a bug. These conditions should
   // be guaranteed by
   // 1. The assumption that the trajectories overlap (this is an assumption that
   //    is made explicit to the user)
   // 2. The min_size check up above
-  assert(a_it != trajectory_a.end());
-  assert(b_it != trajectory_b.end());
+  assert(a_it != view_a.get_trajectory().end());
+  assert(b_it != view_b.get_trajectory().end());
 
   // Initialize the objects that will be used inside the loop
   Spline spline_a(a_it);
   Spline spline_b(b_it);
-  std::shared_ptr<fcl::SplineMotion> motion_a =
-      make_uninitialized_fcl_spline_motion();
-  std::shared_ptr<fcl::SplineMotion> motion_b =
-      make_uninitialized_fcl_spline_motion();
-
-  const fcl::ContinuousCollisionRequest request = make_fcl_request();
+  Trajectory::const_iterator spline_a_it = a_it;
+  Trajectory::const_iterator spline_b_it = b_it;
+
+  // Only the motions within both time windows should be checked
+  const Trajectory::const_iterator a_end = view_a.end();
+  const Trajectory::const_iterator b_end = view_b.end();
+  const Time window_start =
+      std::max(*view_a.start_time(), *view_b.start_time());
+  const Time window_finish =
+      std::min(*view_a.finish_time(), *view_b.finish_time());
+
+  ConflictWorkspace& workspace = ConflictWorkspace::get();
   fcl::ContinuousCollisionResult result;
   std::vector<ConflictData> conflicts;
 
-  while(a_it != trajectory_a.end() && b_it != trajectory_b.end())
+  // Move past whichever spline finishes first
+  const auto advance = [&]()
+  {
+    if(spline_a.finish_time() < spline_b.finish_time())
+    {
+      ++a_it;
+    }
+    else if(spline_b.finish_time() < spline_a.finish_time())
+    {
+      ++b_it;
+    }
+    else
+    {
+      ++a_it;
+      ++b_it;
+    }
+  };
+
+  while(a_it != a_end && b_it != b_end)
   {
     // Increment a_it until spline_a will overlap with spline_b
     if(a_it->get_finish_time() < spline_b.start_time())
@@ -465,30 +639,52 @@ std::vector<ConflictData> DetectConflict::narrow_phase(
     const Trajectory::ConstProfilePtr profile_a = a_it->get_profile();
     const Trajectory::ConstProfilePtr profile_b = b_it->get_profile();
 
-    // TODO(MXG): Consider using optional<Spline> so that we can easily keep
-    // track of which needs to be updated. There's some wasted computational
-    // cycles here whenever we are using the same spline as a previous iteration
-    spline_a = Spline(a_it);
-    spline_b = Spline(b_it);
+    // Usually only one of the iterators advances per iteration, so we only
+    // rebuild the spline whose segment has actually changed.
+    if(spline_a_it != a_it)
+    {
+      spline_a = Spline(a_it);
+      spline_a_it = a_it;
+    }
 
-    const Time start_time =
-        std::max(spline_a.start_time(), spline_b.start_time());
-    const Time finish_time =
-        std::min(spline_a.finish_time(), spline_b.finish_time());
+    if(spline_b_it != b_it)
+    {
+      spline_b = Spline(b_it);
+      spline_b_it = b_it;
+    }
 
-    *motion_a = spline_a.to_fcl(start_time, finish_time);
-    *motion_b = spline_b.to_fcl(start_time, finish_time);
+    // Nothing after this point is inside of both windows
+    if(window_finish < spline_a.start_time()
+       || window_finish < spline_b.start_time())
+      break;
+
+    const Time start_time = std::max(
+          window_start, std::max(spline_a.start_time(), spline_b.start_time()));
+    const Time finish_time = std::min(
+          window_finish,
+          std::min(spline_a.finish_time(), spline_b.finish_time()));
+
+    // The splines may overlap each other without overlapping both windows, in
+    // which case there is nothing to check for this pair.
+    if(finish_time <= start_time)
+    {
+      advance();
+      continue;
+    }
+
+    *workspace.motion_a = spline_a.to_fcl(start_time, finish_time);
+    *workspace.motion_b = spline_b.to_fcl(start_time, finish_time);
 
     assert(profile_a->get_shape());
     assert(profile_b->get_shape());
-    const auto obj_a = fcl::ContinuousCollisionObject(
+    const auto& obj_a = workspace.object_a.get(
           geometry::FinalConvexShape::Implementation::get_collision(
-            *profile_a->get_shape()), motion_a);
-    const auto obj_b = fcl::ContinuousCollisionObject(
+            *profile_a->get_shape()), workspace.motion_a);
+    const auto& obj_b = workspace.object_b.get(
           geometry::FinalConvexShape::Implementation::get_collision(
-            *profile_b->get_shape()), motion_b);
+            *profile_b->get_shape()), workspace.motion_b);
 
-    fcl::collide(&obj_a, &obj_b, request, result);
+    fcl::collide(&obj_a, &obj_b, workspace.request, result);
     if(result.is_collide)
     {
       const double scaled_time = result.time_of_contact;
@@ -500,31 +696,202 @@ std::vector<ConflictData> DetectConflict::narrow_phase(
         return conflicts;
     }
 
-    if(spline_a.finish_time() < spline_b.finish_time())
+    advance();
+  }
+
+  return conflicts;
+}
+
+namespace {
+//==============================================================================
+struct SweepItem
+{
+  std::size_t index;
+  Time start_time;
+  Time finish_time;
+  BoundingBox box;
+};
+
+//==============================================================================
+std::vector<DetectConflict::IndexPair> sweep_and_prune(
+    const std::vector<const Trajectory*>& trajectories)
+{
+  std::unordered_map<std::string, std::vector<SweepItem>> maps;
+  for(std::size_t i=0; i < trajectories.size(); ++i)
+  {
+    const Trajectory& trajectory = *trajectories[i];
+    if(trajectory.size() < 2)
     {
-      ++a_it;
+      throw invalid_trajectory_error::Implementation
+          ::make_segment_num_error(trajectory.size());
     }
-    else if(spline_b.finish_time() < spline_a.finish_time())
+
+    maps[trajectory.get_map_name()].emplace_back(
+          SweepItem{
+            i,
+            *trajectory.start_time(),
+            *trajectory.finish_time(),
+            get_bounding_box(trajectory)});
+  }
+
+  std::vector<DetectConflict::IndexPair> candidates;
+  std::vector<const SweepItem*> active;
+  for(auto& entry : maps)
+  {
+    std::vector<SweepItem>& items = entry.second;
+    std::sort(items.begin(), items.end(),
+              [](const SweepItem& a, const SweepItem& b)
     {
-      ++b_it;
-    }
-    else
+      return a.start_time < b.start_time;
+    });
+
+    active.clear();
+    for(const SweepItem& item : items)
     {
-      ++a_it;
-      ++b_it;
+      // Anything that finished before this item starts cannot overlap with it
+      // or with anything that comes after it.
+      active.erase(
+            std::remove_if(active.begin(), active.end(),
+                           [&](const SweepItem* other)
+      {
+        return other->finish_time < item.start_time;
+      }), active.end());
+
+      for(const SweepItem* other : active)
+      {
+        if(!overlap(item.box, other->box))
+          continue;
+
+        candidates.emplace_back(
+              std::min(item.index, other->index),
+              std::max(item.index, other->index));
+      }
+
+      active.push_back(&item);
     }
   }
 
+  return candidates;
+}
+
+} // anonymous namespace
+
+//==============================================================================
+std::vector<DetectConflict::IndexPair> DetectConflict::all_pairs(
+    const std::vector<const Trajectory*>& trajectories,
+    const std::size_t num_threads)
+{
+  const std::vector<IndexPair> candidates = sweep_and_prune(trajectories);
+
+  const auto check = [&](const IndexPair& pair) -> bool
+  {
+    return !between(
+          *trajectories[pair.first], *trajectories[pair.second], true).empty();
+  };
+
+  std::vector<IndexPair> conflicts =
+      internal::check_pairs(candidates, check, num_threads);
+
+  std::sort(conflicts.begin(), conflicts.end());
   return conflicts;
 }
 
 namespace internal {
+//==============================================================================
+std::vector<DetectConflict::IndexPair> check_pairs(
+    const std::vector<DetectConflict::IndexPair>& candidates,
+    const std::function<bool(const DetectConflict::IndexPair&)>& check,
+    const std::size_t num_threads)
+{
+  using IndexPair = DetectConflict::IndexPair;
+
+  std::vector<IndexPair> passed;
+  const std::size_t N = std::min(num_threads, candidates.size());
+  if(N <= 1)
+  {
+    for(const auto& pair : candidates)
+    {
+      if(check(pair))
+        passed.push_back(pair);
+    }
+
+    return passed;
+  }
+
+  // Each thread takes every N-th candidate so that the work stays balanced
+  // even when the candidates are clustered.
+  std::vector<std::vector<IndexPair>> results(N);
+
+  // An exception must not escape from a worker, or std::terminate would be
+  // called. The first one gets saved here and the rest of the work is
+  // abandoned, so it can be rethrown once every thread has been joined.
+  std::mutex error_mutex;
+  std::exception_ptr error;
+  std::atomic_bool failed(false);
+
+  const auto work = [&](const std::size_t t)
+  {
+    try
+    {
+      for(std::size_t i=t; i < candidates.size(); i += N)
+      {
+        if(failed.load(std::memory_order_relaxed))
+          return;
+
+        if(check(candidates[i]))
+          results[t].push_back(candidates[i]);
+      }
+    }
+    catch(...)
+    {
+      std::lock_guard<std::mutex> lock(error_mutex);
+      if(!error)
+        error = std::current_exception();
+
+      failed = true;
+    }
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(N-1);
+  try
+  {
+    for(std::size_t t=1; t < N; ++t)
+      threads.emplace_back(work, t);
+  }
+  catch(...)
+  {
+    // A thread could not be started, so stop the ones that were
+    failed = true;
+    for(auto& thread : threads)
+      thread.join();
+
+    throw;
+  }
+
+  work(0);
+
+  for(auto& thread : threads)
+    thread.join();
+
+  if(error)
+    std::rethrow_exception(error);
+
+  for(const auto& result : results)
+    passed.insert(passed.end(), result.begin(), result.end());
+
+  return passed;
+}
+
 //==============================================================================
 bool detect_conflicts(
-    const Trajectory& trajectory,
+    const Trajectory::View& view,
     const Spacetime& region,
-    std::vector<Trajectory::const_iterator>* output_iterators)
+    std::vector<Trajectory::const_iterator>* output_iterators,
+    const BoundingBox* trajectory_bounds)
 {
+  const Trajectory& trajectory = view.get_trajectory();
+
 #ifndef NDEBUG
   // This should never actually happen because this function only gets used
   // internally, and so there should be several layers of quality checks on the
@@ -540,8 +907,11 @@ bool detect_conflicts(
   }
 #endif // NDEBUG
 
-  const Time trajectory_start_time = *trajectory.start_time();
-  const Time trajectory_finish_time = *trajectory.finish_time();
+  if(view.empty())
+    return false;
+
+  const Time trajectory_start_time = *view.start_time();
+  const Time trajectory_finish_time = *view.finish_time();
 
   const Time start_time = region.lower_time_bound?
         std::max(*region.lower_time_bound, trajectory_start_time)
@@ -559,20 +929,29 @@ bool detect_conflicts(
     return false;
   }
 
+  if(region.bounds && trajectory_bounds
+     && !overlap(*region.bounds, *trajectory_bounds))
+  {
+    // The trajectory never comes near the region, so there is no need to do
+    // any collision checking.
+    return false;
+  }
+
   const Trajectory::const_iterator begin_it =
-      trajectory_start_time < start_time?
-        trajectory.find(start_time) : ++trajectory.begin();
+      first_motion(view, start_time);
 
   const Trajectory::const_iterator end_it =
-      finish_time < trajectory_finish_time?
-        ++trajectory.find(finish_time) : trajectory.end();
+      finish_time < *trajectory.finish_time()?
+        ++trajectory.find(finish_time, begin_it) : trajectory.end();
 
-  std::shared_ptr<fcl::SplineMotion> motion_trajectory =
-      make_uninitialized_fcl_spline_motion();
-  std::shared_ptr<internal::StaticMotion> motion_region =
-      std::make_shared<internal::StaticMotion>(region.pose);
+  ConflictWorkspace& workspace = ConflictWorkspace::get();
+  *workspace.motion_region = internal::StaticMotion(region.pose);
 
-  const fcl::ContinuousCollisionRequest request = make_fcl_request();
+  assert(region.shape);
+  const auto& region_shapes = geometry::FinalShape::Implementation
+      ::get_collisions(*region.shape);
+  if(workspace.objects_region.size() < region_shapes.size())
+    workspace.objects_region.resize(region_shapes.size());
 
   bool collision_detected = false;
 
@@ -582,29 +961,30 @@ bool detect_conflicts(
 
     Spline spline_trajectory{it};
 
+    if(region.bounds
+       && !overlap(*region.bounds, get_bounding_box(spline_trajectory)))
+      continue;
+
     const Time spline_start_time =
         std::max(spline_trajectory.start_time(), start_time);
     const Time spline_finish_time =
         std::min(spline_trajectory.finish_time(), finish_time);
 
-    *motion_trajectory = spline_trajectory.to_fcl(
+    *workspace.motion_a = spline_trajectory.to_fcl(
           spline_start_time, spline_finish_time);
 
     assert(profile->get_shape());
-    const auto obj_trajectory = fcl::ContinuousCollisionObject(
+    const auto& obj_trajectory = workspace.object_a.get(
           geometry::FinalConvexShape::Implementation::get_collision(
-            *profile->get_shape()), motion_trajectory);
+            *profile->get_shape()), workspace.motion_a);
 
-    assert(region.shape);
-    const auto& region_shapes = geometry::FinalShape::Implementation
-        ::get_collisions(*region.shape);
-    for(const auto& region_shape : region_shapes)
+    for(std::size_t i=0; i < region_shapes.size(); ++i)
     {
-      const auto obj_region = fcl::ContinuousCollisionObject(
-            region_shape, motion_region);
+      const auto& obj_region = workspace.objects_region[i].get(
+            region_shapes[i], workspace.motion_region);
 
       fcl::ContinuousCollisionResult result;
-      fcl::collide(&obj_trajectory, &obj_region, request, result);
+      fcl::collide(&obj_trajectory, &obj_region, workspace.request, result);
       if(result.is_collide)
       {
         if(output_iterators)
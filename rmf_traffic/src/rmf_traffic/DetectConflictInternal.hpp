@@ -20,13 +20,45 @@
 
 #include "geometry/ShapeInternal.hpp"
 
+#include <rmf_traffic/Conflict.hpp>
 #include <rmf_traffic/Trajectory.hpp>
 
+#include <functional>
 #include <unordered_map>
 
 namespace rmf_traffic {
+
+// Forward declaration
+class Spline;
+
 namespace internal {
 
+//==============================================================================
+struct BoundingBox
+{
+  Eigen::Vector2d min;
+  Eigen::Vector2d max;
+};
+
+//==============================================================================
+/// Get the bounding box of a spline, padded by the characteristic length of
+/// its profile shape.
+BoundingBox get_bounding_box(const Spline& spline);
+
+//==============================================================================
+/// Get the bounding box of every segment of a trajectory. The trajectory must
+/// have at least 2 segments.
+BoundingBox get_bounding_box(const Trajectory& trajectory);
+
+//==============================================================================
+/// Get a bounding box that contains the shape when it is placed at the pose.
+BoundingBox get_bounding_box(
+    const Eigen::Isometry2d& pose,
+    const geometry::FinalShape& shape);
+
+//==============================================================================
+bool overlap(const BoundingBox& box_a, const BoundingBox& box_b);
+
 //==============================================================================
 struct Spacetime
 {
@@ -35,14 +67,40 @@ struct Spacetime
 
   Eigen::Isometry2d pose;
   geometry::ConstFinalShapePtr shape;
+
+  /// Precomputed bounds of the shape at its pose. When this is provided,
+  /// detect_conflicts() will use it to skip the collision check for any
+  /// segments that are nowhere near the region.
+  const BoundingBox* bounds = nullptr;
 };
 
 //==============================================================================
+/// \param[in] view
+///   The part of a trajectory to check. Passing in a Trajectory will check all
+///   of it. The trajectory must have at least 2 segments.
+///
+/// \param[in] trajectory_bounds
+///   Optionally provide the cached result of get_bounding_box(trajectory). If
+///   this and the region bounds are both available and they do not overlap,
+///   then no collision checking will be performed at all.
 bool detect_conflicts(
-    const Trajectory& trajectory,
+    const Trajectory::View& view,
     const Spacetime& region,
-    std::vector<Trajectory::const_iterator>* output_iterators);
+    std::vector<Trajectory::const_iterator>* output_iterators,
+    const BoundingBox* trajectory_bounds = nullptr);
 
+//==============================================================================
+/// Run check on every candidate pair, spread across up to num_threads threads,
+/// and get back the pairs that it returned true for. This is the parallel part
+/// of DetectConflict::all_pairs().
+///
+/// If check throws an exception, the remaining work is abandoned and every
+/// thread gets joined before the first exception is rethrown on the calling
+/// thread.
+std::vector<DetectConflict::IndexPair> check_pairs(
+    const std::vector<DetectConflict::IndexPair>& candidates,
+    const std::function<bool(const DetectConflict::IndexPair&)>& check,
+    std::size_t num_threads);
 
 } // namespace internal
 } // namespace rmf_traffic
@@ -0,0 +1,780 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <rmf_traffic/Serialization.hpp>
+#include <rmf_traffic/geometry/Box.hpp>
+#include <rmf_traffic/geometry/Circle.hpp>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <typeinfo>
+#include <unordered_map>
+
+namespace rmf_traffic {
+namespace serialization {
+
+//==============================================================================
+class Options::Implementation
+{
+public:
+
+  double position_resolution;
+
+};
+
+//==============================================================================
+Options::Options(const double position_resolution)
+  : _pimpl(rmf_utils::make_impl<Implementation>(
+             Implementation{position_resolution}))
+{
+  // Do nothing
+}
+
+//==============================================================================
+Options& Options::position_resolution(const double resolution)
+{
+  _pimpl->position_resolution = resolution;
+  return *this;
+}
+
+//==============================================================================
+double Options::position_resolution() const
+{
+  return _pimpl->position_resolution;
+}
+
+namespace {
+
+//==============================================================================
+// The layout of an encoded buffer is:
+//
+//   magic     : 4 bytes, "RMFT"
+//   version   : 1 byte, FormatVersion
+//   kind      : 1 byte, Kind
+//   flags     : 1 byte, Flags
+//   resolution: 8 bytes, only present if the Quantized flag is set
+//   shapes    : varint count, then for each shape a ShapeKind byte followed by
+//               its parameters as 8 byte doubles
+//   profiles  : varint count, then for each profile its autonomy, its shape
+//               index, and its queue ID if it is queued
+//   body      : the Trajectory, Change, or Patch
+//
+// Unsigned integers are stored as little-endian base-128 varints, and signed
+// integers are zigzag-encoded first. Within a Trajectory, the finish time of
+// each segment is stored as the delta from the segment before it.
+const uint8_t Magic[4] = {'R', 'M', 'F', 'T'};
+
+enum class Kind : uint8_t
+{
+  Trajectory = 1,
+  Change = 2,
+  Patch = 3
+};
+
+enum Flags : uint8_t
+{
+  Quantized = 1 << 0
+};
+
+enum class ShapeKind : uint8_t
+{
+  Box = 1,
+  Circle = 2
+};
+
+//==============================================================================
+[[noreturn]] void malformed(const std::string& what)
+{
+  throw std::runtime_error(
+        "[rmf_traffic::serialization] Malformed buffer: " + what);
+}
+
+//==============================================================================
+uint64_t zigzag(const int64_t value)
+{
+  return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value>>63);
+}
+
+//==============================================================================
+int64_t unzigzag(const uint64_t value)
+{
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+//==============================================================================
+class Writer
+{
+public:
+
+  Buffer& buffer;
+
+  void byte(const uint8_t value)
+  {
+    buffer.push_back(value);
+  }
+
+  void varint(uint64_t value)
+  {
+    while(value >= 0x80)
+    {
+      buffer.push_back(static_cast<uint8_t>(value | 0x80));
+      value >>= 7;
+    }
+
+    buffer.push_back(static_cast<uint8_t>(value));
+  }
+
+  void svarint(const int64_t value)
+  {
+    varint(zigzag(value));
+  }
+
+  void float64(const double value)
+  {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    for(std::size_t i=0; i < 8; ++i)
+      buffer.push_back(static_cast<uint8_t>(bits >> (8*i)));
+  }
+
+  void string(const std::string& value)
+  {
+    varint(value.size());
+    buffer.insert(buffer.end(), value.begin(), value.end());
+  }
+};
+
+//==============================================================================
+class Reader
+{
+public:
+
+  Reader(const uint8_t* data, const std::size_t size)
+    : _it(data),
+      _end(data + size)
+  {
+    if(!data && size > 0)
+      malformed("nullptr data");
+  }
+
+  uint8_t byte()
+  {
+    if(_it == _end)
+      malformed("unexpected end of buffer");
+
+    return *_it++;
+  }
+
+  uint64_t varint()
+  {
+    uint64_t value = 0;
+    for(unsigned int shift = 0; shift < 64; shift += 7)
+    {
+      const uint8_t b = byte();
+      value |= static_cast<uint64_t>(b & 0x7F) << shift;
+      if((b & 0x80) == 0)
+        return value;
+    }
+
+    malformed("varint is too long");
+  }
+
+  int64_t svarint()
+  {
+    return unzigzag(varint());
+  }
+
+  double float64()
+  {
+    if(remaining() < 8)
+      malformed("unexpected end of buffer");
+
+    uint64_t bits = 0;
+    for(std::size_t i=0; i < 8; ++i)
+      bits |= static_cast<uint64_t>(*_it++) << (8*i);
+
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+  std::string string()
+  {
+    const uint64_t size = varint();
+    if(size > remaining())
+      malformed("string runs past the end of the buffer");
+
+    std::string value(reinterpret_cast<const char*>(_it), size);
+    _it += size;
+    return value;
+  }
+
+  /// Read a count of elements, where each element needs at least
+  /// min_element_size bytes. This protects against reserving absurd amounts
+  /// of memory for a corrupted count.
+  std::size_t count(const std::size_t min_element_size)
+  {
+    const uint64_t n = varint();
+    if(n > remaining()/min_element_size)
+      malformed("element count runs past the end of the buffer");
+
+    return static_cast<std::size_t>(n);
+  }
+
+  std::size_t remaining() const
+  {
+    return static_cast<std::size_t>(_end - _it);
+  }
+
+private:
+  const uint8_t* _it;
+  const uint8_t* _end;
+};
+
+//==============================================================================
+/// Collects the shapes and profiles of everything that gets encoded, so that
+/// each one is only written once.
+class EncodeContext
+{
+public:
+
+  EncodeContext(const Options& options)
+    : resolution(options.position_resolution()),
+      writer{body}
+  {
+    if(resolution < 0.0 || !std::isfinite(resolution))
+    {
+      throw std::invalid_argument(
+            "[rmf_traffic::serialization] Invalid position resolution: "
+            + std::to_string(resolution));
+    }
+  }
+
+  const double resolution;
+  Buffer body;
+  Writer writer;
+
+  std::vector<Trajectory::ConstProfilePtr> profiles;
+  std::unordered_map<const Trajectory::Profile*, std::size_t> profile_map;
+
+  std::vector<geometry::ConstFinalConvexShapePtr> shapes;
+  std::unordered_map<const geometry::FinalConvexShape*, std::size_t> shape_map;
+
+  std::size_t profile_index(const Trajectory::ConstProfilePtr& profile)
+  {
+    const auto insertion =
+        profile_map.insert(std::make_pair(profile.get(), profiles.size()));
+    if(insertion.second)
+    {
+      profiles.push_back(profile);
+      shape_index(profile->get_shape());
+    }
+
+    return insertion.first->second;
+  }
+
+  std::size_t shape_index(const geometry::ConstFinalConvexShapePtr& shape)
+  {
+    if(!shape)
+    {
+      throw std::runtime_error(
+            "[rmf_traffic::serialization] Cannot encode a profile that has a "
+            "nullptr shape");
+    }
+
+    const auto insertion =
+        shape_map.insert(std::make_pair(shape.get(), shapes.size()));
+    if(insertion.second)
+      shapes.push_back(shape);
+
+    return insertion.first->second;
+  }
+
+  void write_vector(const Eigen::Vector3d& value, Eigen::Vector3d* previous)
+  {
+    if(resolution == 0.0)
+    {
+      for(int i=0; i < 3; ++i)
+        writer.float64(value[i]);
+
+      return;
+    }
+
+    for(int i=0; i < 3; ++i)
+    {
+      const double q = std::round(value[i]/resolution);
+      const double base = previous? (*previous)[i] : 0.0;
+      const double delta = q - base;
+
+      // Converting a double that does not fit in an int64_t is undefined
+      // behavior, so this needs to be checked first. This also catches NaN.
+      const double limit = std::ldexp(1.0, 63);
+      if(!(-limit <= delta && delta < limit))
+      {
+        throw std::runtime_error(
+              "[rmf_traffic::serialization] Cannot quantize the value ["
+              + std::to_string(value[i]) + "] with resolution ["
+              + std::to_string(resolution) + "]");
+      }
+
+      writer.svarint(static_cast<int64_t>(delta));
+      if(previous)
+        (*previous)[i] = q;
+    }
+  }
+
+  void write(const Trajectory& trajectory)
+  {
+    writer.string(trajectory.get_map_name());
+    writer.varint(trajectory.size());
+
+    Time last_time;
+    Eigen::Vector3d last_position = Eigen::Vector3d::Zero();
+    bool first = true;
+    for(const auto& segment : trajectory)
+    {
+      const Time time = segment.get_finish_time();
+      if(first)
+        writer.svarint(time.time_since_epoch().count());
+      else
+        writer.varint(static_cast<uint64_t>((time - last_time).count()));
+
+      writer.varint(profile_index(segment.get_profile()));
+      write_vector(segment.get_finish_position(), &last_position);
+      write_vector(segment.get_finish_velocity(), nullptr);
+
+      last_time = time;
+      first = false;
+    }
+  }
+
+  void write_trajectory_ptr(const Trajectory* trajectory)
+  {
+    if(!trajectory)
+    {
+      throw std::runtime_error(
+            "[rmf_traffic::serialization] Cannot encode a Change that refers "
+            "to a nullptr trajectory");
+    }
+
+    write(*trajectory);
+  }
+
+  void write(const schedule::Database::Change& change)
+  {
+    using Mode = schedule::Database::Change::Mode;
+    const Mode mode = change.get_mode();
+    writer.varint(static_cast<uint16_t>(mode));
+    writer.varint(change.id());
+
+    switch(mode)
+    {
+      case Mode::Insert:
+        write_trajectory_ptr(change.insert()->trajectory());
+        return;
+      case Mode::Interrupt:
+        writer.varint(change.interrupt()->original_id());
+        write_trajectory_ptr(change.interrupt()->interruption());
+        writer.svarint(change.interrupt()->delay().count());
+        return;
+      case Mode::Delay:
+        writer.varint(change.delay()->original_id());
+        writer.svarint(change.delay()->from().time_since_epoch().count());
+        writer.svarint(change.delay()->duration().count());
+        return;
+      case Mode::Replace:
+        writer.varint(change.replace()->original_id());
+        write_trajectory_ptr(change.replace()->trajectory());
+        return;
+      case Mode::Erase:
+        writer.varint(change.erase()->original_id());
+        return;
+      case Mode::Cull:
+        writer.svarint(change.cull()->time().time_since_epoch().count());
+        return;
+      default:
+        break;
+    }
+
+    throw std::runtime_error(
+          "[rmf_traffic::serialization] Cannot encode a Change with invalid "
+          "mode [" + std::to_string(static_cast<uint16_t>(mode)) + "]");
+  }
+
+  void write(const schedule::Database::Patch& patch)
+  {
+    writer.varint(patch.latest_version());
+    writer.varint(patch.size());
+    for(const auto& change : patch)
+      write(change);
+  }
+
+  /// Assemble the header, the tables, and the body into the final buffer
+  Buffer finish(const Kind kind)
+  {
+    Buffer output;
+    output.reserve(body.size() + 64);
+    Writer out{output};
+
+    for(const uint8_t m : Magic)
+      out.byte(m);
+
+    out.byte(FormatVersion);
+    out.byte(static_cast<uint8_t>(kind));
+    out.byte(resolution > 0.0? Quantized : 0);
+    if(resolution > 0.0)
+      out.float64(resolution);
+
+    out.varint(shapes.size());
+    for(const auto& shape : shapes)
+    {
+      const auto& source = shape->source();
+      if(const auto* box = dynamic_cast<const geometry::Box*>(&source))
+      {
+        out.byte(static_cast<uint8_t>(ShapeKind::Box));
+        out.float64(box->get_x_length());
+        out.float64(box->get_y_length());
+      }
+      else if(const auto* circle =
+              dynamic_cast<const geometry::Circle*>(&source))
+      {
+        out.byte(static_cast<uint8_t>(ShapeKind::Circle));
+        out.float64(circle->get_radius());
+      }
+      else
+      {
+        throw std::runtime_error(
+              std::string()
+              + "[rmf_traffic::serialization] Unsupported profile shape type ["
+              + typeid(source).name() + "]");
+      }
+    }
+
+    out.varint(profiles.size());
+    for(const auto& profile : profiles)
+    {
+      const auto autonomy = profile->get_autonomy();
+      out.varint(static_cast<uint16_t>(autonomy));
+      out.varint(shape_map.at(profile->get_shape().get()));
+      if(autonomy == Trajectory::Profile::Autonomy::Queued)
+        out.string(profile->get_queue_info()->get_queue_id());
+    }
+
+    output.insert(output.end(), body.begin(), body.end());
+    return output;
+  }
+};
+
+//==============================================================================
+/// Reads the header and tables of a buffer, and then decodes its body.
+class DecodeContext
+{
+public:
+
+  DecodeContext(const uint8_t* data, const std::size_t size, const Kind kind)
+    : reader(data, size)
+  {
+    for(const uint8_t m : Magic)
+    {
+      if(reader.byte() != m)
+        malformed("missing magic bytes");
+    }
+
+    const uint8_t version = reader.byte();
+    if(version == 0 || version > FormatVersion)
+    {
+      throw std::runtime_error(
+            "[rmf_traffic::serialization] Unsupported format version ["
+            + std::to_string(version) + "]. The newest supported version is ["
+            + std::to_string(FormatVersion) + "].");
+    }
+
+    if(reader.byte() != static_cast<uint8_t>(kind))
+      malformed("buffer contains a different kind of object");
+
+    const uint8_t flags = reader.byte();
+    if(flags & Quantized)
+    {
+      resolution = reader.float64();
+      if(!(resolution > 0.0) || !std::isfinite(resolution))
+        malformed("invalid position resolution");
+    }
+
+    std::vector<geometry::ConstFinalConvexShapePtr> shapes;
+    shapes.resize(reader.count(9));
+    for(auto& shape : shapes)
+    {
+      const uint8_t shape_kind = reader.byte();
+      if(shape_kind == static_cast<uint8_t>(ShapeKind::Box))
+      {
+        const double x = reader.float64();
+        const double y = reader.float64();
+        shape = geometry::make_final_convex<geometry::Box>(x, y);
+      }
+      else if(shape_kind == static_cast<uint8_t>(ShapeKind::Circle))
+      {
+        shape = geometry::make_final_convex<geometry::Circle>(reader.float64());
+      }
+      else
+      {
+        malformed("unknown shape kind [" + std::to_string(shape_kind) + "]");
+      }
+    }
+
+    using Profile = Trajectory::Profile;
+    profiles.resize(reader.count(2));
+    for(auto& profile : profiles)
+    {
+      const uint64_t autonomy = reader.varint();
+      const uint64_t shape_index = reader.varint();
+      if(shape_index >= shapes.size())
+        malformed("profile refers to a shape that does not exist");
+
+      const auto& shape = shapes[shape_index];
+      if(autonomy == static_cast<uint16_t>(Profile::Autonomy::Guided))
+        profile = Profile::make_guided(shape);
+      else if(autonomy == static_cast<uint16_t>(Profile::Autonomy::Autonomous))
+        profile = Profile::make_autonomous(shape);
+      else if(autonomy == static_cast<uint16_t>(Profile::Autonomy::Queued))
+        profile = Profile::make_queued(shape, reader.string());
+      else
+        malformed("invalid autonomy [" + std::to_string(autonomy) + "]");
+    }
+  }
+
+  Reader reader;
+  double resolution = 0.0;
+  std::vector<Trajectory::ConstProfilePtr> profiles;
+
+  Eigen::Vector3d read_vector(Eigen::Vector3d* previous)
+  {
+    Eigen::Vector3d value;
+    if(resolution == 0.0)
+    {
+      for(int i=0; i < 3; ++i)
+        value[i] = reader.float64();
+
+      return value;
+    }
+
+    for(int i=0; i < 3; ++i)
+    {
+      double q = static_cast<double>(reader.svarint());
+      if(previous)
+      {
+        q += (*previous)[i];
+        (*previous)[i] = q;
+      }
+
+      value[i] = q*resolution;
+    }
+
+    return value;
+  }
+
+  Trajectory read_trajectory()
+  {
+    Trajectory trajectory(reader.string());
+
+    // Every segment needs at least 8 bytes: a time delta, a profile index, and
+    // six quantized values.
+    const std::size_t size = reader.count(8);
+    trajectory.reserve(size);
+
+    Time time;
+    Eigen::Vector3d last_position = Eigen::Vector3d::Zero();
+    for(std::size_t i=0; i < size; ++i)
+    {
+      if(i == 0)
+      {
+        time = Time(Duration(reader.svarint()));
+      }
+      else
+      {
+        // Trajectory::push_back() would merge a segment that finishes at the
+        // same time as the one before it, so a zero delta is not allowed.
+        const uint64_t delta = reader.varint();
+        const Duration::rep max = std::numeric_limits<Duration::rep>::max();
+        if(delta == 0 || delta > static_cast<uint64_t>(max)
+           || time.time_since_epoch().count()
+              > max - static_cast<Duration::rep>(delta))
+        {
+          malformed("segment finish times must strictly increase");
+        }
+
+        time += Duration(static_cast<Duration::rep>(delta));
+      }
+
+      const uint64_t profile_index = reader.varint();
+      if(profile_index >= profiles.size())
+        malformed("segment refers to a profile that does not exist");
+
+      const Eigen::Vector3d position = read_vector(&last_position);
+      const Eigen::Vector3d velocity = read_vector(nullptr);
+      trajectory.push_back(
+            time, profiles[profile_index], position, velocity);
+    }
+
+    return trajectory;
+  }
+
+  schedule::Database::Change read_change()
+  {
+    using Change = schedule::Database::Change;
+    using Mode = Change::Mode;
+
+    const uint64_t mode = reader.varint();
+    const schedule::Version id = reader.varint();
+
+    if(mode == static_cast<uint16_t>(Mode::Insert))
+      return Change::make_insert(read_trajectory(), id);
+
+    if(mode == static_cast<uint16_t>(Mode::Interrupt))
+    {
+      const schedule::Version original_id = reader.varint();
+      Trajectory interruption = read_trajectory();
+      const Duration delay(reader.svarint());
+      return Change::make_interrupt(
+            original_id, std::move(interruption), delay, id);
+    }
+
+    if(mode == static_cast<uint16_t>(Mode::Delay))
+    {
+      const schedule::Version original_id = reader.varint();
+      const Time from = Time(Duration(reader.svarint()));
+      const Duration delay(reader.svarint());
+      return Change::make_delay(original_id, from, delay, id);
+    }
+
+    if(mode == static_cast<uint16_t>(Mode::Replace))
+    {
+      const schedule::Version original_id = reader.varint();
+      return Change::make_replace(original_id, read_trajectory(), id);
+    }
+
+    if(mode == static_cast<uint16_t>(Mode::Erase))
+      return Change::make_erase(reader.varint(), id);
+
+    if(mode == static_cast<uint16_t>(Mode::Cull))
+      return Change::make_cull(Time(Duration(reader.svarint())), id);
+
+    malformed("invalid change mode [" + std::to_string(mode) + "]");
+  }
+
+  schedule::Database::Patch read_patch()
+  {
+    const schedule::Version latest_version = reader.varint();
+
+    // Every change needs at least 2 bytes: its mode and its ID.
+    const std::size_t size = reader.count(2);
+    std::vector<schedule::Database::Change> changes;
+    changes.reserve(size);
+    for(std::size_t i=0; i < size; ++i)
+      changes.emplace_back(read_change());
+
+    return schedule::Database::Patch(std::move(changes), latest_version);
+  }
+
+  void finish()
+  {
+    if(reader.remaining() > 0)
+      malformed("unexpected bytes after the end of the encoded object");
+  }
+};
+
+} // anonymous namespace
+
+//==============================================================================
+Buffer encode(const Trajectory& trajectory, const Options& options)
+{
+  EncodeContext context(options);
+  context.write(trajectory);
+  return context.finish(Kind::Trajectory);
+}
+
+//==============================================================================
+Buffer encode(
+    const schedule::Database::Change& change,
+    const Options& options)
+{
+  EncodeContext context(options);
+  context.write(change);
+  return context.finish(Kind::Change);
+}
+
+//==============================================================================
+Buffer encode(
+    const schedule::Database::Patch& patch,
+    const Options& options)
+{
+  EncodeContext context(options);
+  context.write(patch);
+  return context.finish(Kind::Patch);
+}
+
+//==============================================================================
+Trajectory decode_trajectory(const uint8_t* data, const std::size_t size)
+{
+  DecodeContext context(data, size, Kind::Trajectory);
+  Trajectory trajectory = context.read_trajectory();
+  context.finish();
+  return trajectory;
+}
+
+//==============================================================================
+Trajectory decode_trajectory(const Buffer& buffer)
+{
+  return decode_trajectory(buffer.data(), buffer.size());
+}
+
+//==============================================================================
+schedule::Database::Change decode_change(
+    const uint8_t* data, const std::size_t size)
+{
+  DecodeContext context(data, size, Kind::Change);
+  schedule::Database::Change change = context.read_change();
+  context.finish();
+  return change;
+}
+
+//==============================================================================
+schedule::Database::Change decode_change(const Buffer& buffer)
+{
+  return decode_change(buffer.data(), buffer.size());
+}
+
+//==============================================================================
+schedule::Database::Patch decode_patch(
+    const uint8_t* data, const std::size_t size)
+{
+  DecodeContext context(data, size, Kind::Patch);
+  schedule::Database::Patch patch = context.read_patch();
+  context.finish();
+  return patch;
+}
+
+//==============================================================================
+schedule::Database::Patch decode_patch(const Buffer& buffer)
+{
+  return decode_patch(buffer.data(), buffer.size());
+}
+
+} // namespace serialization
+} // namespace rmf_traffic
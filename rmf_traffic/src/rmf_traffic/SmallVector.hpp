@@ -0,0 +1,260 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef SRC__RMF_TRAFFIC__SMALLVECTOR_HPP
+#define SRC__RMF_TRAFFIC__SMALLVECTOR_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace rmf_traffic {
+namespace internal {
+
+//==============================================================================
+/// A vector which keeps up to N elements inside of itself, and only allocates
+/// memory on the heap once it grows beyond that. Only the subset of the
+/// std::vector interface that the Trajectory storage needs is provided.
+///
+/// Just like std::vector, any operation that changes the size of the container
+/// may invalidate all of its iterators and references.
+template<typename T, std::size_t N>
+class SmallVector
+{
+public:
+
+  static_assert(N > 0, "SmallVector must have some inline capacity");
+
+  using value_type = T;
+  using size_type = std::size_t;
+  using iterator = T*;
+  using const_iterator = const T*;
+
+  SmallVector()
+    : _data(inline_data()),
+      _size(0),
+      _capacity(N)
+  {
+    // Do nothing
+  }
+
+  SmallVector(const SmallVector& other)
+    : SmallVector()
+  {
+    *this = other;
+  }
+
+  SmallVector(SmallVector&& other)
+    : SmallVector()
+  {
+    *this = std::move(other);
+  }
+
+  SmallVector& operator=(const SmallVector& other)
+  {
+    if(this == &other)
+      return *this;
+
+    clear();
+    reserve(other._size);
+    std::uninitialized_copy(other.begin(), other.end(), _data);
+    _size = other._size;
+    return *this;
+  }
+
+  SmallVector& operator=(SmallVector&& other)
+  {
+    if(this == &other)
+      return *this;
+
+    clear();
+    if(!other.is_inline())
+    {
+      // We can just steal the heap storage of the other vector
+      release();
+      _data = other._data;
+      _capacity = other._capacity;
+      _size = other._size;
+
+      other._data = other.inline_data();
+      other._capacity = N;
+      other._size = 0;
+      return *this;
+    }
+
+    std::uninitialized_copy(
+          std::make_move_iterator(other.begin()),
+          std::make_move_iterator(other.end()), _data);
+    _size = other._size;
+    other.clear();
+    return *this;
+  }
+
+  ~SmallVector()
+  {
+    clear();
+    release();
+  }
+
+  size_type size() const { return _size; }
+  size_type capacity() const { return _capacity; }
+  bool empty() const { return _size == 0; }
+
+  /// True if the elements are currently stored inside of this object.
+  bool is_inline() const { return _data == inline_data(); }
+
+  iterator begin() { return _data; }
+  const_iterator begin() const { return _data; }
+  iterator end() { return _data + _size; }
+  const_iterator end() const { return _data + _size; }
+
+  T& operator[](size_type i) { return _data[i]; }
+  const T& operator[](size_type i) const { return _data[i]; }
+
+  T& front() { return _data[0]; }
+  const T& front() const { return _data[0]; }
+  T& back() { return _data[_size-1]; }
+  const T& back() const { return _data[_size-1]; }
+
+  void reserve(size_type new_capacity)
+  {
+    if(new_capacity <= _capacity)
+      return;
+
+    T* const new_data = allocate(new_capacity);
+    std::uninitialized_copy(
+          std::make_move_iterator(begin()),
+          std::make_move_iterator(end()), new_data);
+
+    const size_type size = _size;
+    clear();
+    release();
+
+    _data = new_data;
+    _size = size;
+    _capacity = new_capacity;
+  }
+
+  template<typename... Args>
+  T& emplace_back(Args&&... args)
+  {
+    if(_size < _capacity)
+    {
+      new (_data + _size) T(std::forward<Args>(args)...);
+      return _data[_size++];
+    }
+
+    // Construct the new element before moving the existing elements, in case
+    // the arguments refer to one of them.
+    const size_type new_capacity = 2*_capacity;
+    T* const new_data = allocate(new_capacity);
+    new (new_data + _size) T(std::forward<Args>(args)...);
+    std::uninitialized_copy(
+          std::make_move_iterator(begin()),
+          std::make_move_iterator(end()), new_data);
+
+    const size_type size = _size;
+    clear();
+    release();
+
+    _data = new_data;
+    _size = size + 1;
+    _capacity = new_capacity;
+    return back();
+  }
+
+  template<typename... Args>
+  iterator emplace(const_iterator position, Args&&... args)
+  {
+    const size_type index = static_cast<size_type>(position - begin());
+    assert(index <= _size);
+
+    emplace_back(std::forward<Args>(args)...);
+    std::rotate(begin() + index, end() - 1, end());
+    return begin() + index;
+  }
+
+  iterator erase(const_iterator first, const_iterator last)
+  {
+    const size_type index = static_cast<size_type>(first - begin());
+    const size_type count = static_cast<size_type>(last - first);
+    if(count == 0)
+      return begin() + index;
+
+    std::move(begin() + index + count, end(), begin() + index);
+    for(size_type i = _size - count; i < _size; ++i)
+      _data[i].~T();
+
+    _size -= count;
+    return begin() + index;
+  }
+
+  iterator erase(const_iterator position)
+  {
+    return erase(position, position + 1);
+  }
+
+  void clear()
+  {
+    for(size_type i=0; i < _size; ++i)
+      _data[i].~T();
+
+    _size = 0;
+  }
+
+private:
+
+  T* inline_data()
+  {
+    return reinterpret_cast<T*>(&_buffer);
+  }
+
+  const T* inline_data() const
+  {
+    return reinterpret_cast<const T*>(&_buffer);
+  }
+
+  static T* allocate(size_type capacity)
+  {
+    return static_cast<T*>(::operator new(capacity*sizeof(T)));
+  }
+
+  /// Give back the heap storage, if there is any. All elements must already
+  /// have been destroyed.
+  void release()
+  {
+    if(!is_inline())
+      ::operator delete(_data);
+
+    _data = inline_data();
+    _capacity = N;
+  }
+
+  typename std::aligned_storage<sizeof(T), alignof(T)>::type _buffer[N];
+  T* _data;
+  size_type _size;
+  size_type _capacity;
+};
+
+} // namespace internal
+} // namespace rmf_traffic
+
+#endif // SRC__RMF_TRAFFIC__SMALLVECTOR_HPP
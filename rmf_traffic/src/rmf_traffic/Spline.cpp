@@ -93,14 +93,9 @@ Spline::Parameters compute_parameters(
 
 //==============================================================================
 Spline::Parameters compute_parameters(
-    const internal::SegmentList::const_iterator& finish_it)
+    const internal::SegmentElement::Data& start,
+    const internal::SegmentElement::Data& finish)
 {
-  const internal::SegmentList::const_iterator start_it =
-      --internal::SegmentList::const_iterator(finish_it);
-
-  const internal::SegmentElement::Data& start = start_it->data;
-  const internal::SegmentElement::Data& finish = finish_it->data;
-
   const Time start_time = start.finish_time;
   const Time finish_time = finish.finish_time;
 
@@ -112,7 +107,7 @@ Spline::Parameters compute_parameters(
   const Eigen::Vector3d v1 = delta_t * finish.velocity;
 
   const rmf_traffic::Trajectory::ConstProfilePtr profile_ptr =
-      finish_it->data.profile;
+      finish.profile;
 
   return {
     profile_ptr,
@@ -199,8 +194,10 @@ Spline::Spline(const Trajectory::const_iterator& it)
 }
 
 //==============================================================================
-Spline::Spline(const internal::SegmentList::const_iterator& it)
-  : params(compute_parameters(it))
+Spline::Spline(
+    const internal::SegmentElement::Data& start,
+    const internal::SegmentElement::Data& finish)
+  : params(compute_parameters(start, finish))
 {
   // Do nothing
 }
@@ -41,9 +41,11 @@ public:
   /// `it`.
   Spline(const Trajectory::const_iterator& it);
 
-  /// Create a spline that goes from the end of the preceding to the Segment of
-  /// `it`.
-  Spline(const internal::SegmentList::const_iterator& it);
+  /// Create a spline that goes from the end of the start Segment to the end of
+  /// the finish Segment.
+  Spline(
+      const internal::SegmentElement::Data& start,
+      const internal::SegmentElement::Data& finish);
 
   /// Compute the knots for the motion of this spline from start_time to
   /// finish_time, scaled to a "time" range of [0, 1].
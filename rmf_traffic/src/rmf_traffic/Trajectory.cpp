@@ -21,7 +21,10 @@
 #include "MotionInternal.hpp"
 #include "TrajectoryInternal.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <mutex>
 #include <string>
 
 namespace rmf_traffic {
@@ -32,27 +35,34 @@ class TrajectoryIteratorImplementation
 {
 public:
 
-  internal::SegmentList::iterator raw_iterator;
-  const Trajectory::Implementation* parent;
+  // The iterator refers to the Segment object instead of a position in the
+  // SegmentList, so that it remains valid while other Segments are inserted or
+  // erased. A nullptr indicates the end() iterator.
+  Trajectory::Segment* segment = nullptr;
+  const Trajectory::Implementation* parent = nullptr;
 
   template<typename SegT>
   Trajectory::base_iterator<SegT> make_iterator(
-      internal::SegmentList::iterator it) const
+      Trajectory::Segment* target) const
   {
     Trajectory::base_iterator<SegT> result;
-    result._pimpl->raw_iterator = it;
+    result._pimpl->segment = target;
     result._pimpl->parent = parent;
 
     return result;
   }
 
+  void increment();
+
+  void decrement();
+
   template<typename SegT>
   Trajectory::base_iterator<SegT> post_increment()
   {
     const Trajectory::base_iterator<SegT> old_it =
-        make_iterator<SegT>(raw_iterator);
+        make_iterator<SegT>(segment);
 
-    ++raw_iterator;
+    increment();
 
     return old_it;
   }
@@ -61,9 +71,9 @@ public:
   Trajectory::base_iterator<SegT> post_decrement()
   {
     const Trajectory::base_iterator<SegT> old_it =
-        make_iterator<SegT>(raw_iterator);
+        make_iterator<SegT>(segment);
 
-    --raw_iterator;
+    decrement();
 
     return old_it;
   }
@@ -77,19 +87,16 @@ class Trajectory::Segment::Implementation
 public:
 
   // Note: these fields will be filled in by the
-  // Trajectory::Implementation::insert() function.
-  internal::SegmentList::iterator myself;
+  // Trajectory::Implementation::make_segment() function, and the index will be
+  // kept up to date whenever the SegmentList gets rearranged.
+  std::size_t index;
   Trajectory::Implementation* parent;
 
-  internal::SegmentElement::Data& data()
-  {
-    return myself->data;
-  }
+  /// Get mutable access to the data of this Segment. If the data is currently
+  /// shared with copies of the Trajectory, this will make a private copy first.
+  internal::SegmentElement::Data& data();
 
-  const internal::SegmentElement::Data& data() const
-  {
-    return myself->data;
-  }
+  const internal::SegmentElement::Data& data() const;
 
   Time time() const
   {
@@ -103,132 +110,554 @@ class Trajectory::Implementation
 {
 public:
 
+  using Handles = internal::SmallVector<
+      std::unique_ptr<Segment>, internal::InlineSegmentCapacity>;
+
   std::string map_name;
-  internal::OrderMap ordering;
-  internal::SegmentList segments;
+
+  // The segment data is shared between copies of a Trajectory until one of
+  // them gets modified. Always use modify() or modify_from() to get mutable
+  // access to it.
+  internal::SegmentStorage segments;
+
+  // Each Trajectory has its own Segment objects so that iterators and
+  // references can never be used to modify the data of a different copy. They
+  // are only created the first time that an iterator or reference is needed,
+  // so copies which are never inspected do not pay for them. Once they are
+  // ready, there is exactly one handle for each element of segments.
+  mutable Handles handles;
+  mutable std::atomic_bool handles_ready;
+  mutable std::mutex handles_mutex;
+
+  const internal::SegmentStorage& list() const
+  {
+    return segments;
+  }
+
+  /// Get mutable access to every Segment. They will all be in the tail list
+  /// afterwards, with nothing left in a shared prefix.
+  internal::SegmentList& modify()
+  {
+    if(segments.prefix_size > 0)
+    {
+      const auto merged = std::make_shared<internal::SegmentList>();
+      merged->reserve(segments.size());
+      for(std::size_t i=0; i < segments.size(); ++i)
+        merged->emplace_back(segments[i]);
+
+      segments.prefix.reset();
+      segments.prefix_size = 0;
+      segments.tail = merged;
+    }
+    else
+    {
+      make_tail_unique();
+    }
+
+    return *segments.tail;
+  }
+
+  /// Get mutable access to the Segments from index onwards. The Segments that
+  /// come before index may stay in a prefix that is shared with other copies
+  /// of this Trajectory, so the returned list begins at the Segment of
+  /// segments.prefix_size, which is never greater than index.
+  internal::SegmentList& modify_from(const std::size_t index)
+  {
+    if(index < segments.prefix_size)
+    {
+      // The shared prefix needs to stop at index
+      const auto tail = std::make_shared<internal::SegmentList>();
+      tail->reserve(segments.size() - index);
+      for(std::size_t i = index; i < segments.size(); ++i)
+        tail->emplace_back(segments[i]);
+
+      segments.prefix_size = index;
+      if(index == 0)
+        segments.prefix.reset();
+
+      segments.tail = tail;
+    }
+    else if(segments.prefix_size == 0 && 0 < index
+            && segments.tail.use_count() > 1)
+    {
+      // Only copy the Segments from index onwards, and keep sharing the ones
+      // before it.
+      const internal::SegmentList& shared = *segments.tail;
+      const auto tail = std::make_shared<internal::SegmentList>();
+      tail->reserve(shared.size() - index);
+      for(std::size_t i = index; i < shared.size(); ++i)
+        tail->emplace_back(shared[i]);
+
+      segments.prefix = std::move(segments.tail);
+      segments.prefix_size = index;
+      segments.tail = tail;
+    }
+    else
+    {
+      make_tail_unique();
+    }
+
+    return *segments.tail;
+  }
+
+  void make_tail_unique()
+  {
+    if(segments.tail.use_count() > 1)
+    {
+      segments.tail = std::make_shared<internal::SegmentList>(*segments.tail);
+    }
+    else
+    {
+      // use_count() is a relaxed load. Another copy of this Trajectory might
+      // have just been destroyed on a different thread after reading the
+      // segments, so this fence makes sure that those reads happen before we
+      // write to the segments in place.
+      std::atomic_thread_fence(std::memory_order_acquire);
+    }
+  }
+
+  /// Get the index of the first Segment in [low, high) whose finish_time is
+  /// not less than the given time, or high if there is none.
+  std::size_t search(
+      const Time time, std::size_t low, std::size_t high) const
+  {
+    while(low < high)
+    {
+      const std::size_t mid = low + (high - low)/2;
+      if(segments[mid].data.finish_time < time)
+        low = mid + 1;
+      else
+        high = mid;
+    }
+
+    return low;
+  }
+
+  std::unique_ptr<Segment> make_segment(std::size_t index) const
+  {
+    std::unique_ptr<Segment> seg(new Segment);
+    seg->_pimpl->index = index;
+    seg->_pimpl->parent = const_cast<Implementation*>(this);
+
+    return seg;
+  }
+
+  const Handles& get_handles() const
+  {
+    // Const Trajectories may be inspected by several threads at once, so the
+    // handles need to be created under a lock.
+    if(!handles_ready.load(std::memory_order_acquire))
+    {
+      std::lock_guard<std::mutex> lock(handles_mutex);
+      if(!handles_ready.load(std::memory_order_relaxed))
+      {
+        handles.clear();
+        handles.reserve(list().size());
+        for(std::size_t i=0; i < list().size(); ++i)
+          handles.emplace_back(make_segment(i));
+
+        handles_ready.store(true, std::memory_order_release);
+      }
+    }
+
+    return handles;
+  }
 
   template<typename SegT>
-  base_iterator<SegT> make_iterator(
-      internal::SegmentList::iterator iterator) const
+  base_iterator<SegT> make_iterator(std::size_t index) const
   {
     base_iterator<SegT> it;
-    it._pimpl->raw_iterator = std::move(iterator);
+    it._pimpl->segment =
+        index < list().size()? get_handles()[index].get() : nullptr;
     it._pimpl->parent = this;
 
     return it;
   }
 
-  std::unique_ptr<Segment> make_segment(internal::SegmentList::iterator iterator)
+  /// Make the Segment indices match their positions in the SegmentList for
+  /// every element in the range [from, to).
+  void reindex(std::size_t from, std::size_t to)
   {
-    std::unique_ptr<Segment> seg(new Segment);
-    seg->_pimpl->myself = std::move(iterator);
-    seg->_pimpl->parent = this;
+    for(std::size_t i = from; i < to; ++i)
+      handles[i]->_pimpl->index = i;
+  }
 
-    return seg;
+  void reindex(std::size_t from)
+  {
+    reindex(from, handles.size());
+  }
+
+  /// Move the element at index middle to index first, shifting the elements
+  /// of [first, middle) back by one, or the other way around. This has the
+  /// same semantics as std::rotate.
+  void rotate(std::size_t first, std::size_t middle, std::size_t last)
+  {
+    get_handles();
+    internal::SegmentList& list = modify();
+    std::rotate(list.begin() + first, list.begin() + middle,
+                list.begin() + last);
+    std::rotate(handles.begin() + first, handles.begin() + middle,
+                handles.begin() + last);
+    reindex(first, last);
+  }
+
+  /// Get the index of the first Segment whose finish_time is not less than the
+  /// given time.
+  std::size_t lower_bound(const Time time) const
+  {
+    return search(time, 0, list().size());
+  }
+
+  /// Same as lower_bound(time), but the search starts from the hint index and
+  /// gallops outwards from there. When the answer is at or near the hint, this
+  /// takes constant time, so a scan through monotonically increasing times
+  /// costs amortized O(1) per lookup instead of O(log N).
+  std::size_t lower_bound(const Time time, const std::size_t hint) const
+  {
+    const std::size_t size = segments.size();
+    const auto before = [&](const std::size_t i)
+    {
+      return segments[i].data.finish_time < time;
+    };
+
+    std::size_t low;
+    std::size_t high;
+    if(hint >= size || !before(hint))
+    {
+      // The answer is at or before the hint, so gallop backwards
+      const std::size_t start = std::min(hint, size);
+      if(start == 0 || before(start-1))
+        return start;
+
+      high = start - 1;
+      std::size_t step = 1;
+      while(step <= high && !before(high - step))
+      {
+        high -= step;
+        step *= 2;
+      }
+
+      low = step <= high? high - step + 1 : 0;
+    }
+    else
+    {
+      // The answer is after the hint, so gallop forwards
+      low = hint + 1;
+      std::size_t step = 1;
+      while(low + step - 1 < size && before(low + step - 1))
+      {
+        low += step;
+        step *= 2;
+      }
+
+      high = std::min(low + step - 1, size);
+    }
+
+    return search(time, low, high);
+  }
+
+  /// Get the index of the first Segment in a View that starts at the given
+  /// time.
+  std::size_t view_begin(const Time start, const bool empty) const
+  {
+    if(empty)
+      return list().size();
+
+    return lower_bound(start);
+  }
+
+  /// Get the index after the last Segment in a View that finishes at the given
+  /// time.
+  std::size_t view_end(const Time finish, const bool empty) const
+  {
+    if(empty)
+      return list().size();
+
+    return std::min(lower_bound(finish) + 1, list().size());
   }
 
   Implementation(std::string map_name)
-    : map_name(std::move(map_name))
+    : map_name(std::move(map_name)),
+      segments(std::make_shared<internal::SegmentList>()),
+      handles_ready(false)
   {
     // Do nothing
   }
 
   Implementation(const Implementation& other)
+    : handles_ready(false)
   {
     *this = other;
   }
 
   Implementation& operator=(const Implementation& other)
   {
-    // Start by making a normal copy
+    // We only share the segment data here. This Trajectory will get its own
+    // handles the first time that they are needed.
     map_name = other.map_name;
-    ordering = other.ordering;
     segments = other.segments;
-
-    // Now correct all the iterators to point to the freshly copied container
-    internal::SegmentList::iterator sit = segments.begin();
-    internal::OrderMap::iterator oit = ordering.begin();
-    for( ; sit != segments.end(); ++sit, ++oit)
-    {
-      sit->myself = make_segment(sit);
-      oit->second = sit;
-    }
+    handles.clear();
+    handles_ready.store(false);
 
     return *this;
   }
 
   InsertionResult insert(internal::SegmentElement::Data data)
   {
-    const internal::OrderMap::iterator hint = ordering.lower_bound(data.finish_time);
-    if(hint != ordering.end() && hint->first == data.finish_time)
+    // Segments are usually added in time order, so check the end of the list
+    // before doing a search.
+    const std::size_t index =
+        list().empty() || data.finish_time <= list().back().data.finish_time?
+          lower_bound(data.finish_time) : list().size();
+    if(index < list().size()
+       && list()[index].data.finish_time == data.finish_time)
     {
       // We already have a Segment in the Trajectory that ends at this same
       // exact moment in time, so we will return the existing iterator along
       // with inserted==false.
-      assert(segments.size() > 0);
-      return InsertionResult{make_iterator<Segment>(hint->second), false};
+      return InsertionResult{make_iterator<Segment>(index), false};
     }
 
-    const internal::SegmentList::const_iterator list_destination =
-        (hint == ordering.end()) ? segments.end() : hint->second;
+    get_handles();
+    internal::SegmentList& list = modify();
+    list.emplace(list.begin() + index, std::move(data));
+    handles.emplace(handles.begin() + index, make_segment(index));
+    reindex(index+1);
 
-    const internal::SegmentList::iterator result =
-        segments.emplace(list_destination, std::move(data));
-    result->myself = make_segment(result);
-    assert(segments.size() > 0);
+    return InsertionResult{make_iterator<Segment>(index), true};
+  }
+
+  void push_back(internal::SegmentElement::Data data)
+  {
+    if(!list().empty() && data.finish_time <= list().back().data.finish_time)
+    {
+      // This Segment is out of order, so it needs a regular insertion
+      insert(std::move(data));
+      return;
+    }
 
-    ordering.emplace_hint(hint, data.finish_time, result);
-    assert(ordering.size() > 0);
+    internal::SegmentList& list = modify();
+    list.emplace_back(std::move(data));
 
-    return InsertionResult{make_iterator<Segment>(result), true};
+    // If nothing has asked for the handles yet, we can leave them for later.
+    if(handles_ready.load(std::memory_order_relaxed))
+      handles.emplace_back(make_segment(list.size()-1));
   }
 
-  iterator find(Time time)
+  void reserve(const std::size_t size)
   {
-    const auto it = ordering.lower_bound(time);
-    if(it == ordering.end())
-      return make_iterator<Segment>(segments.end());
+    modify().reserve(size);
+    if(handles_ready.load(std::memory_order_relaxed))
+      handles.reserve(size);
+  }
+
+  void append(const Implementation& other)
+  {
+    const internal::SegmentStorage& source = other.list();
+    if(source.empty())
+      return;
+
+    if(list().empty())
+    {
+      // There is nothing in this Trajectory yet, so we can share the data of
+      // the other Trajectory.
+      segments = other.segments;
+      handles.clear();
+      handles_ready.store(false);
+      return;
+    }
+
+    const Time finish_time = list().back().data.finish_time;
+    const std::size_t first =
+        source.front().data.finish_time == finish_time? 1 : 0;
+
+    if(first < source.size() && source[first].data.finish_time <= finish_time)
+    {
+      throw std::invalid_argument(
+            "[Trajectory::append] The Trajectory being appended begins at "
+            + std::to_string(
+              source[first].data.finish_time.time_since_epoch().count())
+            + "ns, which is before the end of this Trajectory at "
+            + std::to_string(finish_time.time_since_epoch().count()) + "ns.");
+    }
+
+    if(first == source.size())
+      return;
+
+    const std::size_t original_size = list().size();
+    const std::size_t new_size = original_size + source.size() - first;
+    internal::SegmentList& list = modify();
+    list.reserve(new_size);
+    for(std::size_t i = first; i < source.size(); ++i)
+      list.emplace_back(source[i]);
 
+    if(handles_ready.load(std::memory_order_relaxed))
+    {
+      handles.reserve(new_size);
+      for(std::size_t i = original_size; i < new_size; ++i)
+        handles.emplace_back(make_segment(i));
+    }
+  }
+
+  iterator find(Time time)
+  {
     // If the time comes before the start of the Trajectory, then we return
     // the end() iterator
-    if(time < segments.begin()->data.finish_time)
-      return make_iterator<Segment>(segments.end());
+    if(list().empty() || time < list().front().data.finish_time)
+      return end();
 
-    return make_iterator<Segment>(it->second);
+    return make_iterator<Segment>(lower_bound(time));
+  }
+
+  iterator find(Time time, const const_iterator& hint)
+  {
+    if(list().empty() || time < list().front().data.finish_time)
+      return end();
+
+    const std::size_t hint_index = hint._pimpl->segment?
+          hint->_pimpl->index : list().size();
+
+    return make_iterator<Segment>(lower_bound(time, hint_index));
+  }
+
+  std::vector<Eigen::Vector3d> sample_positions(
+      const std::vector<Time>& times) const
+  {
+    if(segments.empty())
+    {
+      throw std::invalid_argument(
+            "[Trajectory::sample_positions] Cannot sample an empty "
+            "Trajectory");
+    }
+
+    const Time start = segments.front().data.finish_time;
+    const Time finish = segments.back().data.finish_time;
+
+    std::vector<Eigen::Vector3d> positions;
+    positions.reserve(times.size());
+
+    // The spline of the most recent segment is kept around, because
+    // consecutive sample times will usually land on the same segment.
+    std::size_t index = 0;
+    std::size_t spline_index = 0;
+    std::unique_ptr<Spline> spline;
+    for(const Time t : times)
+    {
+      if(t < start || finish < t)
+      {
+        throw std::invalid_argument(
+              "[Trajectory::sample_positions] Requested time ["
+              + std::to_string(t.time_since_epoch().count())
+              + "] is outside the range of the Trajectory ["
+              + std::to_string(start.time_since_epoch().count()) + ", "
+              + std::to_string(finish.time_since_epoch().count()) + "]");
+      }
+
+      index = lower_bound(t, index);
+      if(index == 0)
+      {
+        positions.push_back(segments.front().data.position);
+        continue;
+      }
+
+      if(!spline || spline_index != index)
+      {
+        spline = std::make_unique<Spline>(
+              segments[index-1].data, segments[index].data);
+        spline_index = index;
+      }
+
+      positions.push_back(spline->compute_position(t));
+    }
+
+    return positions;
   }
 
   iterator erase(iterator segment)
   {
-    ordering.erase(segment->_pimpl->myself->data.finish_time);
-    return make_iterator<Segment>(segments.erase(segment->_pimpl->myself));
+    const std::size_t index = segment->_pimpl->index;
+    return erase(index, index+1);
   }
 
   iterator erase(iterator first, iterator last)
   {
-    const auto seg_begin = first->_pimpl->myself;
-    const auto seg_end = last._pimpl->raw_iterator == segments.end()?
-          segments.end() : last->_pimpl->myself;
+    // The range might be end() to end(), which has no Segment to get an index
+    // from.
+    if(first == last)
+      return first;
+
+    const std::size_t first_index = first->_pimpl->index;
+    const std::size_t last_index = last._pimpl->segment?
+          last->_pimpl->index : list().size();
+
+    return erase(first_index, last_index);
+  }
+
+  iterator erase(std::size_t first, std::size_t last)
+  {
+    get_handles();
+    internal::SegmentList& list = modify();
+    list.erase(list.begin() + first, list.begin() + last);
+    handles.erase(handles.begin() + first, handles.begin() + last);
+    reindex(first);
+
+    return make_iterator<Segment>(first);
+  }
 
-    const auto order_start = ordering.find(seg_begin->data.finish_time);
-    const auto order_end = seg_end == segments.end()?
-          ordering.end() : ordering.find(seg_end->data.finish_time);
+  /// Get the Segment that follows the given one, or a nullptr if the given
+  /// Segment is the last one.
+  Segment* next(const Segment* segment) const
+  {
+    const std::size_t index = segment->_pimpl->index + 1;
+    return index < handles.size()? handles[index].get() : nullptr;
+  }
 
-    ordering.erase(order_start, order_end);
-    return make_iterator<Segment>(segments.erase(seg_begin, seg_end));
+  /// Get the Segment that precedes the given one. Passing in a nullptr (which
+  /// represents the end() iterator) will give back the last Segment.
+  Segment* previous(const Segment* segment) const
+  {
+    const std::size_t index = segment?
+          segment->_pimpl->index - 1 : get_handles().size() - 1;
+    return handles[index].get();
   }
 
   iterator begin()
   {
-    return make_iterator<Segment>(segments.begin());
+    return make_iterator<Segment>(0);
   }
 
   iterator end()
   {
-    return make_iterator<Segment>(segments.end());
+    return make_iterator<Segment>(list().size());
   }
 
 };
 
+//==============================================================================
+internal::SegmentElement::Data& Trajectory::Segment::Implementation::data()
+{
+  return parent->modify()[index].data;
+}
+
+//==============================================================================
+const internal::SegmentElement::Data&
+Trajectory::Segment::Implementation::data() const
+{
+  return parent->list()[index].data;
+}
+
+//==============================================================================
+void detail::TrajectoryIteratorImplementation::increment()
+{
+  segment = parent->next(segment);
+}
+
+//==============================================================================
+void detail::TrajectoryIteratorImplementation::decrement()
+{
+  segment = parent->previous(segment);
+}
+
 //==============================================================================
 class Trajectory::Profile::Implementation
 {
@@ -425,68 +854,46 @@ Time Trajectory::Segment::get_finish_time() const
 //==============================================================================
 Trajectory::Segment& Trajectory::Segment::set_finish_time(const Time new_time)
 {
-  internal::SegmentList::iterator data_it = _pimpl->myself;
-  internal::SegmentElement::Data& current_data = data_it->data;
-  const Time current_time = current_data.finish_time;
+  Trajectory::Implementation& parent = *_pimpl->parent;
+  const internal::SegmentStorage& segments = parent.list();
+  const std::size_t current = _pimpl->index;
+  const Time current_time = segments[current].data.finish_time;
 
   if(current_time == new_time)
   {
-    // Short-circuit, since nothing is changing. The erase and re-insertion
-    // would be a waste of time in this case.
+    // Short-circuit, since nothing is changing. The rearranging would be a
+    // waste of time in this case.
     return *this;
   }
 
-  internal::OrderMap& ordering = _pimpl->parent->ordering;
-  internal::SegmentList& segments = _pimpl->parent->segments;
-  const internal::OrderMap::const_iterator current_order_it =
-      ordering.find(current_time);
-  assert(current_order_it != ordering.end());
-
-  const internal::OrderMap::const_iterator hint =
-      ordering.lower_bound(new_time);
-
-  if(current_order_it == hint)
+  const std::size_t destination = parent.lower_bound(new_time);
+  if(destination < segments.size() && destination != current
+     && segments[destination].data.finish_time == new_time)
   {
-    // The Segment is already in the correct location within the list, so it
-    // does not need to be moved. We can just update its entry in the OrderMap.
-
-    // We need to create a new_hint iterator which points to the iterator after
-    // hint because the hint iterator will be invalidated when we erase
-    // current_order_it (because they are iterators to the same element).
-    const internal::OrderMap::const_iterator new_hint =
-        ++internal::OrderMap::const_iterator(hint);
-    ordering.erase(current_order_it);
-    ordering.emplace_hint(new_hint, new_time, std::move(data_it));
+    // The new time conflicts with an existing time, so we will throw an
+    // exception.
+    throw std::invalid_argument(
+          "[Trajectory::Segment::set_finish_time] Attempted to set time to "
+          + std::to_string(new_time.time_since_epoch().count())
+          + "ns, but a waypoint already exists at that timestamp.");
   }
-  else if(hint == ordering.end())
+
+  if(destination < current)
   {
-    // This Segment must be moved to the end of the list.
-    segments.splice(segments.end(), segments, data_it);
-    ordering.erase(current_order_it);
-    ordering.emplace_hint(hint, new_time, std::move(data_it));
+    // This Segment must be moved earlier in the list.
+    parent.rotate(destination, current, current + 1);
   }
-  else
+  else if(current + 1 < destination)
   {
-    const internal::SegmentList::const_iterator destination = hint->second;
-    assert(destination != segments.end());
-
-    if(destination->data.finish_time == new_time)
-    {
-      // The new time conflicts with an existing time, so we will throw an
-      // exception.
-      throw std::invalid_argument(
-            "[Trajectory::Segment::set_finish_time] Attempted to set time to "
-            + std::to_string(new_time.time_since_epoch().count())
-            + "ns, but a waypoint already exists at that timestamp.");
-    }
-
-    segments.splice(destination, segments, data_it);
-    ordering.erase(current_order_it);
-    ordering.emplace_hint(hint, new_time, std::move(data_it));
+    // This Segment must be moved later in the list. It will end up in front of
+    // whichever Segment is currently at the destination.
+    parent.rotate(current, current + 1, destination);
   }
 
-  // Update the finish_time value in the data field.
-  current_data.finish_time = new_time;
+  // Update the finish_time value in the data field. If the destination was
+  // either current or current+1 then the Segment is already in the correct
+  // location within the list, so it did not need to be moved.
+  _pimpl->data().finish_time = new_time;
 
   return *this;
 }
@@ -494,22 +901,19 @@ Trajectory::Segment& Trajectory::Segment::set_finish_time(const Time new_time)
 //==============================================================================
 void Trajectory::Segment::adjust_finish_times(Duration delta_t)
 {
-  internal::SegmentList& segments = _pimpl->parent->segments;
-  const internal::SegmentList::iterator begin_it = _pimpl->myself;
-  const Time original_begin_time = begin_it->data.finish_time;
+  const internal::SegmentStorage& segments = _pimpl->parent->list();
+  const std::size_t begin_index = _pimpl->index;
 
-  if(delta_t.count() < 0 && begin_it != segments.begin())
+  if(delta_t.count() < 0 && begin_index > 0)
   {
     // If delta_t is negative and this is not the first Segment in the
     // Trajectory, make sure the change in time does not make it dip beneath its
     // predecessor Segment.
-    const internal::SegmentList::const_iterator predecessor_it =
-        --internal::SegmentList::iterator(begin_it);
-    const auto new_time = begin_it->data.finish_time + delta_t;
-    if(new_time <= predecessor_it->data.finish_time)
+    const internal::SegmentElement& predecessor = segments[begin_index-1];
+    const auto new_time = segments[begin_index].data.finish_time + delta_t;
+    if(new_time <= predecessor.data.finish_time)
     {
-      const auto tp = predecessor_it->data.finish_time
-          .time_since_epoch().count();
+      const auto tp = predecessor.data.finish_time.time_since_epoch().count();
       const auto tc = (new_time).time_since_epoch().count();
 
       const std::string error =
@@ -524,41 +928,23 @@ void Trajectory::Segment::adjust_finish_times(Duration delta_t)
     }
   }
 
-  // Adjust the times for the segments and collect their iterators
-  std::vector<internal::SegmentList::iterator> list_iterators;
-  list_iterators.reserve(segments.size());
-  for(internal::SegmentList::iterator it = begin_it; it != segments.end(); ++it)
-  {
-    it->data.finish_time += delta_t;
-    list_iterators.push_back(it);
-  }
-
-  internal::OrderMap& ordering = _pimpl->parent->ordering;
-  const internal::OrderMap::iterator order_it =
-      ordering.find(original_begin_time);
-  assert(order_it != ordering.end());
-
-  // Erase the existing ordering entries for all the modified Trajectory
-  // Segments.
-  ordering.erase(order_it, ordering.end());
-
-  // Add new entries one at a time, supplying the emplacement operator with the
-  // hint that it can always append the entry to the end of the map.
-  for(internal::SegmentList::iterator& it : list_iterators)
-  {
-    const Time new_time = it->data.finish_time;
-    ordering.emplace_hint(ordering.end(), new_time, std::move(it));
-  }
+  // Shifting every Segment from here to the end by the same amount does not
+  // change their order, so nothing needs to be rearranged. The Segments before
+  // this one are not changing, so they can stay shared with other copies.
+  internal::SegmentList& modified = _pimpl->parent->modify_from(begin_index);
+  const std::size_t offset = _pimpl->parent->segments.prefix_size;
+  for(std::size_t i = begin_index - offset; i < modified.size(); ++i)
+    modified[i].data.finish_time += delta_t;
 }
 
 //==============================================================================
 std::unique_ptr<Motion> Trajectory::Segment::compute_motion() const
 {
-  const internal::SegmentList& segments = _pimpl->parent->segments;
-  const internal::SegmentList::const_iterator& it = _pimpl->myself;
-  const internal::SegmentElement::Data& finish_data = it->data;
+  const internal::SegmentStorage& segments = _pimpl->parent->list();
+  const std::size_t index = _pimpl->index;
+  const internal::SegmentElement::Data& finish_data = segments[index].data;
 
-  if(it == segments.begin())
+  if(index == 0)
   {
     return std::make_unique<SinglePointMotion>(
           finish_data.finish_time,
@@ -566,7 +952,8 @@ std::unique_ptr<Motion> Trajectory::Segment::compute_motion() const
           finish_data.velocity);
   }
 
-  return std::make_unique<SplineMotion>(Spline(it));
+  return std::make_unique<SplineMotion>(
+        Spline(segments[index-1].data, finish_data));
 }
 
 //==============================================================================
@@ -631,6 +1018,34 @@ Trajectory::InsertionResult Trajectory::insert(const Segment& other)
   return _pimpl->insert(internal::SegmentElement::Data{other._pimpl->data()});
 }
 
+//==============================================================================
+void Trajectory::push_back(
+    Time finish_time,
+    ConstProfilePtr profile,
+    Eigen::Vector3d position,
+    Eigen::Vector3d velocity)
+{
+  _pimpl->push_back(
+        internal::SegmentElement::Data{
+          std::move(finish_time),
+          std::move(profile),
+          std::move(position),
+          std::move(velocity)});
+}
+
+//==============================================================================
+void Trajectory::reserve(const std::size_t size)
+{
+  _pimpl->reserve(size);
+}
+
+//==============================================================================
+Trajectory& Trajectory::append(const Trajectory& other)
+{
+  _pimpl->append(*other._pimpl);
+  return *this;
+}
+
 //==============================================================================
 Trajectory::iterator Trajectory::find(Time time)
 {
@@ -643,6 +1058,26 @@ Trajectory::const_iterator Trajectory::find(Time time) const
   return const_cast<Implementation&>(*_pimpl).find(time);
 }
 
+//==============================================================================
+Trajectory::iterator Trajectory::find(Time time, const_iterator hint)
+{
+  return _pimpl->find(time, hint);
+}
+
+//==============================================================================
+Trajectory::const_iterator Trajectory::find(
+    Time time, const_iterator hint) const
+{
+  return const_cast<Implementation&>(*_pimpl).find(time, hint);
+}
+
+//==============================================================================
+std::vector<Eigen::Vector3d> Trajectory::sample_positions(
+    const std::vector<Time>& times) const
+{
+  return _pimpl->sample_positions(times);
+}
+
 //==============================================================================
 Trajectory::iterator Trajectory::erase(iterator segment)
 {
@@ -694,45 +1129,45 @@ Trajectory::const_iterator Trajectory::cend() const
 //==============================================================================
 auto Trajectory::front() -> Segment&
 {
-  return *_pimpl->segments.front().myself;
+  return *_pimpl->get_handles().front();
 }
 
 //==============================================================================
 auto Trajectory::front() const -> const Segment&
 {
-  return *_pimpl->segments.front().myself;
+  return *_pimpl->get_handles().front();
 }
 
 //==============================================================================
 auto Trajectory::back() -> Segment&
 {
-  return *_pimpl->segments.back().myself;
+  return *_pimpl->get_handles().back();
 }
 
 //==============================================================================
 auto Trajectory::back() const -> const Segment&
 {
-  return *_pimpl->segments.back().myself;
+  return *_pimpl->get_handles().back();
 }
 
 //==============================================================================
 const Time* Trajectory::start_time() const
 {
-  const auto& segments = _pimpl->segments;
+  const auto& segments = _pimpl->list();
   return segments.size() == 0? nullptr : &segments.front().data.finish_time;
 }
 
 //==============================================================================
 const Time* Trajectory::finish_time() const
 {
-  const auto& segments = _pimpl->segments;
+  const auto& segments = _pimpl->list();
   return segments.size() == 0? nullptr : &segments.back().data.finish_time;
 }
 
 //==============================================================================
 Duration Trajectory::duration() const
 {
-  const auto& segments = _pimpl->segments;
+  const auto& segments = _pimpl->list();
   return segments.size() < 2?
         Duration(0) :
         segments.back().data.finish_time - segments.front().data.finish_time;
@@ -741,28 +1176,106 @@ Duration Trajectory::duration() const
 //==============================================================================
 std::size_t Trajectory::size() const
 {
-  return _pimpl->segments.size();
+  return _pimpl->list().size();
+}
+
+//==============================================================================
+Trajectory::View::View(const Trajectory& trajectory)
+  : _trajectory(&trajectory),
+    _empty(trajectory.size() == 0)
+{
+  if(!_empty)
+  {
+    _start = *trajectory.start_time();
+    _finish = *trajectory.finish_time();
+  }
+}
+
+//==============================================================================
+Trajectory::View::View(
+    const Trajectory& trajectory,
+    const Time start,
+    const Time finish)
+  : View(trajectory)
+{
+  if(_empty)
+    return;
+
+  _start = std::max(_start, start);
+  _finish = std::min(_finish, finish);
+  _empty = _finish < _start;
+}
+
+//==============================================================================
+const Trajectory& Trajectory::View::get_trajectory() const
+{
+  return *_trajectory;
+}
+
+//==============================================================================
+const Time* Trajectory::View::start_time() const
+{
+  return _empty? nullptr : &_start;
+}
+
+//==============================================================================
+const Time* Trajectory::View::finish_time() const
+{
+  return _empty? nullptr : &_finish;
+}
+
+//==============================================================================
+Duration Trajectory::View::duration() const
+{
+  return _empty? Duration(0) : _finish - _start;
+}
+
+//==============================================================================
+auto Trajectory::View::begin() const -> const_iterator
+{
+  const Implementation& impl = *_trajectory->_pimpl;
+  return impl.make_iterator<const Segment>(impl.view_begin(_start, _empty));
+}
+
+//==============================================================================
+auto Trajectory::View::end() const -> const_iterator
+{
+  const Implementation& impl = *_trajectory->_pimpl;
+  return impl.make_iterator<const Segment>(impl.view_end(_finish, _empty));
+}
+
+//==============================================================================
+std::size_t Trajectory::View::size() const
+{
+  const Implementation& impl = *_trajectory->_pimpl;
+  return impl.view_end(_finish, _empty) - impl.view_begin(_start, _empty);
+}
+
+//==============================================================================
+bool Trajectory::View::empty() const
+{
+  return _empty;
 }
 
 //==============================================================================
 template<typename SegT>
 SegT& Trajectory::base_iterator<SegT>::operator*() const
 {
-  return *_pimpl->raw_iterator->myself;
+  return *_pimpl->segment;
 }
 
 //==============================================================================
 template<typename SegT>
 SegT* Trajectory::base_iterator<SegT>::operator->() const
 {
-  return _pimpl->raw_iterator->myself.get();
+  return _pimpl->segment;
 }
 
 //==============================================================================
 template<typename SegT>
 auto Trajectory::base_iterator<SegT>::operator++() -> base_iterator&
 {
-  ++_pimpl->raw_iterator;
+  _pimpl->increment();
   return *this;
 }
 
@@ -770,7 +1283,7 @@ auto Trajectory::base_iterator<SegT>::operator++() -> base_iterator&
 template<typename SegT>
 auto Trajectory::base_iterator<SegT>::operator--() -> base_iterator&
 {
-  --_pimpl->raw_iterator;
+  _pimpl->decrement();
   return *this;
 }
 
@@ -789,25 +1302,29 @@ auto Trajectory::base_iterator<SegT>::operator--(int) -> base_iterator
 }
 
 //==============================================================================
-#define DEFINE_BASIC_ITERATOR_OP(op) \
-  template<typename SegT> \
-  bool Trajectory::base_iterator<SegT>::operator op ( \
-      const base_iterator& other) const \
-  { \
-    return _pimpl->raw_iterator op other._pimpl->raw_iterator; \
-  }
+template<typename SegT>
+bool Trajectory::base_iterator<SegT>::operator==(
+    const base_iterator& other) const
+{
+  return _pimpl->segment == other._pimpl->segment
+      && _pimpl->parent == other._pimpl->parent;
+}
 
-DEFINE_BASIC_ITERATOR_OP(==)
-DEFINE_BASIC_ITERATOR_OP(!=)
+//==============================================================================
+template<typename SegT>
+bool Trajectory::base_iterator<SegT>::operator!=(
+    const base_iterator& other) const
+{
+  return !(*this == other);
+}
 
+//==============================================================================
 template<typename SegT>
 bool Trajectory::base_iterator<SegT>::operator<(
     const base_iterator& other) const
 {
-  const bool this_is_end =
-      this->_pimpl->raw_iterator == _pimpl->parent->segments.end();
-  const bool other_is_end =
-      other._pimpl->raw_iterator == _pimpl->parent->segments.end();
+  const bool this_is_end = !this->_pimpl->segment;
+  const bool other_is_end = !other._pimpl->segment;
 
   if(this_is_end || other_is_end)
   {
@@ -820,8 +1337,8 @@ bool Trajectory::base_iterator<SegT>::operator<(
   }
 
   // If they are both valid iterators, then we can compare their times.
-  return this->_pimpl->raw_iterator->data.finish_time
-      < other._pimpl->raw_iterator->data.finish_time;
+  return this->_pimpl->segment->get_finish_time()
+      < other._pimpl->segment->get_finish_time();
 }
 
 //==============================================================================
@@ -829,10 +1346,8 @@ template<typename SegT>
 bool Trajectory::base_iterator<SegT>::operator>(
     const base_iterator& other) const
 {
-  const bool this_is_end =
-      this->_pimpl->raw_iterator == _pimpl->parent->segments.end();
-  const bool other_is_end =
-      other._pimpl->raw_iterator == _pimpl->parent->segments.end();
+  const bool this_is_end = !this->_pimpl->segment;
+  const bool other_is_end = !other._pimpl->segment;
 
   if(this_is_end || other_is_end)
   {
@@ -842,8 +1357,8 @@ bool Trajectory::base_iterator<SegT>::operator>(
   }
 
   // If they are both valid iterators, then we can compare their times.
-  return this->_pimpl->raw_iterator->data.finish_time
-      > other._pimpl->raw_iterator->data.finish_time;
+  return this->_pimpl->segment->get_finish_time()
+      > other._pimpl->segment->get_finish_time();
 }
 
 //==============================================================================
@@ -866,7 +1381,7 @@ bool Trajectory::base_iterator<SegT>::operator>=(
 template<typename SegT>
 Trajectory::base_iterator<SegT>::operator const_iterator() const
 {
-  return _pimpl->make_iterator<const SegT>(_pimpl->raw_iterator);
+  return _pimpl->make_iterator<const SegT>(_pimpl->segment);
 }
 
 //==============================================================================
@@ -887,56 +1402,49 @@ bool Trajectory::Debug::check_iterator_time_consistency(
 {
   assert(trajectory._pimpl);
 
-  const internal::SegmentList& segments = trajectory._pimpl->segments;
-  const internal::OrderMap& ordering = trajectory._pimpl->ordering;
-
-  bool consistent = true;
+  const internal::SegmentStorage& segments = trajectory._pimpl->list();
+  const auto& handles = trajectory._pimpl->handles;
+  const bool handles_ready = trajectory._pimpl->handles_ready;
 
-  internal::SegmentList::const_iterator s_it = segments.begin();
-  internal::OrderMap::const_iterator o_it = ordering.begin();
-  for( ; s_it != segments.end() && o_it != ordering.end(); ++s_it, ++o_it)
+  // The segments must be sorted by finish_time without any duplicates, and
+  // every Segment handle (if they have been created yet) must know its own
+  // position within the list.
+  bool consistent = !handles_ready || handles.size() == segments.size();
+  for(std::size_t i=0; i < segments.size(); ++i)
   {
-    consistent &= s_it->data.finish_time == o_it->first;
-  }
-
-  consistent &= s_it == segments.end();
-  consistent &= o_it == ordering.end();
-
-  if(print_inconsistency && !consistent)
-  {
-    std::size_t index = 0;
-    s_it = segments.begin();
-    o_it = ordering.begin();
-    std::cout << "Trajectory time inconsistency detected: "
-              << "( ordering | segments | difference )\n";
-    for( ; s_it != segments.end() && o_it != ordering.end();
-         ++s_it, ++o_it, ++index)
+    if(handles_ready && i < handles.size())
     {
-      const auto difference = o_it->first - s_it->data.finish_time;
-      std::cout << " -- [" << index << "] "
-                << o_it->first.time_since_epoch().count()/1e9 << " | "
-                << s_it->data.finish_time.time_since_epoch().count()/1e9
-                << " | Difference: " << difference.count()/1e9 << "\n";
+      const auto& segment_pimpl = handles[i]->_pimpl;
+      consistent &= segment_pimpl->index == i;
+      consistent &= segment_pimpl->parent == trajectory._pimpl.get();
     }
 
-    if(s_it != segments.end())
+    if(i > 0)
     {
-      std::cout << " -- more elements in segments\n";
-      for( ; s_it != segments.end(); ++s_it, ++index)
-      {
-        std::cout << "      -- [" << index << "] "
-                  << s_it->data.finish_time.time_since_epoch().count()/1e9
-                  << "\n";
-      }
+      consistent &=
+          segments[i-1].data.finish_time < segments[i].data.finish_time;
     }
-    if(o_it != ordering.end())
+  }
+
+  if(print_inconsistency && !consistent)
+  {
+    std::cout << "Trajectory time inconsistency detected: "
+              << "( index | stored index | time | difference )\n";
+    for(std::size_t i=0; i < segments.size(); ++i)
     {
-      std::cout << " -- more elements in ordering:\n";
-      for( ; o_it != ordering.end(); ++o_it, ++index)
-      {
-        std::cout << "     -- [" << index << "] "
-                  << o_it->first.time_since_epoch().count()/1e9 << "\n";
-      }
+      const double difference = i == 0? 0.0 :
+          (segments[i].data.finish_time
+           - segments[i-1].data.finish_time).count()/1e9;
+
+      std::cout << " -- [" << i << "] ";
+      if(handles_ready && i < handles.size())
+        std::cout << handles[i]->_pimpl->index;
+      else
+        std::cout << "-";
+
+      std::cout << " | "
+                << segments[i].data.finish_time.time_since_epoch().count()/1e9
+                << " | Difference: " << difference << "\n";
     }
     std::cout << std::endl;
   }
@@ -944,4 +1452,22 @@ bool Trajectory::Debug::check_iterator_time_consistency(
   return consistent;
 }
 
+//==============================================================================
+std::size_t Trajectory::Debug::count_shared_segments(
+    const Trajectory& a, const Trajectory& b)
+{
+  const internal::SegmentStorage& segments_a = a._pimpl->list();
+  const internal::SegmentStorage& segments_b = b._pimpl->list();
+
+  std::size_t count = 0;
+  const std::size_t size = std::min(segments_a.size(), segments_b.size());
+  for(std::size_t i=0; i < size; ++i)
+  {
+    if(&segments_a[i] == &segments_b[i])
+      ++count;
+  }
+
+  return count;
+}
+
 } // namespace rmf_traffic
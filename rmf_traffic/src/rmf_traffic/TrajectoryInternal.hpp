@@ -20,17 +20,14 @@
 
 #include <rmf_traffic/Trajectory.hpp>
 
-#include <list>
-#include <map>
+#include "SmallVector.hpp"
+
+#include <memory>
 
 namespace rmf_traffic {
 namespace internal {
 
 //==============================================================================
-struct SegmentElement;
-using SegmentList = std::list<SegmentElement>;
-using OrderMap = std::map<Time, SegmentList::iterator>;
-
 struct SegmentElement
 {
   struct Data
@@ -43,32 +40,77 @@ struct SegmentElement
 
   Data data;
 
-  // We store a Trajectory::Segment in this struct so that we can always safely
-  // return a reference to a Trajectory::Segment object. As long as this
-  // SegmentData is alive, any Trajectory::Segment reference that refers to it
-  // will remain valid.
-  std::unique_ptr<Trajectory::Segment> myself;
-
   SegmentElement(Data input_data)
     : data(std::move(input_data))
   {
     // Do nothing
   }
+};
+
+//==============================================================================
+/// Most of the Trajectories that get produced by the planner only have a
+/// handful of Segments, so this many Segments can be stored without needing
+/// any heap allocations beyond the ones for the Trajectory itself.
+constexpr std::size_t InlineSegmentCapacity = 4;
+
+//==============================================================================
+/// The Segments of a Trajectory are kept contiguously in a vector which is
+/// always sorted by finish_time, so that lookups can use a binary search and
+/// iterating through the Trajectory has good memory locality.
+///
+/// A SegmentList may be shared by any number of Trajectory copies. It must not
+/// be modified while it is shared; see Trajectory::Implementation::modify().
+using SegmentList = SmallVector<SegmentElement, InlineSegmentCapacity>;
+using SharedSegmentList = std::shared_ptr<SegmentList>;
+
+//==============================================================================
+/// The Segments of a Trajectory. They are normally all kept in the tail list,
+/// but when only the later Segments of a copy get modified (e.g. to delay it),
+/// the earlier ones are left in a prefix which is still shared with the
+/// Trajectory that it was copied from. The prefix consists of the first
+/// prefix_size elements of its list, and the tail holds everything after that.
+///
+/// The prefix list is never modified through this storage. It may hold more
+/// elements than prefix_size, but only those first ones belong to this
+/// Trajectory.
+struct SegmentStorage
+{
+  SharedSegmentList prefix;
+  std::size_t prefix_size = 0;
+  SharedSegmentList tail;
+
+  SegmentStorage() = default;
 
-  SegmentElement(const SegmentElement& other)
-    : data(other.data)
+  explicit SegmentStorage(SharedSegmentList tail_)
+    : tail(std::move(tail_))
   {
     // Do nothing
   }
 
-  SegmentElement& operator=(const SegmentElement& other)
+  std::size_t size() const
   {
-    data = other.data;
-    return *this;
+    return prefix_size + tail->size();
   }
 
-  SegmentElement(SegmentElement&&) = default;
-  SegmentElement& operator=(SegmentElement&&) = default;
+  bool empty() const
+  {
+    return size() == 0;
+  }
+
+  const SegmentElement& operator[](const std::size_t i) const
+  {
+    return i < prefix_size? (*prefix)[i] : (*tail)[i - prefix_size];
+  }
+
+  const SegmentElement& front() const
+  {
+    return (*this)[0];
+  }
+
+  const SegmentElement& back() const
+  {
+    return (*this)[size()-1];
+  }
 };
 
 } // namespace internal
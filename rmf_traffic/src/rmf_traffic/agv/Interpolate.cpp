@@ -119,7 +119,7 @@ void interpolate_translation(
 
     const Eigen::Vector3d p{p_s[0], p_s[1], heading};
     const Eigen::Vector3d v{v_s[0], v_s[1], 0.0};
-    trajectory.insert(state.t, profile, p, v);
+    trajectory.push_back(state.t, profile, p, v);
   }
 }
 
@@ -155,7 +155,7 @@ void interpolate_rotation(
 
     const Eigen::Vector3d p{finish[0], finish[1], s};
     const Eigen::Vector3d v{0.0, 0.0, w};
-    trajectory.insert(state.t, profile, p, v);
+    trajectory.push_back(state.t, profile, p, v);
   }
 }
 } // namespace internal
@@ -346,7 +346,7 @@ Trajectory Interpolate::positions(
   if(input_positions.empty())
     return trajectory;
 
-  trajectory.insert(
+  trajectory.push_back(
         start_time,
         traits.get_profile(),
         input_positions.front(),
@@ -117,6 +117,7 @@ public:
   Duration min_hold_time;
   const bool* interrupt_flag;
   std::unordered_set<schedule::Version> ignore_schedule_ids;
+  std::size_t validation_threads;
 
 };
 
@@ -131,7 +132,8 @@ Planner::Options::Options(
                &viewer,
                min_hold_time,
                interrupt_flag,
-               std::move(ignore_ids)
+               std::move(ignore_ids),
+               1
              }))
 {
   // Do nothing
@@ -193,6 +195,20 @@ std::unordered_set<schedule::Version> Planner::Options
   return _pimpl->ignore_schedule_ids;
 }
 
+//==============================================================================
+auto Planner::Options::validation_threads(const std::size_t num_threads)
+-> Options&
+{
+  _pimpl->validation_threads = num_threads;
+  return *this;
+}
+
+//==============================================================================
+std::size_t Planner::Options::validation_threads() const
+{
+  return _pimpl->validation_threads;
+}
+
 //==============================================================================
 class Planner::Start::Implementation
 {
@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include "ValidationPool.hpp"
+
+namespace rmf_traffic {
+namespace internal {
+namespace planning {
+
+//==============================================================================
+ValidationPool::ValidationPool(const std::size_t num_threads)
+  : _next(0),
+    _found(false)
+{
+  for(std::size_t i=1; i < num_threads; ++i)
+    _threads.emplace_back([this]() { this->_work(); });
+}
+
+//==============================================================================
+bool ValidationPool::any_of(const std::size_t count, const Predicate& predicate)
+{
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _predicate = &predicate;
+    _count = count;
+    _next = 0;
+    _found = false;
+    _error = nullptr;
+    _active = _threads.size();
+    ++_generation;
+  }
+  _start_cv.notify_all();
+
+  _consume();
+
+  // The predicate belongs to the caller, so we must not return, even with an
+  // exception, until every worker is done with it.
+  std::unique_lock<std::mutex> lock(_mutex);
+  _done_cv.wait(lock, [&]() { return _active == 0; });
+  _predicate = nullptr;
+
+  if(_error)
+  {
+    std::exception_ptr error = nullptr;
+    std::swap(error, _error);
+    std::rethrow_exception(error);
+  }
+
+  return _found;
+}
+
+//==============================================================================
+std::size_t ValidationPool::size() const
+{
+  return _threads.size() + 1;
+}
+
+//==============================================================================
+ValidationPool::~ValidationPool()
+{
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _quit = true;
+  }
+  _start_cv.notify_all();
+
+  for(auto& thread : _threads)
+    thread.join();
+}
+
+//==============================================================================
+void ValidationPool::_work()
+{
+  std::size_t last_generation = 0;
+  while(true)
+  {
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _start_cv.wait(lock, [&]()
+      {
+        return _quit || _generation != last_generation;
+      });
+
+      if(_quit)
+        return;
+
+      last_generation = _generation;
+    }
+
+    _consume();
+
+    bool finished = false;
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      finished = (--_active == 0);
+    }
+
+    if(finished)
+      _done_cv.notify_one();
+  }
+}
+
+//==============================================================================
+void ValidationPool::_consume()
+{
+  while(!_found.load(std::memory_order_relaxed))
+  {
+    const std::size_t i = _next.fetch_add(1, std::memory_order_relaxed);
+    if(i >= _count)
+      return;
+
+    try
+    {
+      if((*_predicate)(i))
+      {
+        _found = true;
+        return;
+      }
+    }
+    catch(...)
+    {
+      {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if(!_error)
+          _error = std::current_exception();
+      }
+
+      _found = true;
+      return;
+    }
+  }
+}
+
+} // namespace planning
+} // namespace internal
+} // namespace rmf_traffic
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef SRC__RMF_TRAFFIC__AGV__VALIDATIONPOOL_HPP
+#define SRC__RMF_TRAFFIC__AGV__VALIDATIONPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rmf_traffic {
+namespace internal {
+namespace planning {
+
+//==============================================================================
+/// A small pool of worker threads that the planner uses to check a candidate
+/// trajectory against many schedule entries at once. The thread that calls
+/// any_of() participates in the work, so a pool of size N keeps N-1 workers.
+class ValidationPool
+{
+public:
+
+  using Predicate = std::function<bool(std::size_t)>;
+
+  /// Create a pool that will use num_threads threads (including the caller)
+  ValidationPool(std::size_t num_threads);
+
+  /// Returns true if predicate(i) is true for any i in [0, count). Once any
+  /// thread finds a true value, the remaining indices will not be checked.
+  ///
+  /// If the predicate throws an exception on any thread, the remaining
+  /// indices will not be checked, and the first exception will be rethrown
+  /// here once every thread has stopped using the predicate.
+  bool any_of(std::size_t count, const Predicate& predicate);
+
+  /// The number of threads that any_of() will use, including the caller
+  std::size_t size() const;
+
+  ~ValidationPool();
+
+  // The workers refer back to this object, so it cannot be moved or copied
+  ValidationPool(const ValidationPool&) = delete;
+  ValidationPool& operator=(const ValidationPool&) = delete;
+
+private:
+
+  void _work();
+
+  void _consume();
+
+  std::vector<std::thread> _threads;
+
+  std::mutex _mutex;
+  std::condition_variable _start_cv;
+  std::condition_variable _done_cv;
+  std::size_t _generation = 0;
+  std::size_t _active = 0;
+  bool _quit = false;
+
+  const Predicate* _predicate = nullptr;
+  std::size_t _count = 0;
+  std::atomic<std::size_t> _next;
+  std::atomic_bool _found;
+
+  // The first exception thrown by the predicate. This is guarded by _mutex.
+  std::exception_ptr _error;
+};
+
+} // namespace planning
+} // namespace internal
+} // namespace rmf_traffic
+
+#endif // SRC__RMF_TRAFFIC__AGV__VALIDATIONPOOL_HPP
@@ -19,6 +19,7 @@
 #include "internal_Planner.hpp"
 #include "internal_planning.hpp"
 #include "GraphInternal.hpp"
+#include "ValidationPool.hpp"
 
 #include <rmf_utils/math.hpp>
 
@@ -178,8 +179,9 @@ std::vector<Trajectory> reconstruct_trajectories(const NodePtr& finish_node)
     const Trajectory& next_trajectory = (*it)->trajectory_from_parent;
     if(next_trajectory.get_map_name() == last_trajectory.get_map_name())
     {
-      for(const auto& segment : next_trajectory)
-        last_trajectory.insert(segment);
+      // Each trajectory begins where its parent's trajectory ended, so they
+      // can be joined end to end.
+      last_trajectory.append(next_trajectory);
     }
     else
     {
@@ -616,6 +618,7 @@ struct DifferentialDriveExpander
     const bool* const interrupt_flag;
     const std::unordered_set<schedule::Version> ignore_schedule_ids;
     Heuristic& heuristic;
+    ValidationPool* const validation_pool;
   };
 
   DifferentialDriveExpander(Context& context)
@@ -844,6 +847,39 @@ struct DifferentialDriveExpander
     const auto view = _context.viewer.query(_query);
 
     const auto& ignore_schedule_ids = _context.ignore_schedule_ids;
+
+    ValidationPool* const pool = _context.validation_pool;
+    if (pool)
+    {
+      _checks.clear();
+      for (const auto& check : view)
+      {
+        if (ignore_schedule_ids.count(check.id) == 0)
+          _checks.push_back(&check.trajectory);
+      }
+
+      // It is not worth waking up the workers unless each of them will have
+      // a few trajectories to check.
+      if (_checks.size() >= 2*pool->size())
+      {
+        return !pool->any_of(_checks.size(), [&](const std::size_t i) -> bool
+        {
+          assert(_checks[i]->size() > 1);
+          return !DetectConflict::between(
+                trajectory, *_checks[i], true).empty();
+        });
+      }
+
+      for (const Trajectory* check : _checks)
+      {
+        assert(check->size() > 1);
+        if(!DetectConflict::between(trajectory, *check, true).empty())
+          return false;
+      }
+
+      return true;
+    }
+
     if (ignore_schedule_ids.empty())
     {
       for (const auto& check : view)
@@ -1295,6 +1331,9 @@ private:
   schedule::Query _query;
   DifferentialDriveConstraint _differential_constraint;
   LaneEventExecutor _executor;
+
+  // Reused by is_valid() when validation is spread across a ValidationPool
+  std::vector<const Trajectory*> _checks;
 };
 
 //==============================================================================
@@ -1349,6 +1388,13 @@ public:
           std::make_pair(goal_waypoint, Heuristic{})).first->second;
     const bool* const interrupt_flag = options.interrupt_flag();
 
+    std::unique_ptr<ValidationPool> validation_pool;
+    if (options.validation_threads() > 1)
+    {
+      validation_pool =
+          std::make_unique<ValidationPool>(options.validation_threads());
+    }
+
     const NodePtr solution = search<DifferentialDriveExpander>(
           DifferentialDriveExpander::Context{
             _graph,
@@ -1362,7 +1408,8 @@ public:
             starts.front().time(),
             interrupt_flag,
             options.ignore_schedule_ids(),
-            h
+            h,
+            validation_pool.get()
           },
           DifferentialDriveExpander::InitialNodeArgs{starts},
           interrupt_flag);
@@ -28,6 +28,11 @@ public:
 
   static bool check_iterator_time_consistency(
       const Trajectory& trajectory, bool print_inconsistency);
+
+  /// Count the Segments that a and b have stored in the same memory at the
+  /// same index.
+  static std::size_t count_shared_segments(
+      const Trajectory& a, const Trajectory& b);
 };
 
 
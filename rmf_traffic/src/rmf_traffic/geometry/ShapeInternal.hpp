@@ -78,7 +78,8 @@ class FinalConvexShape::Implementation
 {
 public:
 
-  static CollisionGeometryPtr get_collision(const FinalConvexShape& shape)
+  static const CollisionGeometryPtr& get_collision(
+      const FinalConvexShape& shape)
   {
     return shape._pimpl->_collisions.front();
   }
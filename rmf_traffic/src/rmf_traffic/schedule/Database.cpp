@@ -15,7 +15,7 @@
  *
 */
 
-#include "ViewerInternal.hpp"
+#include "DatabaseInternal.hpp"
 
 #include "../detail/internal_bidirectional_iterator.hpp"
 
@@ -714,7 +714,7 @@ void ChangeRelevanceInspector::inspect(
       // that is the case, then we can skip recording all of the changes and
       // just use a single replace from the old version number to the current
       // version of the trajectory.
-      ConstEntryPtr record = record_changes_from->succeeded_by;
+      const Entry* record = record_changes_from->succeeded_by;
       while(record)
       {
         relevant_changes.emplace_back(*record->change);
@@ -766,7 +766,7 @@ void ChangeRelevanceInspector::inspect(
     if(trajectory.start_time())
     {
       return rmf_traffic::internal::detect_conflicts(
-            e->trajectory, spacetime, nullptr);
+            e->trajectory, spacetime, nullptr, e->get_bounds());
     }
     else
     {
@@ -802,19 +802,387 @@ void ChangeRelevanceInspector::inspect(
   });
 }
 
+//==============================================================================
+namespace {
+
+struct RegionCheck
+{
+  const std::string* map;
+  rmf_traffic::internal::Spacetime spacetime;
+  rmf_traffic::internal::BoundingBox bounds;
+};
+
+} // anonymous namespace
+
+//==============================================================================
+void ChangeRelevanceInspector::inspect_log(
+    const ChangeLog& log,
+    const Query::Spacetime& spacetime)
+{
+  assert(after_version);
+
+  // The regions are flattened out ahead of time so that their bounding boxes
+  // only get computed once.
+  std::vector<RegionCheck> regions;
+  std::function<bool(const ConstEntryPtr&)> relevant;
+
+  // We use a switch here so that we'll get a compiler warning if a new
+  // Spacetime::Mode type is ever added and we forget to handle it.
+  switch(spacetime.get_mode())
+  {
+    case Query::Spacetime::Mode::Invalid:
+    {
+      throw std::runtime_error(
+          "[rmf_traffic::schedule::Database] Invalid Query::Spacetime::Mode "
+          "used. Please report this as a bug.");
+    }
+
+    case Query::Spacetime::Mode::All:
+    {
+      relevant = [](const ConstEntryPtr& e) -> bool
+      {
+        // Erasure entries have no trajectory
+        return e->trajectory.start_time() != nullptr;
+      };
+      break;
+    }
+
+    case Query::Spacetime::Mode::Regions:
+    {
+      assert(spacetime.regions() != nullptr);
+      for(const Region& region : *spacetime.regions())
+      {
+        for(auto space_it = region.begin();
+            space_it != region.end(); ++space_it)
+        {
+          RegionCheck check;
+          check.map = &region.get_map();
+          check.spacetime.lower_time_bound = region.get_lower_time_bound();
+          check.spacetime.upper_time_bound = region.get_upper_time_bound();
+          check.spacetime.pose = space_it->get_pose();
+          check.spacetime.shape = space_it->get_shape();
+          check.bounds = rmf_traffic::internal::get_bounding_box(
+                check.spacetime.pose, *check.spacetime.shape);
+          regions.emplace_back(std::move(check));
+        }
+      }
+
+      // The bounds pointers must not be set until the vector is done growing
+      for(RegionCheck& check : regions)
+        check.spacetime.bounds = &check.bounds;
+
+      relevant = [&regions](const ConstEntryPtr& e) -> bool
+      {
+        const Trajectory& trajectory = e->trajectory;
+        if(!trajectory.start_time())
+          return false;
+
+        for(const RegionCheck& check : regions)
+        {
+          if(*check.map != trajectory.get_map_name())
+            continue;
+
+          if(rmf_traffic::internal::detect_conflicts(
+               trajectory, check.spacetime, nullptr, e->get_bounds()))
+            return true;
+        }
+
+        return false;
+      };
+      break;
+    }
+
+    case Query::Spacetime::Mode::Timespan:
+    {
+      assert(spacetime.timespan() != nullptr);
+      const Query::Spacetime::Timespan& timespan = *spacetime.timespan();
+      relevant = [&timespan](const ConstEntryPtr& e) -> bool
+      {
+        const Trajectory& trajectory = e->trajectory;
+        if(!trajectory.start_time())
+          return false;
+
+        if(timespan.get_maps().count(trajectory.get_map_name()) == 0)
+          return false;
+
+        const Time* const lower_time_bound = timespan.get_lower_time_bound();
+        if(lower_time_bound && *trajectory.finish_time() < *lower_time_bound)
+          return false;
+
+        const Time* const upper_time_bound = timespan.get_upper_time_bound();
+        if(upper_time_bound && *upper_time_bound < *trajectory.start_time())
+          return false;
+
+        return true;
+      };
+      break;
+    }
+  }
+
+  // The log is sorted by version, so everything that the remote mirror has not
+  // seen yet is at the end of it. Any entry that has been succeeded will be
+  // skipped by inspect(), and its successor will come later in the log.
+  auto it = std::upper_bound(
+        log.begin(), log.end(), *after_version,
+        [&](const Version v, const ConstEntryPtr& e) -> bool
+  {
+    return versions.less(v, e->version);
+  });
+
+  for(; it != log.end(); ++it)
+    inspect(*it, relevant);
+}
+
 } // namespace internal
 
 //==============================================================================
-Database::Database()
+Database::Batch::Batch()
+  : _pimpl(rmf_utils::make_impl<Implementation>())
 {
   // Do nothing
 }
 
+//==============================================================================
+auto Database::Batch::insert(Trajectory trajectory) -> Batch&
+{
+  _pimpl->add(Change::Mode::Insert, 0, std::move(trajectory));
+  return *this;
+}
+
+//==============================================================================
+auto Database::Batch::interrupt(
+    const Version id,
+    Trajectory interruption_trajectory,
+    const Duration delay) -> Batch&
+{
+  _pimpl->add(
+        Change::Mode::Interrupt, id, std::move(interruption_trajectory),
+        Time(), delay);
+  return *this;
+}
+
+//==============================================================================
+auto Database::Batch::delay(
+    const Version id,
+    const Time from,
+    const Duration delay) -> Batch&
+{
+  _pimpl->add(Change::Mode::Delay, id, rmf_utils::nullopt, from, delay);
+  return *this;
+}
+
+//==============================================================================
+auto Database::Batch::replace(
+    const Version previous_id,
+    Trajectory trajectory) -> Batch&
+{
+  _pimpl->add(Change::Mode::Replace, previous_id, std::move(trajectory));
+  return *this;
+}
+
+//==============================================================================
+auto Database::Batch::erase(const Version id) -> Batch&
+{
+  _pimpl->add(Change::Mode::Erase, id);
+  return *this;
+}
+
+//==============================================================================
+std::size_t Database::Batch::size() const
+{
+  return _pimpl->items.size();
+}
+
+namespace {
+//==============================================================================
+void inspect_snapshot_map(
+    const internal::MapSnapshot& map,
+    const Time* const lower_time_bound,
+    const Time* const upper_time_bound,
+    const std::function<void(const internal::ConstEntryPtr&)>& inspect)
+{
+  const auto range = map.get_range(lower_time_bound, upper_time_bound);
+  for(std::size_t i = range.first; i < range.second; ++i)
+  {
+    const internal::ConstEntryPtr& entry = map.entries[i];
+    const Trajectory& trajectory = entry->trajectory;
+    if(lower_time_bound && *trajectory.finish_time() < *lower_time_bound)
+      continue;
+
+    inspect(entry);
+  }
+}
+} // anonymous namespace
+
+//==============================================================================
+Viewer::View Database::Snapshot::query(const Query& parameters) const
+{
+  const internal::SnapshotData& data = *_pimpl->data;
+
+  const Query::Versions& versions = parameters.versions();
+  Version after_version;
+  const Version* after = nullptr;
+  switch(versions.get_mode())
+  {
+    case Query::Versions::Mode::Invalid:
+    {
+      throw std::runtime_error(
+          "[rmf_traffic::schedule::Database::Snapshot] Invalid "
+          "Query::Version::Mode used. Please report this as a bug.");
+    }
+    case Query::Versions::Mode::All:
+    {
+      // Do nothing
+      break;
+    }
+    case Query::Versions::Mode::After:
+    {
+      assert(versions.after() != nullptr);
+      after_version = versions.after()->get_version();
+      after = &after_version;
+      break;
+    }
+  }
+
+  const internal::VersionRange range;
+  std::vector<Viewer::View::Element> elements;
+  const auto add = [&](const internal::ConstEntryPtr& entry)
+  {
+    if(after && range.less_or_equal(entry->version, *after))
+      return;
+
+    elements.emplace_back(
+          Viewer::View::Element{entry->version, entry->trajectory});
+  };
+
+  const Query::Spacetime& spacetime = parameters.spacetime();
+  switch(spacetime.get_mode())
+  {
+    case Query::Spacetime::Mode::Invalid:
+    {
+      throw std::runtime_error(
+          "[rmf_traffic::schedule::Database::Snapshot] Invalid "
+          "Query::Spacetime::Mode used. Please report this as a bug.");
+    }
+
+    case Query::Spacetime::Mode::All:
+    {
+      for(const auto& map : data.maps)
+        inspect_snapshot_map(*map.second, nullptr, nullptr, add);
+
+      break;
+    }
+
+    case Query::Spacetime::Mode::Regions:
+    {
+      assert(spacetime.regions() != nullptr);
+      internal::VisitedSet checked(data.capacity);
+      for(const Region& region : *spacetime.regions())
+      {
+        const auto map_it = data.maps.find(region.get_map());
+        if(map_it == data.maps.end())
+          continue;
+
+        const std::size_t slot_offset = data.slot_offset(map_it->first);
+        rmf_traffic::internal::Spacetime spacetime_data;
+        spacetime_data.lower_time_bound = region.get_lower_time_bound();
+        spacetime_data.upper_time_bound = region.get_upper_time_bound();
+        rmf_traffic::internal::BoundingBox space_bounds;
+        spacetime_data.bounds = &space_bounds;
+        for(auto space_it=region.begin(); space_it != region.end(); ++space_it)
+        {
+          spacetime_data.pose = space_it->get_pose();
+          spacetime_data.shape = space_it->get_shape();
+          space_bounds = rmf_traffic::internal::get_bounding_box(
+                spacetime_data.pose, *spacetime_data.shape);
+
+          inspect_snapshot_map(
+                *map_it->second,
+                spacetime_data.lower_time_bound,
+                spacetime_data.upper_time_bound,
+                [&](const internal::ConstEntryPtr& entry)
+          {
+            if(!checked.insert(slot_offset + entry->slot))
+              return;
+
+            if(rmf_traffic::internal::detect_conflicts(
+                 entry->trajectory, spacetime_data, nullptr,
+                 entry->get_bounds()))
+              add(entry);
+          });
+        }
+      }
+
+      break;
+    }
+
+    case Query::Spacetime::Mode::Timespan:
+    {
+      assert(spacetime.timespan() != nullptr);
+      const Query::Spacetime::Timespan& timespan = *spacetime.timespan();
+      for(const std::string& map : timespan.get_maps())
+      {
+        const auto map_it = data.maps.find(map);
+        if(map_it == data.maps.end())
+          continue;
+
+        inspect_snapshot_map(
+              *map_it->second,
+              timespan.get_lower_time_bound(),
+              timespan.get_upper_time_bound(),
+              add);
+      }
+
+      break;
+    }
+  }
+
+  return Viewer::View::Implementation::make_view(
+        std::move(elements), _pimpl->data);
+}
+
+//==============================================================================
+Version Database::Snapshot::latest_version() const
+{
+  return _pimpl->data->latest_version;
+}
+
+//==============================================================================
+Database::Snapshot::Snapshot()
+{
+  // Do nothing
+}
+
+//==============================================================================
+Database::Database()
+{
+  _pimpl->record_changes = true;
+}
+
 //==============================================================================
 auto Database::changes(const Query& parameters) const -> Patch
 {
-  auto relevant_changes = _pimpl->inspect<internal::ChangeRelevanceInspector>(
-        parameters).relevant_changes;
+  std::vector<Change> relevant_changes;
+
+  const Query::Versions& versions = parameters.versions();
+  if(versions.get_mode() == Query::Versions::Mode::After)
+  {
+    // A remote mirror that is catching up only needs to hear about the
+    // entries that came after its last known version, so we can scan the
+    // change log instead of inspecting the whole schedule.
+    assert(versions.after() != nullptr);
+    const Version after = versions.after()->get_version();
+
+    internal::ChangeRelevanceInspector inspector;
+    inspector.after(&after);
+    inspector.inspect_log(_pimpl->change_log, parameters.spacetime());
+    relevant_changes = std::move(inspector.relevant_changes);
+  }
+  else
+  {
+    relevant_changes = _pimpl->inspect<internal::ChangeRelevanceInspector>(
+          parameters).relevant_changes;
+  }
 
   if(_pimpl->cull_has_occurred)
   {
@@ -863,7 +1231,7 @@ Version Database::interrupt(
     Duration delay)
 {
   const internal::EntryPtr old_entry =
-      _pimpl->get_entry_iterator(id, "interruption")->second;
+      _pimpl->get_entry(id, "interruption");
 
   Trajectory new_trajectory = add_interruption(
         old_entry->trajectory, interruption_trajectory, delay);
@@ -877,7 +1245,7 @@ Version Database::interrupt(
         std::move(new_trajectory),
         new_version,
         old_entry,
-        std::make_unique<Change>(std::move(change))));
+        std::make_unique<Change>(std::move(change)))).get();
 
   return new_version;
 }
@@ -889,7 +1257,7 @@ Version Database::delay(
     const Duration delay)
 {
   const internal::EntryPtr old_entry =
-      _pimpl->get_entry_iterator(id, "delay")->second;
+      _pimpl->get_entry(id, "delay");
 
   Trajectory new_trajectory = add_delay(
         old_entry->trajectory, from, delay);
@@ -902,7 +1270,7 @@ Version Database::delay(
           std::move(new_trajectory),
           new_version,
           old_entry,
-          std::make_unique<Change>(std::move(change))));
+          std::make_unique<Change>(std::move(change)))).get();
 
   return new_version;
 }
@@ -913,7 +1281,7 @@ Version Database::replace(
     Trajectory trajectory)
 {
   const internal::EntryPtr old_entry =
-      _pimpl->get_entry_iterator(previous_id, "replacement")->second;
+      _pimpl->get_entry(previous_id, "replacement");
 
   const Version new_version = ++_pimpl->latest_version;
   internal::EntryPtr new_entry =
@@ -926,7 +1294,7 @@ Version Database::replace(
         Change::Implementation::make_replace_ref(
           previous_id, &new_entry->trajectory, new_version));
 
-  old_entry->succeeded_by = _pimpl->add_entry(new_entry);
+  old_entry->succeeded_by = _pimpl->add_entry(new_entry).get();
 
   return new_version;
 }
@@ -935,7 +1303,7 @@ Version Database::replace(
 Version Database::erase(Version id)
 {
   const internal::EntryPtr old_entry =
-      _pimpl->get_entry_iterator(id, "erasure")->second;
+      _pimpl->get_entry(id, "erasure");
 
   const Version new_version = ++_pimpl->latest_version;
 
@@ -944,19 +1312,264 @@ Version Database::erase(Version id)
           Trajectory{old_entry->trajectory.get_map_name()},
           new_version,
           old_entry,
-          std::make_unique<Change>(Change::make_erase(id, new_version))), true);
+          std::make_unique<Change>(Change::make_erase(id, new_version))), true).get();
 
   return new_version;
 }
 
+namespace internal {
+//==============================================================================
+const char* operation_name(const Database::Change::Mode mode)
+{
+  switch(mode)
+  {
+    case Database::Change::Mode::Interrupt: return "interruption";
+    case Database::Change::Mode::Delay: return "delay";
+    case Database::Change::Mode::Replace: return "replacement";
+    case Database::Change::Mode::Erase: return "erasure";
+    default: return "batch";
+  }
+}
+
+} // namespace internal
+
+//==============================================================================
+void Database::Batch::Implementation::prepare(
+    const Viewer::Implementation& database,
+    const Version* const first)
+{
+  bases.clear();
+  trajectories.clear();
+  bases.reserve(items.size());
+  trajectories.reserve(items.size());
+  for(std::size_t i=0; i < items.size(); ++i)
+  {
+    Item& item = items[i];
+    internal::EntryPtr base;
+    const Trajectory* base_trajectory = nullptr;
+    if(item.mode != Change::Mode::Insert)
+    {
+      if(first && item.id - *first < i)
+      {
+        base_trajectory = &trajectories[item.id - *first];
+      }
+      else
+      {
+        base = database.get_entry(
+            item.id, internal::operation_name(item.mode));
+        base_trajectory = &base->trajectory;
+      }
+    }
+
+    switch(item.mode)
+    {
+      case Change::Mode::Insert:
+      case Change::Mode::Replace:
+      {
+        trajectories.emplace_back(std::move(*item.trajectory));
+        break;
+      }
+
+      case Change::Mode::Interrupt:
+      {
+        trajectories.emplace_back(add_interruption(
+              *base_trajectory, *item.trajectory, item.delay));
+        break;
+      }
+
+      case Change::Mode::Delay:
+      {
+        trajectories.emplace_back(add_delay(
+              *base_trajectory, item.from, item.delay));
+        break;
+      }
+
+      case Change::Mode::Erase:
+      {
+        trajectories.emplace_back(base_trajectory->get_map_name());
+        break;
+      }
+
+      default:
+      {
+        throw std::runtime_error(
+            "[rmf_traffic::schedule::Database::apply] Invalid change mode "
+            "in batch. Please report this as a bug.");
+      }
+    }
+
+    bases.emplace_back(std::move(base));
+  }
+}
+
+//==============================================================================
+void Database::Batch::Implementation::commit(
+    Viewer::Implementation& database,
+    const std::vector<Version>& versions)
+{
+  assert(versions.size() == items.size());
+  assert(trajectories.size() == items.size());
+  if(items.empty())
+    return;
+
+  database.compact_if_due(items.size());
+
+  const Version first = versions.front();
+  std::vector<internal::EntryPtr> entries;
+  entries.reserve(items.size());
+  for(std::size_t i=0; i < items.size(); ++i)
+  {
+    Item& item = items[i];
+    const Version version = versions[i];
+    database.latest_version = version;
+
+    internal::EntryPtr old_entry = std::move(bases[i]);
+    if(!old_entry && item.mode != Change::Mode::Insert)
+      old_entry = entries[item.id - first];
+
+    internal::EntryPtr entry = std::make_shared<internal::Entry>(
+          std::move(trajectories[i]), version, old_entry);
+
+    switch(item.mode)
+    {
+      case Change::Mode::Insert:
+      {
+        entry->change = std::make_unique<Change>(
+              Change::Implementation::make_insert_ref(
+                &entry->trajectory, version));
+        break;
+      }
+
+      case Change::Mode::Interrupt:
+      {
+        entry->change = std::make_unique<Change>(Change::make_interrupt(
+              item.id, std::move(*item.trajectory), item.delay, version));
+        break;
+      }
+
+      case Change::Mode::Delay:
+      {
+        entry->change = std::make_unique<Change>(Change::make_delay(
+              item.id, item.from, item.delay, version));
+        break;
+      }
+
+      case Change::Mode::Replace:
+      {
+        entry->change = std::make_unique<Change>(
+              Change::Implementation::make_replace_ref(
+                item.id, &entry->trajectory, version));
+        break;
+      }
+
+      default:
+      {
+        entry->change = std::make_unique<Change>(
+              Change::make_erase(item.id, version));
+        break;
+      }
+    }
+
+    if(old_entry)
+      old_entry->succeeded_by = entry.get();
+
+    database.store_entry(entry);
+    entries.emplace_back(std::move(entry));
+  }
+
+  database.place_entries(entries);
+
+  bases.clear();
+  trajectories.clear();
+}
+
+//==============================================================================
+Version Database::apply(Batch batch)
+{
+  Batch::Implementation& changes = Batch::Implementation::get(batch);
+  if(changes.items.empty())
+    return _pimpl->latest_version;
+
+  // Every new trajectory gets worked out before anything in the database is
+  // touched, so that a bad change leaves the database the way it was. A change
+  // can refer to a version that an earlier change in the batch will produce.
+  const Version first = _pimpl->latest_version + 1;
+  changes.prepare(*_pimpl, &first);
+
+  // Now the versions get handed out in one block
+  std::vector<Version> versions;
+  versions.reserve(changes.items.size());
+  for(std::size_t i=0; i < changes.items.size(); ++i)
+    versions.push_back(first + i);
+
+  changes.commit(*_pimpl, versions);
+
+  return _pimpl->latest_version;
+}
+
+//==============================================================================
+auto Database::snapshot() const -> Snapshot
+{
+  if(!_pimpl->snapshot)
+  {
+    auto data = std::make_shared<internal::SnapshotData>();
+    data->latest_version = _pimpl->latest_version;
+    data->capacity = _pimpl->slots.capacity();
+    for(const auto& timeline : _pimpl->timelines)
+    {
+      data->maps.insert(
+            std::make_pair(timeline.first, _pimpl->get_map_snapshot(timeline)));
+    }
+
+    _pimpl->snapshot = std::move(data);
+  }
+
+  return Snapshot::Implementation::make(_pimpl->snapshot);
+}
+
+//==============================================================================
+auto Database::snapshot(const std::unordered_set<std::string>& maps) const
+-> Snapshot
+{
+  auto data = std::make_shared<internal::SnapshotData>();
+  data->latest_version = _pimpl->latest_version;
+  data->capacity = _pimpl->slots.capacity();
+  for(const std::string& map : maps)
+  {
+    const auto timeline = _pimpl->timelines.find(map);
+    if(timeline == _pimpl->timelines.end())
+      continue;
+
+    data->maps.insert(
+          std::make_pair(map, _pimpl->get_map_snapshot(*timeline)));
+  }
+
+  return Snapshot::Implementation::make(std::move(data));
+}
+
 //==============================================================================
 Version Database::cull(Time time)
 {
-  _pimpl->cull(++_pimpl->latest_version, time);
+  // A cull that removes nothing does not need a new version, so remote mirrors
+  // will not be woken up for it.
+  if(_pimpl->cull(_pimpl->latest_version + 1, time))
+    ++_pimpl->latest_version;
 
   return _pimpl->latest_version;
 }
 
+//==============================================================================
+void Database::set_oldest_needed_version(const Version version)
+{
+  _pimpl->oldest_needed_version = version;
+}
+
+//==============================================================================
+void Database::set_compaction_interval(const std::size_t versions)
+{
+  _pimpl->compaction_interval = versions;
+}
+
 } // namespace schedule
 
 namespace detail {
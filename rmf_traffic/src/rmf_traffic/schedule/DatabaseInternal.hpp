@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef SRC__RMF_TRAFFIC__SCHEDULE__DATABASEINTERNAL_HPP
+#define SRC__RMF_TRAFFIC__SCHEDULE__DATABASEINTERNAL_HPP
+
+#include "ViewerInternal.hpp"
+
+#include <rmf_traffic/schedule/Database.hpp>
+
+#include <rmf_utils/optional.hpp>
+
+#include <vector>
+
+namespace rmf_traffic {
+namespace schedule {
+
+namespace internal {
+//==============================================================================
+/// The name of the operation for a change mode, for use in error messages
+const char* operation_name(Database::Change::Mode mode);
+
+} // namespace internal
+
+//==============================================================================
+class Database::Batch::Implementation
+{
+public:
+
+  struct Item
+  {
+    Change::Mode mode;
+
+    // The version that this change refers to. Insertions do not use this.
+    Version id;
+
+    // The new trajectory of an insertion or replacement, or the interruption
+    // trajectory of an interruption
+    rmf_utils::optional<Trajectory> trajectory;
+
+    Time from;
+    Duration delay;
+  };
+
+  std::vector<Item> items;
+
+  // The entry that each change grows out of and the trajectory that it will
+  // produce. These get filled in by prepare().
+  std::vector<internal::EntryPtr> bases;
+  std::vector<Trajectory> trajectories;
+
+  void add(
+      const Change::Mode mode,
+      const Version id,
+      rmf_utils::optional<Trajectory> trajectory = rmf_utils::nullopt,
+      const Time from = Time(),
+      const Duration delay = Duration(0))
+  {
+    items.emplace_back(Item{mode, id, std::move(trajectory), from, delay});
+  }
+
+  /// Work out the new trajectory of every change without touching the
+  /// database, so that a bad change can be reported before anything has been
+  /// modified. If first is not a nullptr, a change may refer to the version
+  /// that an earlier change of this batch will get when the versions are
+  /// counted up from *first.
+  void prepare(
+      const Viewer::Implementation& database,
+      const Version* first);
+
+  /// Put the prepared changes into the database. Each change gets the version
+  /// in the same position of versions, which must be increasing. They must
+  /// also be consecutive if any change refers to an earlier change of this
+  /// batch.
+  void commit(
+      Viewer::Implementation& database,
+      const std::vector<Version>& versions);
+
+  static Implementation& get(Batch& batch)
+  {
+    return *batch._pimpl;
+  }
+};
+
+//==============================================================================
+class Database::Snapshot::Implementation
+{
+public:
+
+  std::shared_ptr<const internal::SnapshotData> data;
+
+  static Snapshot make(std::shared_ptr<const internal::SnapshotData> data)
+  {
+    Snapshot snapshot;
+    snapshot._pimpl = rmf_utils::make_impl<Implementation>(
+          Implementation{std::move(data)});
+    return snapshot;
+  }
+};
+
+} // namespace schedule
+} // namespace rmf_traffic
+
+#endif // SRC__RMF_TRAFFIC__SCHEDULE__DATABASEINTERNAL_HPP
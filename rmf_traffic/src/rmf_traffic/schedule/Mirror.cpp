@@ -49,8 +49,8 @@ Mirror::Mirror()
 //              << "]" << std::endl;
 
     const internal::EntryPtr& entry =
-        _pimpl->get_entry_iterator(
-          interruption.original_id(), "interruption")->second;
+        _pimpl->get_entry(
+          interruption.original_id(), "interruption");
 
     Trajectory new_trajectory = add_interruption(
           entry->trajectory,
@@ -69,14 +69,10 @@ Mirror::Mirror()
 //              << "] --> [" << change.id() << "]" << std::endl;
 
     const internal::EntryPtr& entry =
-        _pimpl->get_entry_iterator(delay.original_id(), "delay")->second;
+        _pimpl->get_entry(delay.original_id(), "delay");
 
-    Trajectory new_trajectory = add_delay(
-          entry->trajectory,
-          delay.from(),
-          delay.duration());
-
-    _pimpl->modify_entry(entry, std::move(new_trajectory), change.id());
+    _pimpl->delay_entry(
+          entry, delay.from(), delay.duration(), change.id());
   };
 
   _pimpl->changers[static_cast<std::size_t>(Database::Change::Mode::Replace)]
@@ -90,8 +86,8 @@ Mirror::Mirror()
     try
     {
       const internal::EntryPtr& entry =
-          _pimpl->get_entry_iterator(
-            replace.original_id(), "replacement")->second;
+          _pimpl->get_entry(
+            replace.original_id(), "replacement");
 
       _pimpl->modify_entry(entry, *replace.trajectory(), change.id());
     }
@@ -0,0 +1,557 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include "DatabaseInternal.hpp"
+
+#include <rmf_traffic/schedule/ShardedDatabase.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <map>
+#include <mutex>
+
+namespace rmf_traffic {
+namespace schedule {
+
+//==============================================================================
+class ShardedDatabase::Implementation
+{
+public:
+
+  /// The database of one map. This derives from Database so that the
+  /// internals of the shard can be reached.
+  class Shard : public Database
+  {
+  public:
+
+    Shard(std::string map_)
+      : map(std::move(map_))
+    {
+      // Do nothing
+    }
+
+    const std::string map;
+
+    /// Guards everything in this shard
+    std::mutex mutex;
+
+    Viewer::Implementation& get() { return *_pimpl; }
+    const Viewer::Implementation& get() const { return *_pimpl; }
+  };
+
+  using ShardPtr = std::unique_ptr<Shard>;
+
+  /// Some shards that have been locked, and the latest version whose changes
+  /// are all included in them
+  struct Cut
+  {
+    std::vector<Shard*> shards;
+    std::vector<std::unique_lock<std::mutex>> locks;
+    Version latest_version;
+    rmf_utils::optional<std::pair<Version, Time>> last_cull;
+  };
+
+  // Guards the table of shards and the fields that follow it. Shards are never
+  // removed from the table. A thread that has locked a shard must not wait for
+  // this mutex, and shards must be locked in the order of their map names.
+  mutable std::mutex shards_mutex;
+  std::map<std::string, ShardPtr> shards;
+  double spatial_cell_size = 0.0;
+  bool cull_has_occurred = false;
+  std::pair<Version, Time> last_cull;
+
+  // Versions only get taken from this while the shards that will use them are
+  // locked.
+  std::atomic<Version> latest_version{0};
+
+  // Guards the shard that each version belongs to. Nothing else gets locked
+  // while this is locked.
+  mutable std::mutex routes_mutex;
+  std::unordered_map<Version, Shard*> routes;
+
+  // Guards the history settings, which each shard picks up before it gets
+  // changed. Nothing else gets locked while this is locked.
+  mutable std::mutex settings_mutex;
+  rmf_utils::optional<Version> oldest_needed_version;
+  std::size_t compaction_interval = 100;
+
+  /// Get the shard of a map, creating it if needed. shards_mutex must be
+  /// locked.
+  Shard& shard(const std::string& map)
+  {
+    ShardPtr& shard = shards[map];
+    if(!shard)
+    {
+      shard = std::make_unique<Shard>(map);
+      shard->set_spatial_cell_size(spatial_cell_size);
+    }
+
+    return *shard;
+  }
+
+  /// Lock the shards of some maps, or every shard if maps is a nullptr.
+  /// shards_mutex stays locked until all of the shards are, so a shard cannot
+  /// be created and changed in the meantime.
+  Cut lock(const std::unordered_set<std::string>* maps) const
+  {
+    std::lock_guard<std::mutex> lock(shards_mutex);
+    return lock_shards(maps);
+  }
+
+  /// The same as lock(), except shards_mutex must already be locked
+  Cut lock_shards(const std::unordered_set<std::string>* maps) const
+  {
+    Cut cut;
+    for(const auto& entry : shards)
+    {
+      if(!maps || maps->count(entry.first) > 0)
+        cut.shards.push_back(entry.second.get());
+    }
+
+    cut.locks.reserve(cut.shards.size());
+    for(Shard* const shard : cut.shards)
+      cut.locks.emplace_back(shard->mutex);
+
+    cut.latest_version = latest_version.load();
+    if(cull_has_occurred)
+      cut.last_cull = last_cull;
+
+    return cut;
+  }
+
+  Snapshot snapshot(const std::unordered_set<std::string>* maps) const
+  {
+    const Cut cut = lock(maps);
+
+    auto data = std::make_shared<internal::SnapshotData>();
+    data->latest_version = cut.latest_version;
+    data->capacity = 0;
+    for(const Shard* const shard : cut.shards)
+    {
+      const Viewer::Implementation& impl = shard->get();
+      for(const auto& timeline : impl.timelines)
+      {
+        data->maps.insert(
+              std::make_pair(timeline.first, impl.get_map_snapshot(timeline)));
+        data->slot_offsets.insert(
+              std::make_pair(timeline.first, data->capacity));
+      }
+
+      data->capacity += impl.slots.capacity();
+    }
+
+    return Snapshot::Implementation::make(std::move(data));
+  }
+
+  /// Get the maps that a query refers to, or a nullopt if it refers to all of
+  /// them.
+  static rmf_utils::optional<std::unordered_set<std::string>> get_maps(
+      const Query::Spacetime& spacetime)
+  {
+    switch(spacetime.get_mode())
+    {
+      case Query::Spacetime::Mode::Regions:
+      {
+        std::unordered_set<std::string> maps;
+        for(const Region& region : *spacetime.regions())
+          maps.insert(region.get_map());
+
+        return maps;
+      }
+
+      case Query::Spacetime::Mode::Timespan:
+        return spacetime.timespan()->get_maps();
+
+      default:
+        return rmf_utils::nullopt;
+    }
+  }
+};
+
+//==============================================================================
+ShardedDatabase::ShardedDatabase()
+  : _pimpl(rmf_utils::make_unique_impl<Implementation>())
+{
+  // Do nothing
+}
+
+//==============================================================================
+auto ShardedDatabase::changes(const Query& parameters) const -> Patch
+{
+  const auto maps = Implementation::get_maps(parameters.spacetime());
+  const Implementation::Cut cut = _pimpl->lock(maps? &*maps : nullptr);
+
+  // Each shard reports its own culls, so those get replaced by one cull for
+  // the whole database
+  std::vector<Change> relevant_changes;
+  for(const Implementation::Shard* const shard : cut.shards)
+  {
+    const Patch patch = shard->changes(parameters);
+    for(const Change& change : patch)
+    {
+      if(change.get_mode() != Change::Mode::Cull)
+        relevant_changes.push_back(change);
+    }
+  }
+
+  // Versions are compared by how far they are behind the latest version so
+  // that this keeps working after the version numbers overflow.
+  const Version latest = cut.latest_version;
+  std::stable_sort(relevant_changes.begin(), relevant_changes.end(),
+                   [&](const Change& a, const Change& b) -> bool
+  {
+    return latest - a.id() > latest - b.id();
+  });
+
+  if(cut.last_cull)
+  {
+    const auto* after = parameters.versions().after();
+    if(!after || latest - after->get_version() > latest - cut.last_cull->first)
+    {
+      relevant_changes.push_back(
+            Change::make_cull(cut.last_cull->second, cut.last_cull->first));
+    }
+  }
+
+  return Patch(std::move(relevant_changes), latest);
+}
+
+//==============================================================================
+Version ShardedDatabase::insert(Trajectory trajectory)
+{
+  Batch batch;
+  batch.insert(std::move(trajectory));
+  return apply(std::move(batch));
+}
+
+//==============================================================================
+Version ShardedDatabase::interrupt(
+    const Version id,
+    Trajectory interruption_trajectory,
+    const Duration delay)
+{
+  Batch batch;
+  batch.interrupt(id, std::move(interruption_trajectory), delay);
+  return apply(std::move(batch));
+}
+
+//==============================================================================
+Version ShardedDatabase::delay(
+    const Version id,
+    const Time from,
+    const Duration delay)
+{
+  Batch batch;
+  batch.delay(id, from, delay);
+  return apply(std::move(batch));
+}
+
+//==============================================================================
+Version ShardedDatabase::replace(
+    const Version previous_id,
+    Trajectory trajectory)
+{
+  Batch batch;
+  batch.replace(previous_id, std::move(trajectory));
+  return apply(std::move(batch));
+}
+
+//==============================================================================
+Version ShardedDatabase::erase(const Version id)
+{
+  Batch batch;
+  batch.erase(id);
+  return apply(std::move(batch));
+}
+
+//==============================================================================
+Version ShardedDatabase::apply(Batch batch)
+{
+  using Item = Batch::Implementation::Item;
+  using Shard = Implementation::Shard;
+  std::vector<Item>& items = Batch::Implementation::get(batch).items;
+  if(items.empty())
+    return latest_version();
+
+  // Find the shard that each change will go into, and the shard of the
+  // version that it refers to. These are only different for a replacement
+  // that moves a trajectory onto another map.
+  std::vector<Shard*> targets(items.size(), nullptr);
+  std::vector<Shard*> sources(items.size(), nullptr);
+  {
+    std::lock_guard<std::mutex> lock(_pimpl->shards_mutex);
+    for(std::size_t i=0; i < items.size(); ++i)
+    {
+      const Item& item = items[i];
+      if(item.mode == Change::Mode::Insert || item.mode == Change::Mode::Replace)
+        targets[i] = &_pimpl->shard(item.trajectory->get_map_name());
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(_pimpl->routes_mutex);
+    for(std::size_t i=0; i < items.size(); ++i)
+    {
+      const Item& item = items[i];
+      if(item.mode == Change::Mode::Insert)
+        continue;
+
+      const auto it = _pimpl->routes.find(item.id);
+      if(it == _pimpl->routes.end())
+      {
+        throw std::runtime_error(
+            std::string("[rmf_traffic::schedule::ShardedDatabase::apply] ")
+            + "Requested " + internal::operation_name(item.mode)
+            + " for ID that does not exist in this Database: "
+            + std::to_string(item.id));
+      }
+
+      sources[i] = it->second;
+      if(!targets[i])
+        targets[i] = it->second;
+    }
+  }
+
+  // Split the batch up by shard
+  std::vector<Shard*> involved;
+  for(std::size_t i=0; i < items.size(); ++i)
+  {
+    involved.push_back(targets[i]);
+    if(sources[i])
+      involved.push_back(sources[i]);
+  }
+
+  std::sort(involved.begin(), involved.end(),
+            [](const Shard* a, const Shard* b) -> bool
+  {
+    return a->map < b->map;
+  });
+  involved.erase(
+        std::unique(involved.begin(), involved.end()), involved.end());
+
+  struct Part
+  {
+    Batch::Implementation changes;
+
+    // The position of each change in the original batch
+    std::vector<std::size_t> positions;
+  };
+
+  std::vector<Part> parts(involved.size());
+  const auto part = [&](const Shard* shard) -> Part&
+  {
+    const auto it = std::find(involved.begin(), involved.end(), shard);
+    return parts[static_cast<std::size_t>(it - involved.begin())];
+  };
+
+  for(std::size_t i=0; i < items.size(); ++i)
+  {
+    Item& item = items[i];
+    if(sources[i] && sources[i] != targets[i])
+    {
+      Part& leaving = part(sources[i]);
+      leaving.changes.add(Change::Mode::Erase, item.id);
+      leaving.positions.push_back(i);
+
+      Part& arriving = part(targets[i]);
+      arriving.changes.add(Change::Mode::Insert, 0, std::move(item.trajectory));
+      arriving.positions.push_back(i);
+      continue;
+    }
+
+    Part& target = part(targets[i]);
+    target.changes.add(
+          item.mode, item.id, std::move(item.trajectory), item.from, item.delay);
+    target.positions.push_back(i);
+  }
+
+  std::vector<std::unique_lock<std::mutex>> locks;
+  locks.reserve(involved.size());
+  for(Shard* const shard : involved)
+    locks.emplace_back(shard->mutex);
+
+  // Every change gets checked before any versions are taken, so a bad change
+  // leaves every shard the way it was.
+  for(std::size_t k=0; k < parts.size(); ++k)
+    parts[k].changes.prepare(involved[k]->get(), nullptr);
+
+  rmf_utils::optional<Version> oldest_needed_version;
+  std::size_t compaction_interval;
+  {
+    std::lock_guard<std::mutex> lock(_pimpl->settings_mutex);
+    oldest_needed_version = _pimpl->oldest_needed_version;
+    compaction_interval = _pimpl->compaction_interval;
+  }
+
+  const Version first = _pimpl->latest_version.fetch_add(items.size()) + 1;
+  for(std::size_t k=0; k < parts.size(); ++k)
+  {
+    Viewer::Implementation& shard = involved[k]->get();
+    shard.oldest_needed_version = oldest_needed_version;
+    shard.compaction_interval = compaction_interval;
+
+    std::vector<Version> versions;
+    versions.reserve(parts[k].positions.size());
+    for(const std::size_t i : parts[k].positions)
+      versions.push_back(first + i);
+
+    parts[k].changes.commit(shard, versions);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(_pimpl->routes_mutex);
+    for(std::size_t i=0; i < items.size(); ++i)
+      _pimpl->routes[first + i] = targets[i];
+  }
+
+  return first + (items.size() - 1);
+}
+
+//==============================================================================
+auto ShardedDatabase::snapshot() const -> Snapshot
+{
+  return _pimpl->snapshot(nullptr);
+}
+
+//==============================================================================
+auto ShardedDatabase::snapshot(
+    const std::unordered_set<std::string>& maps) const -> Snapshot
+{
+  return _pimpl->snapshot(&maps);
+}
+
+//==============================================================================
+Viewer::View ShardedDatabase::query(const Query& parameters) const
+{
+  const auto maps = Implementation::get_maps(parameters.spacetime());
+  return _pimpl->snapshot(maps? &*maps : nullptr).query(parameters);
+}
+
+//==============================================================================
+Version ShardedDatabase::oldest_version() const
+{
+  std::lock_guard<std::mutex> lock(_pimpl->shards_mutex);
+  const Version latest = _pimpl->latest_version.load();
+  Version oldest = latest;
+  for(const auto& entry : _pimpl->shards)
+  {
+    Implementation::Shard& shard = *entry.second;
+    std::lock_guard<std::mutex> shard_lock(shard.mutex);
+    const Viewer::Implementation& impl = shard.get();
+    if(impl.all_entries.empty())
+      continue;
+
+    if(latest - impl.oldest_version > latest - oldest)
+      oldest = impl.oldest_version;
+  }
+
+  return oldest;
+}
+
+//==============================================================================
+Version ShardedDatabase::latest_version() const
+{
+  return _pimpl->latest_version.load();
+}
+
+//==============================================================================
+void ShardedDatabase::set_spatial_cell_size(const double cell_size)
+{
+  if(!(cell_size >= 0.0) || !std::isfinite(cell_size))
+  {
+    throw std::invalid_argument(
+          "[rmf_traffic::schedule::ShardedDatabase::set_spatial_cell_size] "
+          "Invalid cell size [" + std::to_string(cell_size) + "]");
+  }
+
+  std::lock_guard<std::mutex> lock(_pimpl->shards_mutex);
+  _pimpl->spatial_cell_size = cell_size;
+  for(const auto& entry : _pimpl->shards)
+  {
+    Implementation::Shard& shard = *entry.second;
+    std::lock_guard<std::mutex> shard_lock(shard.mutex);
+    shard.set_spatial_cell_size(cell_size);
+  }
+}
+
+//==============================================================================
+double ShardedDatabase::get_spatial_cell_size() const
+{
+  std::lock_guard<std::mutex> lock(_pimpl->shards_mutex);
+  return _pimpl->spatial_cell_size;
+}
+
+//==============================================================================
+Version ShardedDatabase::cull(const Time time)
+{
+  std::lock_guard<std::mutex> lock(_pimpl->shards_mutex);
+  const Implementation::Cut cut = _pimpl->lock_shards(nullptr);
+
+  // Every shard is locked, so no versions are being handed out right now
+  const Version version = cut.latest_version + 1;
+  bool culled = false;
+  for(Implementation::Shard* const shard : cut.shards)
+  {
+    if(shard->get().cull(version, time))
+    {
+      shard->get().latest_version = version;
+      culled = true;
+    }
+  }
+
+  // The routes of versions that have been culled or compacted away are not
+  // needed anymore
+  {
+    std::lock_guard<std::mutex> routes_lock(_pimpl->routes_mutex);
+    auto& routes = _pimpl->routes;
+    for(auto it = routes.begin(); it != routes.end();)
+    {
+      if(it->second->get().all_entries.find(it->first))
+        ++it;
+      else
+        it = routes.erase(it);
+    }
+  }
+
+  // A cull that removes nothing does not need a new version, so remote mirrors
+  // will not be woken up for it.
+  if(!culled)
+    return cut.latest_version;
+
+  _pimpl->latest_version.store(version);
+  _pimpl->cull_has_occurred = true;
+  _pimpl->last_cull = std::make_pair(version, time);
+  return version;
+}
+
+//==============================================================================
+void ShardedDatabase::set_oldest_needed_version(const Version version)
+{
+  std::lock_guard<std::mutex> lock(_pimpl->settings_mutex);
+  _pimpl->oldest_needed_version = version;
+}
+
+//==============================================================================
+void ShardedDatabase::set_compaction_interval(const std::size_t versions)
+{
+  std::lock_guard<std::mutex> lock(_pimpl->settings_mutex);
+  _pimpl->compaction_interval = versions;
+}
+
+} // namespace schedule
+} // namespace rmf_traffic
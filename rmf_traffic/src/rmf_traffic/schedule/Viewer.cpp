@@ -24,6 +24,11 @@
 #include <rmf_traffic/schedule/Database.hpp>
 #include "debug_Viewer.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
 namespace rmf_traffic {
 namespace schedule {
 
@@ -37,6 +42,11 @@ const Duration BucketDuration = std::chrono::minutes(1);
 // potentially not be very useful.
 const Duration PartialBucketDuration = std::chrono::seconds(50);
 
+// An entry whose bounding box would cover more than this many spatial grid
+// cells will be put in the unbounded bucket of the grid instead. This keeps
+// long trajectories from bloating the grid.
+const std::size_t MaxCellsPerEntry = 256;
+
 } // anonymous namespace
 
 namespace internal {
@@ -51,7 +61,568 @@ Entry::Entry(Trajectory _trajectory,
     succeeds(std::move(_succeeds)),
     change(std::move(_change))
 {
-  // Do nothing
+  update_bounds();
+}
+
+//==============================================================================
+Entry::~Entry()
+{
+  // Each version owns the version that it succeeds, so simply letting the
+  // pointers go would destroy the lineage recursively, one stack frame per
+  // version. Instead we take over each link that nobody else is holding onto,
+  // which leaves its entry with nothing to release when it gets destroyed.
+  ConstEntryPtr previous = std::move(succeeds);
+  while(previous && previous.use_count() == 1)
+    previous = std::move(const_cast<Entry&>(*previous).succeeds);
+}
+
+//==============================================================================
+void Entry::update_bounds()
+{
+  if(trajectory.size() < 2)
+    bounds = rmf_utils::nullopt;
+  else
+    bounds = rmf_traffic::internal::get_bounding_box(trajectory);
+}
+
+//==============================================================================
+SpatialGrid::SpatialGrid(const double cell_size)
+  : _cell_size(cell_size)
+{
+  assert(cell_size > 0.0);
+}
+
+//==============================================================================
+void SpatialGrid::insert(const ConstEntryPtr& entry)
+{
+  const auto* const bounds = entry->get_bounds();
+  const CellRange range = bounds?
+        get_range(*bounds) : CellRange{0, 0, -1, -1};
+  const bool unbounded = !bounds || range.count() > MaxCellsPerEntry;
+
+  rmf_utils::optional<CellRange> placement;
+  if(!unbounded)
+    placement = range;
+
+  if(!_placements.insert(std::make_pair(entry.get(), placement)).second)
+  {
+    // This entry is already in the grid
+    return;
+  }
+
+  if(unbounded)
+  {
+    _unbounded.push_back(entry);
+    return;
+  }
+
+  for(int64_t x = range.min_x; x <= range.max_x; ++x)
+  {
+    for(int64_t y = range.min_y; y <= range.max_y; ++y)
+      _cells[key(x, y)].push_back(entry);
+  }
+}
+
+//==============================================================================
+void SpatialGrid::erase(const ConstEntryPtr& entry)
+{
+  const auto placement_it = _placements.find(entry.get());
+  if(placement_it == _placements.end())
+    return;
+
+  const auto remove_from = [&](Bucket& bucket)
+  {
+    bucket.erase(std::remove(bucket.begin(), bucket.end(), entry),
+                 bucket.end());
+  };
+
+  const rmf_utils::optional<CellRange>& placement = placement_it->second;
+  if(!placement)
+  {
+    remove_from(_unbounded);
+  }
+  else
+  {
+    for(int64_t x = placement->min_x; x <= placement->max_x; ++x)
+    {
+      for(int64_t y = placement->min_y; y <= placement->max_y; ++y)
+      {
+        const auto cell_it = _cells.find(key(x, y));
+        if(cell_it == _cells.end())
+          continue;
+
+        remove_from(cell_it->second);
+        if(cell_it->second.empty())
+          _cells.erase(cell_it);
+      }
+    }
+  }
+
+  _placements.erase(placement_it);
+}
+
+//==============================================================================
+bool SpatialGrid::CellRange::contains(const uint64_t cell_key) const
+{
+  const int64_t x = static_cast<int32_t>(cell_key >> 32);
+  const int64_t y = static_cast<int32_t>(cell_key & 0xFFFFFFFF);
+  return min_x <= x && x <= max_x && min_y <= y && y <= max_y;
+}
+
+//==============================================================================
+uint64_t SpatialGrid::key(const int64_t x, const int64_t y)
+{
+  return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32)
+      | static_cast<uint64_t>(static_cast<uint32_t>(y));
+}
+
+//==============================================================================
+auto SpatialGrid::get_range(
+    const rmf_traffic::internal::BoundingBox& bounds) const -> CellRange
+{
+  // Cell coordinates are clamped to 32 bits so that they fit in a key. Cells
+  // at the limits will collect everything beyond them, which is still correct.
+  const auto cell = [&](const double value) -> int64_t
+  {
+    const double limit = static_cast<double>(
+          std::numeric_limits<int32_t>::max());
+    return static_cast<int64_t>(
+          std::max(-limit, std::min(limit, std::floor(value/_cell_size))));
+  };
+
+  return CellRange{
+    cell(bounds.min.x()), cell(bounds.min.y()),
+    cell(bounds.max.x()), cell(bounds.max.y())
+  };
+}
+
+//==============================================================================
+std::pair<std::size_t, std::size_t> Timeline::get_range(
+    const Time start, const Time finish)
+{
+  assert(start <= finish);
+  if(_buckets.empty())
+  {
+    // This timeline is completely empty, so we'll begin creating buckets
+    // starting from the time of this trajectory.
+    _origin = start + PartialBucketDuration;
+    _buckets.emplace_back();
+    _first = 0;
+  }
+
+  const int64_t first = bucket_offset(start);
+  if(first < 0)
+  {
+    _buckets.insert(_buckets.begin(), static_cast<std::size_t>(-first),
+                    Bucket());
+    _origin += first*BucketDuration;
+    _first += first;
+  }
+
+  const int64_t last = bucket_offset(finish);
+  if(last >= static_cast<int64_t>(_buckets.size()))
+    _buckets.resize(static_cast<std::size_t>(last) + 1);
+
+  return std::make_pair(static_cast<std::size_t>(bucket_offset(start)),
+                        static_cast<std::size_t>(last));
+}
+
+//==============================================================================
+void Timeline::insert(const ConstEntryPtr& entry)
+{
+  const Trajectory& trajectory = entry->trajectory;
+  assert(trajectory.start_time());
+
+  const auto range = get_range(
+        *trajectory.start_time(), *trajectory.finish_time());
+
+  entry->first_bucket = _first + static_cast<int64_t>(range.first);
+  entry->bucket_slots.clear();
+  for(std::size_t i = range.first; i <= range.second; ++i)
+  {
+    Bucket& bucket = _buckets[i];
+    entry->bucket_slots.emplace_back(bucket.size());
+    bucket.push_back(entry);
+  }
+}
+
+//==============================================================================
+void Timeline::erase(const ConstEntryPtr& entry)
+{
+  for(std::size_t k = 0; k < entry->bucket_slots.size(); ++k)
+  {
+    remove(entry->first_bucket + static_cast<int64_t>(k),
+           entry->bucket_slots[k]);
+  }
+
+  entry->bucket_slots.clear();
+}
+
+//==============================================================================
+void Timeline::replace(
+    const ConstEntryPtr& old_entry,
+    const ConstEntryPtr& new_entry)
+{
+  const Trajectory& trajectory = new_entry->trajectory;
+  assert(trajectory.start_time());
+
+  const auto range = get_range(
+        *trajectory.start_time(), *trajectory.finish_time());
+  const int64_t new_first = _first + static_cast<int64_t>(range.first);
+  const int64_t new_last = _first + static_cast<int64_t>(range.second);
+
+  const int64_t old_first = old_entry->first_bucket;
+  const int64_t old_last =
+      old_first + static_cast<int64_t>(old_entry->bucket_slots.size()) - 1;
+
+  // The old positions are still needed until the end, because old_entry and
+  // new_entry might be the same object.
+  rmf_traffic::internal::SmallVector<std::size_t, 4> slots;
+  for(int64_t number = new_first; number <= new_last; ++number)
+  {
+    Bucket& b = bucket(number);
+    if(old_first <= number && number <= old_last)
+    {
+      const std::size_t slot = old_entry->bucket_slots[
+          static_cast<std::size_t>(number - old_first)];
+      assert(b[slot] == old_entry);
+      b[slot] = new_entry;
+      slots.emplace_back(slot);
+    }
+    else
+    {
+      slots.emplace_back(b.size());
+      b.push_back(new_entry);
+    }
+  }
+
+  for(int64_t number = old_first; number <= old_last; ++number)
+  {
+    if(number < new_first || new_last < number)
+    {
+      remove(number, old_entry->bucket_slots[
+               static_cast<std::size_t>(number - old_first)]);
+    }
+  }
+
+  if(old_entry != new_entry)
+    old_entry->bucket_slots.clear();
+
+  new_entry->first_bucket = new_first;
+  new_entry->bucket_slots = std::move(slots);
+}
+
+//==============================================================================
+void Timeline::cull(const Time time, std::unordered_set<Version>& culled)
+{
+  const std::size_t last = lower_bound(time);
+  const std::size_t end = last == _buckets.size()? last : last + 1;
+
+  for(std::size_t i = 0; i < end; ++i)
+  {
+    // We partition instead of using std::remove_if, because remove_if would
+    // leave moved-from elements at the end of the bucket, and we still need
+    // to know which entries were removed.
+    Bucket& bucket = _buckets[i];
+    const Bucket::iterator removed =
+        std::partition(bucket.begin(), bucket.end(),
+                   [&](const ConstEntryPtr& entry) -> bool
+    {
+      return !(*entry->trajectory.finish_time() < time);
+    });
+
+    for(Bucket::iterator bit = removed; bit != bucket.end(); ++bit)
+      culled.insert((*bit)->version);
+
+    bucket.erase(removed, bucket.end());
+
+    // The remaining entries may have been moved around
+    const int64_t number = _first + static_cast<int64_t>(i);
+    for(std::size_t slot = 0; slot < bucket.size(); ++slot)
+    {
+      const ConstEntryPtr& entry = bucket[slot];
+      entry->bucket_slots[
+          static_cast<std::size_t>(number - entry->first_bucket)] = slot;
+    }
+  }
+
+  // Drop the empty buckets from the front of the timeline
+  std::size_t stop_erasing = 0;
+  while(stop_erasing < end && _buckets[stop_erasing].empty())
+    ++stop_erasing;
+
+  pop_front(stop_erasing);
+}
+
+//==============================================================================
+std::size_t Timeline::lower_bound(const Time time) const
+{
+  if(_buckets.empty())
+    return 0;
+
+  const int64_t offset = bucket_offset(time);
+  if(offset < 0)
+    return 0;
+
+  return std::min(static_cast<std::size_t>(offset), _buckets.size());
+}
+
+//==============================================================================
+std::size_t Timeline::upper_bound(const Time time) const
+{
+  if(_buckets.empty())
+    return 0;
+
+  // The first key that is strictly greater than the time
+  const Duration::rep delta = (time - _origin).count();
+  const Duration::rep d = BucketDuration.count();
+  const int64_t offset = delta < 0? 0 : delta/d + 1;
+
+  return std::min(static_cast<std::size_t>(offset), _buckets.size());
+}
+
+//==============================================================================
+void Timeline::pop_front(const std::size_t count)
+{
+  assert(count <= _buckets.size());
+  _buckets.erase(_buckets.begin(), _buckets.begin() + count);
+  _origin += static_cast<Duration::rep>(count)*BucketDuration;
+  _first += static_cast<int64_t>(count);
+}
+
+//==============================================================================
+auto Timeline::bucket(const int64_t number) -> Bucket&
+{
+  assert(_first <= number);
+  assert(number - _first < static_cast<int64_t>(_buckets.size()));
+  return _buckets[static_cast<std::size_t>(number - _first)];
+}
+
+//==============================================================================
+void Timeline::remove(const int64_t number, const std::size_t slot)
+{
+  Bucket& b = bucket(number);
+  assert(slot < b.size());
+
+  // Move the last entry of the bucket into the vacated position
+  if(slot + 1 < b.size())
+  {
+    const ConstEntryPtr& moved = b.back();
+    moved->bucket_slots[
+        static_cast<std::size_t>(number - moved->first_bucket)] = slot;
+    b[slot] = std::move(b.back());
+  }
+
+  b.pop_back();
+}
+
+//==============================================================================
+int64_t Timeline::bucket_offset(const Time time) const
+{
+  // Find the index of the first bucket whose key is not less than the time,
+  // which is the ceiling of (time - origin)/BucketDuration.
+  const Duration::rep delta = (time - _origin).count();
+  const Duration::rep d = BucketDuration.count();
+  if(delta > 0)
+    return (delta + d - 1)/d;
+
+  return -((-delta)/d);
+}
+
+//==============================================================================
+bool EntryMap::insert(const EntryPtr& entry)
+{
+  const Version version = entry->version;
+  if(_entries.empty())
+  {
+    _front = version;
+    _entries.push_back(entry);
+    _size = 1;
+    return true;
+  }
+
+  if(const auto index = offset(version))
+  {
+    EntryPtr& existing = _entries[*index];
+    if(existing)
+      return false;
+
+    existing = entry;
+    ++_size;
+    return true;
+  }
+
+  // The modular difference tells us which end of the storage the version
+  // belongs on, even if the version numbers have overflowed.
+  const Version ahead = version - _front;
+  const Version behind = _front - version;
+  if(ahead < behind)
+  {
+    _entries.resize(static_cast<std::size_t>(ahead), nullptr);
+    _entries.push_back(entry);
+  }
+  else
+  {
+    _entries.insert(
+          _entries.begin(), static_cast<std::size_t>(behind), nullptr);
+    _entries.front() = entry;
+    _front = version;
+  }
+
+  ++_size;
+  return true;
+}
+
+//==============================================================================
+EntryPtr EntryMap::find(const Version version) const
+{
+  if(const auto index = offset(version))
+    return _entries[*index];
+
+  return nullptr;
+}
+
+//==============================================================================
+void EntryMap::erase(const Version version)
+{
+  const auto index = offset(version);
+  if(!index || !_entries[*index])
+    return;
+
+  _entries[*index] = nullptr;
+  --_size;
+
+  while(!_entries.empty() && !_entries.front())
+  {
+    _entries.pop_front();
+    ++_front;
+  }
+
+  while(!_entries.empty() && !_entries.back())
+    _entries.pop_back();
+}
+
+//==============================================================================
+rmf_utils::optional<std::size_t> EntryMap::offset(const Version version) const
+{
+  const Version index = version - _front;
+  if(index < _entries.size())
+    return static_cast<std::size_t>(index);
+
+  return rmf_utils::nullopt;
+}
+
+//==============================================================================
+std::size_t SlotAllocator::acquire()
+{
+  if(_free.empty())
+    return _next++;
+
+  const std::size_t slot = _free.back();
+  _free.pop_back();
+  return slot;
+}
+
+//==============================================================================
+void SlotAllocator::release(const std::size_t slot)
+{
+  _free.push_back(slot);
+}
+
+namespace {
+//==============================================================================
+struct VisitStamps
+{
+  std::vector<uint64_t> stamps;
+  uint64_t epoch = 0;
+
+  uint64_t next_epoch()
+  {
+    // An epoch of 0 would match every stamp that has never been visited, and
+    // the epochs after it could match stamps from before the wraparound, so
+    // all of the stamps get forgotten when this happens.
+    if(++epoch == 0)
+    {
+      std::fill(stamps.begin(), stamps.end(), 0);
+      epoch = 1;
+    }
+
+    return epoch;
+  }
+
+  static VisitStamps& get()
+  {
+    static thread_local VisitStamps visit_stamps;
+    return visit_stamps;
+  }
+};
+} // anonymous namespace
+
+//==============================================================================
+VisitedSet::VisitedSet(const std::size_t capacity)
+  : _stamps(VisitStamps::get().stamps),
+    _epoch(VisitStamps::get().next_epoch())
+{
+  if(_stamps.size() < capacity)
+    _stamps.resize(capacity, 0);
+}
+
+//==============================================================================
+MapSnapshot::MapSnapshot(const Timeline& timeline, const std::size_t capacity)
+{
+  VisitedSet visited(capacity);
+  for(std::size_t i=0; i < timeline.size(); ++i)
+  {
+    for(const ConstEntryPtr& entry : timeline[i])
+    {
+      // The timeline still holds the last version of each erased trajectory
+      if(entry->succeeded_by || !visited.insert(*entry))
+        continue;
+
+      const Trajectory& trajectory = entry->trajectory;
+      longest = std::max(
+            longest, *trajectory.finish_time() - *trajectory.start_time());
+      entries.push_back(entry);
+    }
+  }
+
+  std::sort(entries.begin(), entries.end(),
+            [](const ConstEntryPtr& a, const ConstEntryPtr& b) -> bool
+  {
+    return *a->trajectory.start_time() < *b->trajectory.start_time();
+  });
+}
+
+//==============================================================================
+std::pair<std::size_t, std::size_t> MapSnapshot::get_range(
+    const Time* const lower_time_bound,
+    const Time* const upper_time_bound) const
+{
+  // No trajectory that starts more than the longest duration before the lower
+  // bound can still be active at the lower bound.
+  auto begin = entries.begin();
+  if(lower_time_bound)
+  {
+    begin = std::lower_bound(
+          entries.begin(), entries.end(), *lower_time_bound - longest,
+          [](const ConstEntryPtr& entry, const Time time) -> bool
+    {
+      return *entry->trajectory.start_time() < time;
+    });
+  }
+
+  auto end = entries.end();
+  if(upper_time_bound)
+  {
+    end = std::upper_bound(
+          begin, entries.end(), *upper_time_bound,
+          [](const Time time, const ConstEntryPtr& entry) -> bool
+    {
+      return time < *entry->trajectory.start_time();
+    });
+  }
+
+  return std::make_pair(begin - entries.begin(), end - entries.begin());
 }
 
 //==============================================================================
@@ -109,7 +680,7 @@ void ViewRelevanceInspector::inspect(
     return;
 
   if(rmf_traffic::internal::detect_conflicts(
-       entry->trajectory, spacetime_region, nullptr))
+       entry->trajectory, spacetime_region, nullptr, entry->get_bounds()))
     elements.emplace_back(Viewer::View::Element{
                             entry->version, entry->trajectory});
 }
@@ -146,190 +717,255 @@ internal::EntryPtr Viewer::Implementation::add_entry(
     internal::EntryPtr entry,
     const bool erasure)
 {
-  all_entries.insert(std::make_pair(entry->version, entry));
+  compact_if_due(1);
+  store_entry(entry);
 
   if(!erasure)
   {
-    const Trajectory& trajectory = entry->trajectory;
-    assert(trajectory.start_time());
-    const Time start_time = *trajectory.start_time();
-    const Time finish_time = *trajectory.finish_time();
-
-    const MapToTimeline::iterator map_it = timelines.insert(
-          std::make_pair(entry->trajectory.get_map_name(), Timeline())).first;
-
-    Timeline& timeline = map_it->second;
-
-    const Timeline::iterator start_it =
-        get_timeline_iterator(timeline, start_time);
-    const Timeline::iterator finish_it =
-        get_timeline_iterator(timeline, finish_time);
-
-    const Timeline::const_iterator end_it = ++Timeline::iterator(finish_it);
-
-    for(auto it = start_it; it != end_it; ++it)
+    // Only the latest version of each trajectory is kept in the timelines and
+    // grids. The version that this entry succeeds can hand over its buckets.
+    const internal::ConstEntryPtr& previous = entry->succeeds;
+    if(previous && !previous->bucket_slots.empty())
+    {
+      transfer(previous, entry);
+      grid_erase(previous);
+    }
+    else
     {
-      it->second.push_back(entry);
+      timelines[entry->trajectory.get_map_name()].insert(entry);
     }
+
+    grid_insert(entry);
   }
 
   return entry;
 }
 
 //==============================================================================
-void Viewer::Implementation::modify_entry(
-    const internal::EntryPtr& entry,
-    Trajectory new_trajectory,
-    const Version new_id)
+void Viewer::Implementation::compact_if_due(const std::size_t new_versions)
 {
-  const Version old_version = entry->version;
-  all_entries.erase(old_version);
-  entry->version = new_id;
-  all_entries.insert(std::make_pair(new_id, entry));
+  if(!oldest_needed_version)
+    return;
+
+  versions_since_compaction += new_versions;
+  if(versions_since_compaction >= compaction_interval)
+  {
+    compact(*oldest_needed_version);
+    versions_since_compaction = 0;
+  }
+}
 
-  // TODO(MXG): Handle the case where a replacement changes the map name
+//==============================================================================
+void Viewer::Implementation::store_entry(const internal::EntryPtr& entry)
+{
+  forget_snapshot(entry->trajectory.get_map_name());
 
-  // TODO(MXG): It should be posssible to improve performance for entry
-  // modifications by applying the change directly to the original Trajectory
-  // object instead of making a copy.
-  Timeline& timeline = timelines.at(entry->trajectory.get_map_name());
+  all_entries.insert(entry);
+  entry->slot = slots.acquire();
 
-  const Time old_start = *entry->trajectory.start_time();
-  const Time old_end = *entry->trajectory.finish_time();
-  // TODO(MXG): A micro-optimization might be to store these iterators in the
-  // entry data so we don't need to look them up again.
-  const Timeline::iterator old_start_it = timeline.lower_bound(old_start);
-  const Timeline::iterator old_end_it = timeline.lower_bound(old_end);
+  if(record_changes)
+    change_log.push_back(entry);
+}
 
-  const Time new_start = *new_trajectory.start_time();
-  const Time new_end = *new_trajectory.finish_time();
-  const Timeline::iterator new_start_it =
-      get_timeline_iterator(timeline, new_start);
-  const Timeline::iterator new_end_it =
-      get_timeline_iterator(timeline, new_end);
+//==============================================================================
+void Viewer::Implementation::place_entries(
+    const std::vector<internal::EntryPtr>& entries)
+{
+  if(entries.empty())
+    return;
 
-  entry->trajectory = std::move(new_trajectory);
+  // The versions of a batch might not be consecutive, but nothing else in
+  // this viewer can have a version between the first and last of them.
+  const Version first = entries.front()->version;
+  const Version span = entries.back()->version - first;
+  const auto in_batch = [&](const internal::Entry& entry) -> bool
+  {
+    return entry.version - first <= span;
+  };
 
-  // Fix the bucketing for this entry
-  if(old_end_it->first < new_start_it->first
-     || new_end_it->first < old_start_it->first)
+  const auto is_erasure = [](const internal::Entry& entry) -> bool
   {
-    for(auto it = new_start_it; it != ++Timeline::iterator(new_end_it); ++it)
-    {
-      Bucket& bucket = it->second;
-      bucket.push_back(entry);
-    }
+    return entry.change
+        && entry.change->get_mode() == Database::Change::Mode::Erase;
+  };
+
+  // Pairs of the entry that needs to be placed and the version from before
+  // the batch that it grew out of, if there is one
+  using Placement = std::pair<internal::ConstEntryPtr, internal::ConstEntryPtr>;
+  std::vector<Placement> placements;
+  placements.reserve(entries.size());
+  for(const internal::EntryPtr& entry : entries)
+  {
+    // Only the last version of each lineage goes into the timelines and grids
+    if(entry->succeeded_by)
+      continue;
 
-    for(auto it = old_start_it; it != ++Timeline::iterator(old_end_it); ++it)
+    internal::ConstEntryPtr target = entry;
+    if(is_erasure(*entry))
     {
-      Bucket& bucket = it->second;
-      bucket.erase(std::remove(bucket.begin(), bucket.end(), entry),
-                   bucket.end());
+      // The last version of an erased trajectory stays in the timelines and
+      // grids, so it only needs to be placed if it came from this batch.
+      target = entry->succeeds;
+      if(!target || !in_batch(*target) || is_erasure(*target))
+        continue;
     }
+
+    internal::ConstEntryPtr previous = target->succeeds;
+    while(previous && in_batch(*previous))
+      previous = previous->succeeds;
+
+    placements.emplace_back(std::move(target), std::move(previous));
   }
-  else
+
+  // Group the placements by map so that each timeline only gets looked up
+  // once
+  std::stable_sort(placements.begin(), placements.end(),
+                   [](const Placement& a, const Placement& b) -> bool
+  {
+    return a.first->trajectory.get_map_name()
+        < b.first->trajectory.get_map_name();
+  });
+
+  std::string map;
+  internal::Timeline* timeline = nullptr;
+  for(const Placement& placement : placements)
   {
-    if(old_start_it->first < new_start_it->first)
+    const internal::ConstEntryPtr& entry = placement.first;
+    const internal::ConstEntryPtr& previous = placement.second;
+    std::string entry_map = entry->trajectory.get_map_name();
+    if(!timeline || map != entry_map)
     {
-      for(auto it = old_start_it; it != new_start_it; ++it)
-      {
-        Bucket& bucket = it->second;
-        bucket.erase(std::remove(bucket.begin(), bucket.end(), entry),
-                     bucket.end());
-      }
+      timeline = &timelines[entry_map];
+      map = std::move(entry_map);
     }
-    else
+
+    if(previous && !previous->bucket_slots.empty())
     {
-      for(auto it = new_start_it; it != old_start_it; ++it)
+      const std::string previous_map = previous->trajectory.get_map_name();
+      if(previous_map == map)
       {
-        Bucket& bucket = it->second;
-        bucket.push_back(entry);
+        timeline->replace(previous, entry);
       }
-    }
-
-    if(new_end_it->first < old_end_it->first)
-    {
-      const auto begin_erase = ++Timeline::iterator(new_end_it);
-      const auto end_erase = ++Timeline::iterator(old_end_it);
-      for(auto it = begin_erase; it != end_erase; ++it)
+      else
       {
-        Bucket& bucket = it->second;
-        bucket.erase(std::remove(bucket.begin(), bucket.end(), entry),
-                     bucket.end());
+        forget_snapshot(previous_map);
+        timelines.at(previous_map).erase(previous);
+        timeline->insert(entry);
       }
+
+      grid_erase(previous);
     }
     else
     {
-      const auto begin_insert = ++Timeline::iterator(old_end_it);
-      const auto end_insert = ++Timeline::iterator(new_end_it);
-      for(auto it = begin_insert; it != end_insert; ++it)
-      {
-        Bucket& bucket = it->second;
-        bucket.push_back(entry);
-      }
+      timeline->insert(entry);
     }
+
+    grid_insert(entry);
   }
 }
 
 //==============================================================================
-void Viewer::Implementation::erase_entry(Version id)
+void Viewer::Implementation::transfer(
+    const internal::ConstEntryPtr& from,
+    const internal::ConstEntryPtr& to)
 {
-  const internal::EntryPtr& entry = get_entry_iterator(id, "erasure")->second;
+  const std::string& old_map = from->trajectory.get_map_name();
+  const std::string& new_map = to->trajectory.get_map_name();
+  if(old_map == new_map)
+  {
+    timelines.at(new_map).replace(from, to);
+    return;
+  }
+
+  forget_snapshot(old_map);
+  timelines.at(old_map).erase(from);
+  timelines[new_map].insert(to);
+}
 
-  Timeline& timeline = timelines.at(entry->trajectory.get_map_name());
+//==============================================================================
+void Viewer::Implementation::forget_snapshot(const std::string& map)
+{
+  snapshot.reset();
+  if(!map_snapshots.empty())
+    map_snapshots.erase(map);
+}
 
-  const Time old_start = *entry->trajectory.start_time();
-  const Time old_end = *entry->trajectory.finish_time();
-  // TODO(MXG): A micro-optimization might be to store these iterators in the
-  // entry data so we don't need to look them up again.
-  const Timeline::iterator begin_it = timeline.lower_bound(old_start);
-  const Timeline::iterator end_it = ++timeline.lower_bound(old_end);
-  for(auto it = begin_it; it != end_it; ++it)
+//==============================================================================
+internal::ConstMapSnapshotPtr Viewer::Implementation::get_map_snapshot(
+    const MapToTimeline::value_type& timeline) const
+{
+  internal::ConstMapSnapshotPtr& map = map_snapshots[timeline.first];
+  if(!map)
   {
-    Bucket& bucket = it->second;
-    bucket.erase(std::remove(bucket.begin(), bucket.end(), entry),
-                 bucket.end());
+    map = std::make_shared<internal::MapSnapshot>(
+          timeline.second, slots.capacity());
   }
 
-  all_entries.erase(id);
+  return map;
 }
 
 //==============================================================================
-auto Viewer::Implementation::get_timeline_iterator(
-    Timeline& timeline, const Time time) -> Timeline::iterator
+void Viewer::Implementation::modify_entry(
+    const internal::EntryPtr& entry,
+    Trajectory new_trajectory,
+    const Version new_id)
 {
-  Timeline::iterator start_it = timeline.lower_bound(time);
+  const Version old_version = entry->version;
+  all_entries.erase(old_version);
+  entry->version = new_id;
+  all_entries.insert(entry);
 
-  if(start_it == timeline.end())
-  {
-    if(timeline.empty())
-    {
-      // This timeline is completely empty, so we'll begin creating buckets
-      // starting from the time of this trajectory.
-      return timeline.insert(
-            timeline.end(),
-            std::make_pair(time + PartialBucketDuration, Bucket()));
-    }
+  // The timeline needs to know the map that the entry was on before, so we
+  // take it out of the timeline of that map if the map is changing. Otherwise
+  // its buckets can be shifted in place.
+  const std::string& old_map = entry->trajectory.get_map_name();
+  if(old_map != new_trajectory.get_map_name())
+    timelines.at(old_map).erase(entry);
 
-    Timeline::iterator last_it = --timeline.end();
-    while(last_it->first < time)
-    {
-      last_it = timeline.insert(
-            timeline.end(),
-            std::make_pair(last_it->first + BucketDuration, Bucket()));
-    }
+  grid_erase(entry);
 
-    return last_it;
-  }
+  entry->trajectory = std::move(new_trajectory);
+  entry->update_bounds();
 
-  while(time + BucketDuration < start_it->first)
-  {
-    start_it = timeline.insert(
-          start_it,
-          std::make_pair(start_it->first - BucketDuration, Bucket()));
-  }
+  internal::Timeline& timeline = timelines[entry->trajectory.get_map_name()];
+  if(entry->bucket_slots.empty())
+    timeline.insert(entry);
+  else
+    timeline.replace(entry, entry);
+
+  grid_insert(entry);
+}
+
+//==============================================================================
+void Viewer::Implementation::delay_entry(
+    const internal::EntryPtr& entry,
+    const Time from,
+    const Duration delay,
+    const Version new_id)
+{
+  all_entries.erase(entry->version);
+  entry->version = new_id;
+  all_entries.insert(entry);
+
+  // The timing of the trajectory can change the shape of its splines, so the
+  // spatial bounds still need to be refreshed.
+  grid_erase(entry);
+  apply_delay(entry->trajectory, from, delay);
+  entry->update_bounds();
 
-  return start_it;
+  timelines.at(entry->trajectory.get_map_name()).replace(entry, entry);
+  grid_insert(entry);
+}
+
+//==============================================================================
+void Viewer::Implementation::erase_entry(Version id)
+{
+  const internal::EntryPtr entry = get_entry(id, "erasure");
+
+  timelines.at(entry->trajectory.get_map_name()).erase(entry);
+  grid_erase(entry);
+  slots.release(entry->slot);
+  all_entries.erase(id);
 }
 
 namespace {
@@ -351,72 +987,185 @@ std::string throw_missing_id_error(
 } // anonymous namespace
 
 //==============================================================================
-auto Viewer::Implementation::get_entry_iterator(
+internal::EntryPtr Viewer::Implementation::get_entry(
     const Version id,
-    const std::string& operation) -> EntryMap::iterator
+    const std::string& operation) const
 {
-  const auto old_entry_it = all_entries.find(id);
-  if(old_entry_it == all_entries.end())
+  internal::EntryPtr entry = all_entries.find(id);
+  if(!entry)
   {
     throw_missing_id_error(
           operation, id, oldest_version, latest_version);
   }
 
-  return old_entry_it;
+  return entry;
 }
 
 //==============================================================================
-void Viewer::Implementation::cull(Version id, Time time)
+bool Viewer::Implementation::cull(Version id, Time time)
 {
+  std::unordered_set<Version> culled;
+  for(auto& pair : timelines)
+    pair.second.cull(time, culled);
+
+  if(culled.empty())
+    return false;
+
   cull_has_occurred = true;
   last_cull = std::make_pair(id, time);
+  snapshot.reset();
+  map_snapshots.clear();
+
+  // The timelines only hold the latest version of each trajectory, so we also
+  // need to cull the versions that came before it, as well as an erasure that
+  // might have come after it.
+  std::vector<internal::EntryPtr> culled_entries;
+  culled_entries.reserve(culled.size());
+  for(const Version v : culled)
+  {
+    const internal::EntryPtr entry = all_entries.find(v);
+    if(!entry)
+      continue;
 
-  std::unordered_set<Version> culled;
-  for(auto& pair : timelines)
+    culled_entries.push_back(entry);
+    const internal::Entry* other = entry->succeeds.get();
+    for(; other; other = other->succeeds.get())
+      culled_entries.push_back(all_entries.find(other->version));
+
+    for(other = entry->succeeded_by; other; other = other->succeeded_by)
+      culled_entries.push_back(all_entries.find(other->version));
+  }
+
+  for(const internal::EntryPtr& entry : culled_entries)
   {
-    Timeline& timeline = pair.second;
-    const Timeline::iterator last_it = timeline.lower_bound(time);
-    const Timeline::iterator end_it = last_it == timeline.end()?
-          timeline.end() : ++Timeline::iterator(last_it);
+    // Skip anything that was already culled
+    if(!entry || all_entries.find(entry->version) != entry)
+      continue;
+
+    culled.insert(entry->version);
+    grid_erase(entry);
+    slots.release(entry->slot);
+    all_entries.erase(entry->version);
+  }
 
-    for(Timeline::iterator it = timeline.begin(); it != end_it; ++it)
+  if(!culled.empty() && !change_log.empty())
+  {
+    change_log.erase(
+          std::remove_if(change_log.begin(), change_log.end(),
+                         [&](const internal::ConstEntryPtr& entry) -> bool
     {
-      Bucket& bucket = it->second;
-      const Bucket::iterator removed =
-          std::remove_if(bucket.begin(), bucket.end(),
-                     [&](const internal::ConstEntryPtr& entry) -> bool
-      {
-        return *entry->trajectory.finish_time() < time;
-      });
+      return culled.count(entry->version) > 0;
+    }), change_log.end());
+  }
+
+  if(!all_entries.empty())
+    oldest_version = all_entries.oldest();
 
-      for(Bucket::iterator bit = removed; bit != bucket.end(); ++bit)
-        culled.insert((*bit)->version);
+  return true;
+}
+
+//==============================================================================
+void Viewer::Implementation::compact(const Version oldest_needed)
+{
+  // The change log is sorted by version, so everything that might be discarded
+  // is at the front of it. Whatever we keep gets shifted forward in place.
+  const internal::VersionRange range(oldest_version);
+  auto keep = change_log.begin();
+  auto it = change_log.begin();
+  for(; it != change_log.end(); ++it)
+  {
+    const internal::ConstEntryPtr& entry = *it;
+    if(!range.less_or_equal(entry->version, oldest_needed))
+      break;
+
+    // A mirror that has reached oldest_needed knows some version of this
+    // trajectory that is at least as new as the successor, so it will never
+    // need to be updated from this entry. Likewise an erasure that came before
+    // oldest_needed has already been received by every such mirror.
+    const internal::Entry* next = entry->succeeded_by;
+    const bool superseded =
+        next && range.less_or_equal(next->version, oldest_needed);
+    const bool erasure = !next && entry->change
+        && entry->change->get_mode() == Database::Change::Mode::Erase;
+
+    if(!superseded && !erasure)
+    {
+      if(keep != it)
+        *keep = std::move(*it);
 
-      bucket.erase(removed, bucket.end());
+      ++keep;
+      continue;
     }
 
-    Timeline::iterator stop_erasing = timeline.begin();
-    for(Timeline::iterator it = timeline.begin(); it != end_it; ++it)
+    if(next)
     {
-      const Bucket& bucket = it->second;
-      if(!bucket.empty())
-      {
-        // If this bucket is not empty, then stop the erasing now
-        break;
-      }
+      // The successor becomes the oldest version of its lineage
+      all_entries.find(next->version)->succeeds = nullptr;
+    }
 
-      // If this bucket is empty, then stop the erasing at the next entry
-      stop_erasing = ++Timeline::iterator(it);
+    // The last version of an erased trajectory is still in the timelines and
+    // grids
+    if(!entry->bucket_slots.empty())
+    {
+      timelines.at(entry->trajectory.get_map_name()).erase(entry);
+      grid_erase(entry);
     }
 
-    timeline.erase(timeline.begin(), stop_erasing);
+    slots.release(entry->slot);
+    all_entries.erase(entry->version);
   }
 
-  for(const Version v : culled)
-    all_entries.erase(v);
+  change_log.erase(keep, it);
 
   if(!all_entries.empty())
-    oldest_version = all_entries.begin()->first;
+    oldest_version = all_entries.oldest();
+}
+
+//==============================================================================
+void Viewer::Implementation::set_spatial_cell_size(const double cell_size)
+{
+  if(!(cell_size >= 0.0) || !std::isfinite(cell_size))
+  {
+    throw std::invalid_argument(
+          "[rmf_traffic::schedule::Viewer::set_spatial_cell_size] Invalid "
+          "cell size [" + std::to_string(cell_size) + "]");
+  }
+
+  spatial_cell_size = cell_size;
+  grids.clear();
+
+  all_entries.for_each([&](const internal::EntryPtr& entry)
+  {
+    // The grids hold the same entries as the timelines. Erasure entries and
+    // older versions of trajectories are not in either.
+    if(!entry->bucket_slots.empty())
+      grid_insert(entry);
+  });
+}
+
+//==============================================================================
+void Viewer::Implementation::grid_insert(const internal::ConstEntryPtr& entry)
+{
+  if(spatial_cell_size <= 0.0)
+    return;
+
+  const std::string& map = entry->trajectory.get_map_name();
+  auto grid_it = grids.find(map);
+  if(grid_it == grids.end())
+  {
+    grid_it = grids.insert(
+          std::make_pair(map, internal::SpatialGrid(spatial_cell_size))).first;
+  }
+
+  grid_it->second.insert(entry);
+}
+
+//==============================================================================
+void Viewer::Implementation::grid_erase(const internal::ConstEntryPtr& entry)
+{
+  const auto grid_it = grids.find(entry->trajectory.get_map_name());
+  if(grid_it != grids.end())
+    grid_it->second.erase(entry);
 }
 
 //==============================================================================
@@ -458,16 +1207,26 @@ Trajectory add_delay(
     const Time time,
     const Duration delay)
 {
-  assert(new_trajectory.start_time());
-  if (time <= *new_trajectory.start_time())
+  apply_delay(new_trajectory, time, delay);
+  return new_trajectory;
+}
+
+//==============================================================================
+void apply_delay(
+    Trajectory& trajectory,
+    const Time time,
+    const Duration delay)
+{
+  assert(trajectory.start_time());
+  if (time <= *trajectory.start_time())
   {
-    new_trajectory.begin()->adjust_finish_times(delay);
-    return new_trajectory;
+    trajectory.begin()->adjust_finish_times(delay);
+    return;
   }
-  else if(*new_trajectory.finish_time() < time)
+  else if(*trajectory.finish_time() < time)
   {
     // No need for an adjustment
-    return new_trajectory;
+    return;
   }
 
   if (delay.count() < 0)
@@ -476,45 +1235,27 @@ Trajectory add_delay(
     // but we apply it to the entire trajectory without being concerned about
     // the from_time parameter.
     // TODO(MXG): Consider if there is a more "correct" way to support this.
-    new_trajectory.begin()->adjust_finish_times(delay);
-    return new_trajectory;
+    trajectory.begin()->adjust_finish_times(delay);
+    return;
   }
 
-  Trajectory::iterator delayed_segment = new_trajectory.find(time);
-  assert(delayed_segment != new_trajectory.end());
+  Trajectory::iterator delayed_segment = trajectory.find(time);
+  assert(delayed_segment != trajectory.end());
 
   // The delay is generally meant to apply to the current moment in time.
   // Therefore the previous waypoint on the trajectory is still relevant to
   // the timing of the current trajectory. If we don't also shift the previous
   // waypoint by the delay, then the current trajectory will get warped, and
   // the schedule will predict a warped motion for the robot.
-  if (delayed_segment != new_trajectory.begin())
+  if (delayed_segment != trajectory.begin())
     --delayed_segment;
 
   // TODO(MXG): Consider inserting a new segment(s) in the trajectory when
   // adding the delay. That may help to smooth things out further.
 
   delayed_segment->adjust_finish_times(delay);
-
-  return new_trajectory;
 }
 
-//==============================================================================
-class Viewer::View::Implementation
-{
-public:
-
-  std::vector<Element> elements;
-
-  static View make_view(std::vector<Element> elements)
-  {
-    View view;
-    view._pimpl = rmf_utils::make_impl<Implementation>(
-          Implementation{std::move(elements)});
-    return view;
-  }
-};
-
 //==============================================================================
 class Viewer::View::IterImpl
 {
@@ -562,6 +1303,18 @@ Version Viewer::latest_version() const
   return _pimpl->latest_version;
 }
 
+//==============================================================================
+void Viewer::set_spatial_cell_size(const double cell_size)
+{
+  _pimpl->set_spatial_cell_size(cell_size);
+}
+
+//==============================================================================
+double Viewer::get_spatial_cell_size() const
+{
+  return _pimpl->spatial_cell_size;
+}
+
 //==============================================================================
 Viewer::Viewer()
   : _pimpl(rmf_utils::make_impl<Implementation>())
@@ -574,6 +1327,54 @@ std::size_t Viewer::Debug::get_num_entries(const Viewer& viewer)
   return viewer._pimpl->all_entries.size();
 }
 
+//==============================================================================
+const Trajectory* Viewer::Debug::get_trajectory(
+    const Viewer& viewer, const Version version)
+{
+  const auto entry = viewer._pimpl->all_entries.find(version);
+  return entry? &entry->trajectory : nullptr;
+}
+
+//==============================================================================
+std::size_t Viewer::Debug::get_slot_capacity(const Viewer& viewer)
+{
+  return viewer._pimpl->slots.capacity();
+}
+
+//==============================================================================
+void Viewer::Debug::set_visit_epoch(const uint64_t epoch)
+{
+  internal::VisitStamps::get().epoch = epoch;
+}
+
+//==============================================================================
+std::size_t Viewer::Debug::get_visit_stamp_count()
+{
+  return internal::VisitStamps::get().stamps.size();
+}
+
+//==============================================================================
+std::size_t Viewer::Debug::count_region_candidates(
+    const Viewer& viewer,
+    const Query::Spacetime::Regions& regions)
+{
+  struct Counter
+  {
+    std::size_t count = 0;
+
+    void inspect(
+        const internal::ConstEntryPtr&,
+        const rmf_traffic::internal::Spacetime&)
+    {
+      ++count;
+    }
+  };
+
+  Counter counter;
+  viewer._pimpl->inspect_spacetime_region(regions, counter);
+  return counter.count;
+}
+
 } // namespace schedule
 
 
@@ -19,11 +19,15 @@
 #define SRC__RMF_TRAFFIC__SCHEDULE__VIEWERINTERNAL_HPP
 
 #include "../DetectConflictInternal.hpp"
+#include "../SmallVector.hpp"
 
 #include <rmf_traffic/schedule/Viewer.hpp>
 #include <rmf_traffic/schedule/Database.hpp>
 
-#include <map>
+#include <rmf_utils/optional.hpp>
+
+#include <deque>
+#include <limits>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -38,6 +42,10 @@ using ConstEntryPtr = std::shared_ptr<const Entry>;
 using ChangePtr = std::unique_ptr<Database::Change>;
 using ConstChangePtr = std::unique_ptr<const Database::Change>;
 
+// Entries in the order that they were added to a Database, which is also the
+// order of their version numbers
+using ChangeLog = std::deque<ConstEntryPtr>;
+
 //==============================================================================
 struct Entry
 {
@@ -50,18 +58,49 @@ struct Entry
   // Succeeds
   ConstEntryPtr succeeds;
 
-  // A version that succeeded this entry, if such a version exists
-  ConstEntryPtr succeeded_by;
+  // A version that succeeded this entry, if such a version exists. This does
+  // not own the successor, because the successor already owns this entry
+  // through its succeeds field, and owning pointers in both directions would
+  // keep every lineage alive forever.
+  const Entry* succeeded_by = nullptr;
 
   // The change that led to this entry
   ConstChangePtr change;
 
+  // The spatial bounds of the trajectory, used to quickly rule out spacetime
+  // region queries. Erasure entries have no bounds.
+  rmf_utils::optional<rmf_traffic::internal::BoundingBox> bounds;
+
+  // Recompute the bounds after the trajectory has changed
+  void update_bounds();
+
+  const rmf_traffic::internal::BoundingBox* get_bounds() const
+  {
+    return bounds? &(*bounds) : nullptr;
+  }
+
+  // A dense index for this entry, handed out by the SlotAllocator of the
+  // viewer that it was added to
+  std::size_t slot = 0;
+
+  // Where this entry is stored in its Timeline: the number of the first bucket
+  // that it is in, and its position inside of each bucket from that one
+  // onwards. The Timeline keeps these up to date so that it never needs to
+  // search its buckets for an entry. They are mutable because the buckets
+  // only hold const pointers to their entries.
+  mutable int64_t first_bucket = 0;
+  mutable rmf_traffic::internal::SmallVector<std::size_t, 4> bucket_slots;
+
   // Initialize this entry
   Entry(
       Trajectory _trajectory,
       Version _version,
       ConstEntryPtr _succeeds = nullptr,
       ChangePtr _change = nullptr);
+
+  // Release the versions that this entry succeeds one at a time, so that a
+  // long lineage does not get destroyed through deep recursion
+  ~Entry();
 };
 
 //==============================================================================
@@ -126,6 +165,350 @@ struct DeepIterator
   }
 };
 
+//==============================================================================
+/// A container of entries that is indexed by version. Versions get handed out
+/// in increasing order, so the entries are stored contiguously by their offset
+/// from the oldest version, and the versions that are no longer present are
+/// left as empty tombstones. Tombstones at either end get trimmed away.
+///
+/// This gives constant time lookups and iterates in version order. The storage
+/// spans the range from the oldest to the newest entry, so a schedule that
+/// holds on to a very old entry will also hold on to tombstones for all the
+/// versions that came after it.
+class EntryMap
+{
+public:
+
+  /// Add an entry based on its current version. If an entry with that version
+  /// is already present, nothing will change and this will return false.
+  bool insert(const EntryPtr& entry);
+
+  /// Get the entry for a version, or a nullptr if it is not present.
+  EntryPtr find(Version version) const;
+
+  /// Remove the entry for a version, if it is present.
+  void erase(Version version);
+
+  /// The number of entries that are present.
+  std::size_t size() const { return _size; }
+
+  bool empty() const { return _size == 0; }
+
+  /// The version of the oldest entry. This must not be called when empty.
+  Version oldest() const { return _front; }
+
+  /// Call f(entry) for each entry in order of version.
+  template<typename F>
+  void for_each(F&& f) const
+  {
+    for(const EntryPtr& entry : _entries)
+    {
+      if(entry)
+        f(entry);
+    }
+  }
+
+private:
+
+  /// Get the offset of a version from the front, or a nullopt if it falls
+  /// outside of the current storage.
+  rmf_utils::optional<std::size_t> offset(Version version) const;
+
+  Version _front = 0;
+  std::deque<EntryPtr> _entries;
+  std::size_t _size = 0;
+};
+
+//==============================================================================
+/// Hands out dense slot numbers for entries so that queries can keep track of
+/// which entries they have visited using a plain vector instead of a hash set.
+/// The slots of removed entries get reused.
+class SlotAllocator
+{
+public:
+
+  std::size_t acquire();
+
+  void release(std::size_t slot);
+
+  /// All slots that are in use are less than this value
+  std::size_t capacity() const { return _next; }
+
+private:
+  std::size_t _next = 0;
+  std::vector<std::size_t> _free;
+};
+
+//==============================================================================
+/// Keeps track of which entries have been visited by one query. Each entry's
+/// slot gets stamped with the epoch of the query, and the stamps are kept in
+/// thread-local storage that is reused by every query on that thread. That
+/// way starting a query does not need to allocate or clear anything.
+///
+/// Only one VisitedSet may be used at a time on any given thread.
+class VisitedSet
+{
+public:
+
+  /// \param[in] capacity
+  ///   The capacity() of the SlotAllocator for the entries that will be
+  ///   visited.
+  VisitedSet(std::size_t capacity);
+
+  /// Returns true the first time that this is called for an entry.
+  bool insert(const Entry& entry)
+  {
+    return insert(entry.slot);
+  }
+
+  /// Returns true the first time that this is called for a slot.
+  bool insert(std::size_t slot)
+  {
+    uint64_t& stamp = _stamps[slot];
+    if(stamp == _epoch)
+      return false;
+
+    stamp = _epoch;
+    return true;
+  }
+
+private:
+  std::vector<uint64_t>& _stamps;
+  uint64_t _epoch;
+};
+
+//==============================================================================
+/// A uniform 2D grid that sorts entries by where their trajectories go. It is
+/// orthogonal to the time buckets of a Timeline, and it lets region queries
+/// skip the entries whose bounding boxes are nowhere near the region.
+///
+/// Each entry is placed in every cell that its bounding box overlaps. Entries
+/// that have no bounding box, or that would cover too many cells, are kept in
+/// a separate bucket that every query will visit.
+class SpatialGrid
+{
+public:
+
+  using Bucket = std::vector<ConstEntryPtr>;
+
+  SpatialGrid(double cell_size);
+
+  /// Add an entry to the cells that its current bounds overlap.
+  void insert(const ConstEntryPtr& entry);
+
+  /// Remove an entry from the cells that it was inserted into. This does not
+  /// look at the current bounds of the entry, so it is safe to call after the
+  /// bounds have changed.
+  void erase(const ConstEntryPtr& entry);
+
+  /// Call visit(entry) for each entry that may overlap the given bounds. An
+  /// entry may be visited more than once.
+  template<typename Visitor>
+  void inspect(
+      const rmf_traffic::internal::BoundingBox& bounds,
+      Visitor&& visit) const
+  {
+    for(const ConstEntryPtr& entry : _unbounded)
+      visit(entry);
+
+    const CellRange range = get_range(bounds);
+    const auto visit_bucket = [&](const Bucket& bucket)
+    {
+      for(const ConstEntryPtr& entry : bucket)
+        visit(entry);
+    };
+
+    if(range.count() > _cells.size())
+    {
+      // The query covers more cells than are occupied, so it is faster to go
+      // through the occupied cells.
+      for(const auto& cell : _cells)
+      {
+        if(range.contains(cell.first))
+          visit_bucket(cell.second);
+      }
+
+      return;
+    }
+
+    for(int64_t x = range.min_x; x <= range.max_x; ++x)
+    {
+      for(int64_t y = range.min_y; y <= range.max_y; ++y)
+      {
+        const auto cell_it = _cells.find(key(x, y));
+        if(cell_it != _cells.end())
+          visit_bucket(cell_it->second);
+      }
+    }
+  }
+
+private:
+
+  struct CellRange
+  {
+    int64_t min_x;
+    int64_t min_y;
+    int64_t max_x;
+    int64_t max_y;
+
+    /// The number of cells in this range. This saturates instead of
+    /// overflowing for very large ranges.
+    std::size_t count() const
+    {
+      if(max_x < min_x || max_y < min_y)
+        return 0;
+
+      const auto width = static_cast<std::size_t>(max_x - min_x + 1);
+      const auto height = static_cast<std::size_t>(max_y - min_y + 1);
+      if(width > std::numeric_limits<std::size_t>::max()/height)
+        return std::numeric_limits<std::size_t>::max();
+
+      return width*height;
+    }
+
+    bool contains(uint64_t cell_key) const;
+  };
+
+  static uint64_t key(int64_t x, int64_t y);
+
+  CellRange get_range(const rmf_traffic::internal::BoundingBox& bounds) const;
+
+  double _cell_size;
+  std::unordered_map<uint64_t, Bucket> _cells;
+  Bucket _unbounded;
+
+  // The cells that each entry was placed in, or a nullopt if it was placed in
+  // the unbounded bucket
+  std::unordered_map<const Entry*, rmf_utils::optional<CellRange>> _placements;
+};
+
+//==============================================================================
+/// A sequence of time buckets that all span the same duration. The key of
+/// bucket i is origin + i*BucketDuration, and the bucket stores the entries
+/// whose time span intersects with the range ( key(i) - BucketDuration, key(i) ].
+///
+/// Because the buckets are evenly spaced, the bucket for any time is found with
+/// arithmetic instead of a search. Buckets get added to either end as needed,
+/// and culling drops the empty buckets from the front.
+///
+/// Each entry remembers its position inside of every bucket that holds it, so
+/// removing an entry is a swap-and-pop for each of its buckets. This means the
+/// order of the entries inside of a bucket is not meaningful.
+class Timeline
+{
+public:
+
+  using Bucket = std::vector<ConstEntryPtr>;
+
+  /// Add an entry to every bucket that its trajectory passes through.
+  void insert(const ConstEntryPtr& entry);
+
+  /// Remove an entry from the buckets that it was inserted into. This uses the
+  /// positions that were stored in the entry, so it is safe to call after the
+  /// trajectory of the entry has changed.
+  void erase(const ConstEntryPtr& entry);
+
+  /// Put new_entry into the buckets of its trajectory, taking over the
+  /// positions of old_entry wherever their buckets overlap, and remove
+  /// old_entry from the rest. The two entries may be the same object, in which
+  /// case its buckets get updated to match its current trajectory.
+  ///
+  /// This is much cheaper than erase() followed by insert() when the time
+  /// range of the trajectory has only shifted a little, e.g. after a delay.
+  void replace(const ConstEntryPtr& old_entry, const ConstEntryPtr& new_entry);
+
+  /// Remove every entry that finishes before the given time, and add their
+  /// versions to the culled set. Empty buckets get dropped from the front.
+  void cull(Time time, std::unordered_set<Version>& culled);
+
+  /// Get the index of the first bucket whose key is not less than the time,
+  /// or size() if there is no such bucket.
+  std::size_t lower_bound(Time time) const;
+
+  /// Get the index of the first bucket whose key is greater than the time, or
+  /// size() if there is no such bucket.
+  std::size_t upper_bound(Time time) const;
+
+  const Bucket& operator[](std::size_t index) const { return _buckets[index]; }
+
+  std::size_t size() const { return _buckets.size(); }
+
+private:
+
+  /// Get the indices of the first and last buckets that intersect with the
+  /// range [start, finish]. Buckets will be added to the timeline as needed to
+  /// cover the range, which may shift the indices of the existing buckets.
+  std::pair<std::size_t, std::size_t> get_range(Time start, Time finish);
+
+  /// Remove this many buckets from the front of the timeline.
+  void pop_front(std::size_t count);
+
+  /// Get the bucket with this number.
+  Bucket& bucket(int64_t number);
+
+  /// Swap-and-pop the entry at this slot of a bucket.
+  void remove(int64_t number, std::size_t slot);
+
+  /// The index that a bucket for this time would have, which may be outside
+  /// of the current range of buckets.
+  int64_t bucket_offset(Time time) const;
+
+  Time _origin;
+  std::deque<Bucket> _buckets;
+
+  // The number of the bucket at index 0. Bucket numbers do not change when
+  // buckets are added to or removed from the front, unlike their indices.
+  int64_t _first = 0;
+};
+
+//==============================================================================
+/// An immutable copy of the latest version of each trajectory on one map that
+/// has not been erased. A Database::Snapshot is made out of these. The entries
+/// that it points to never get modified by a Database, so a MapSnapshot can be
+/// read from any thread while the Database keeps changing.
+struct MapSnapshot
+{
+  /// The entries, sorted by the start times of their trajectories
+  std::vector<ConstEntryPtr> entries;
+
+  /// The longest duration of any trajectory in entries
+  Duration longest = Duration(0);
+
+  /// Copy the latest entries out of a timeline
+  MapSnapshot(const Timeline& timeline, std::size_t capacity);
+
+  /// Get the index range of the entries whose trajectories might intersect
+  /// with the given time bounds.
+  std::pair<std::size_t, std::size_t> get_range(
+      const Time* lower_time_bound,
+      const Time* upper_time_bound) const;
+};
+
+using ConstMapSnapshotPtr = std::shared_ptr<const MapSnapshot>;
+using MapToSnapshot = std::unordered_map<std::string, ConstMapSnapshotPtr>;
+
+//==============================================================================
+/// The shared data of a Database::Snapshot
+struct SnapshotData
+{
+  MapToSnapshot maps;
+  Version latest_version;
+
+  // The capacity() of the SlotAllocator when this snapshot was taken
+  std::size_t capacity;
+
+  // When the maps come from more than one SlotAllocator, each map gets an
+  // offset for its slots so that they do not overlap, and capacity covers all
+  // of them. Maps that are missing from here have an offset of zero.
+  std::unordered_map<std::string, std::size_t> slot_offsets;
+
+  std::size_t slot_offset(const std::string& map) const
+  {
+    const auto it = slot_offsets.find(map);
+    return it == slot_offsets.end()? 0 : it->second;
+  }
+};
+
 //==============================================================================
 /// This class allows us to correctly handle version number overflow. Since the
 /// schedule needs to continue running for an arbitrarily long time, we cannot
@@ -229,6 +612,12 @@ public:
       const Time* lower_time_bound,
       const Time* upper_time_bound) final;
 
+  /// Inspect only the entries of the log that came after after_version. Any
+  /// entry that the remote mirror needs to hear about will have a version that
+  /// is newer than after_version, so there is no need to look at the rest of
+  /// the schedule. after() must be given a version before calling this.
+  void inspect_log(const ChangeLog& log, const Query::Spacetime& spacetime);
+
   VersionRange versions;
 
   const Version* after_version;
@@ -243,23 +632,22 @@ class Viewer::Implementation
 {
 public:
 
-  using Bucket = std::vector<internal::ConstEntryPtr>;
+  using Bucket = internal::Timeline::Bucket;
+  using MapToTimeline = std::unordered_map<std::string, internal::Timeline>;
 
-  // TODO(MXG): A possible performance improvement could be to introduce spatial
-  // buckets that are orthogonal to the time buckets. This could be added later
-  // without negatively impacting the API or ABI.
 
-  // Each bucket stores trajectories whose time span intersects with the range
-  // ( key(timeline_it - 1), key(timeline_it) ].
-  using Timeline = std::map<Time, Bucket>;
-  using MapToTimeline = std::unordered_map<std::string, Timeline>;
+  MapToTimeline timelines;
 
+  // Spatial grids that are orthogonal to the time buckets. These are only used
+  // when spatial_cell_size is greater than zero.
+  using MapToGrid = std::unordered_map<std::string, internal::SpatialGrid>;
+  MapToGrid grids;
+  double spatial_cell_size = 0.0;
 
-  MapToTimeline timelines;
+  internal::EntryMap all_entries;
 
-  // TODO(MXG): Consider using a sorted vector here instead of a std::map.
-  using EntryMap = std::map<Version, internal::EntryPtr>;
-  EntryMap all_entries;
+  /// Slots for each entry in all_entries
+  internal::SlotAllocator slots;
 
   Version oldest_version = 0;
   Version latest_version = 0;
@@ -278,35 +666,112 @@ public:
   /// This field does not get used by the Database class
   Changers changers;
 
+  /// Every entry that has been added, sorted by version. This lets
+  /// Database::changes() skip over all the entries that a remote mirror
+  /// already knows about.
+  ///
+  /// This field only gets filled in when record_changes is true, which is only
+  /// the case for the Database class.
+  internal::ChangeLog change_log;
+  bool record_changes = false;
+
+  /// The oldest version that any remote mirror might still need to be updated
+  /// from. Once this is set, the history of changes from before it gets
+  /// compacted each time compaction_interval more versions have been added.
+  ///
+  /// These fields only get used by the Database class.
+  rmf_utils::optional<Version> oldest_needed_version;
+  std::size_t compaction_interval = 100;
+  std::size_t versions_since_compaction = 0;
+
+  /// The last snapshot that was taken of the Database, and a copy of each map
+  /// that has not changed since a snapshot was last taken of it. These are
+  /// thrown out as the maps change, so that taking a snapshot only needs to
+  /// copy the maps that have changed.
+  ///
+  /// These fields only get used by the Database class.
+  mutable std::shared_ptr<const internal::SnapshotData> snapshot;
+  mutable internal::MapToSnapshot map_snapshots;
+
+  /// Forget the snapshot of a map that is about to change
+  void forget_snapshot(const std::string& map);
+
+  /// Get the snapshot of a map, copying it out of its timeline if it has
+  /// changed since the last time
+  internal::ConstMapSnapshotPtr get_map_snapshot(
+      const MapToTimeline::value_type& timeline) const;
+
   internal::EntryPtr add_entry(internal::EntryPtr entry, bool erasure = false);
 
+  /// Compact the change history if enough new versions are about to be added
+  void compact_if_due(std::size_t new_versions);
+
+  /// Add an entry to all_entries and the change log without placing it in the
+  /// timelines or grids
+  void store_entry(const internal::EntryPtr& entry);
+
+  /// Place a batch of stored entries with increasing versions into the
+  /// timelines and grids. Versions that were superseded inside of the batch
+  /// are skipped over. No other entry may have a version between the first
+  /// and last versions of the batch.
+  void place_entries(const std::vector<internal::EntryPtr>& entries);
+
+  /// Move the timeline placement of one entry over to another entry that
+  /// succeeds it
+  void transfer(
+      const internal::ConstEntryPtr& from,
+      const internal::ConstEntryPtr& to);
+
   /// Used by the Mirror class to make efficient changes to entries
   void modify_entry(const internal::EntryPtr& entry,
       Trajectory new_trajectory, const Version new_id);
 
+  /// Used by the Mirror class to delay an entry without copying its trajectory
+  void delay_entry(const internal::EntryPtr& entry,
+      Time from, Duration delay, const Version new_id);
+
   /// Used by the Mirror class to erase entries that are no longer needed
   void erase_entry(Version id);
 
-  Timeline::iterator get_timeline_iterator(
-      Timeline& timeline, Time time);
-
-  EntryMap::iterator get_entry_iterator(
+  /// Get the entry for a version, or throw a std::runtime_error if it does not
+  /// exist.
+  internal::EntryPtr get_entry(
       Version id,
-      const std::string& operation);
+      const std::string& operation) const;
+
+  /// Remove every trajectory that finishes before the given time. Returns
+  /// false, without recording the cull, if there was nothing to remove.
+  bool cull(Version id, Time time);
+
+  /// Discard the versions of each trajectory that no remote mirror at or past
+  /// the oldest_needed version could still know about, as well as erasures
+  /// that every such mirror has already received.
+  void compact(Version oldest_needed);
 
-  void cull(Version id, Time time);
+  /// Change the cell size of the spatial grids and rebuild them
+  void set_spatial_cell_size(double cell_size);
 
-  static Timeline::const_iterator get_timeline_end(
-      const Timeline& timeline, const Time* upper_time_bound)
+  void grid_insert(const internal::ConstEntryPtr& entry);
+
+  void grid_erase(const internal::ConstEntryPtr& entry);
+
+  /// Get the index range of the buckets that need to be checked for the given
+  /// time bounds.
+  static std::pair<std::size_t, std::size_t> get_timeline_range(
+      const internal::Timeline& timeline,
+      const Time* lower_time_bound,
+      const Time* upper_time_bound)
   {
-    if(upper_time_bound == nullptr)
-      return timeline.end();
+    const std::size_t begin = lower_time_bound == nullptr?
+          0 : timeline.lower_bound(*lower_time_bound);
 
-    auto end = timeline.upper_bound(*upper_time_bound);
-    if(end == timeline.end())
-      return end;
+    if(upper_time_bound == nullptr)
+      return std::make_pair(begin, timeline.size());
 
-    return ++end;
+    // We include one extra bucket past the upper bound to be conservative
+    const std::size_t end = timeline.upper_bound(*upper_time_bound);
+    return std::make_pair(
+          begin, end == timeline.size()? end : end + 1);
   }
 
   template<typename RelevanceInspectorT>
@@ -314,8 +779,7 @@ public:
       const Query::Spacetime::Regions& regions,
       RelevanceInspectorT& inspector) const
   {
-    std::unordered_set<Version> checked;
-    checked.reserve(all_entries.size());
+    internal::VisitedSet checked(slots.capacity());
 
     for(const Region& region : regions)
     {
@@ -324,35 +788,76 @@ public:
       if(map_it == timelines.end())
         continue;
 
-      const Timeline& timeline = map_it->second;
+      const internal::Timeline& timeline = map_it->second;
+      const auto grid_it = grids.find(map);
+      const internal::SpatialGrid* const grid =
+          grid_it == grids.end()? nullptr : &grid_it->second;
+
       const Time* const lower_time_bound = region.get_lower_time_bound();
       const Time* const upper_time_bound = region.get_upper_time_bound();
 
-      const auto timeline_begin =
-          (lower_time_bound == nullptr)?
-            timeline.begin() : timeline.lower_bound(*lower_time_bound);
-
-      const auto timeline_end = get_timeline_end(timeline, upper_time_bound);
+      const auto timeline_range = get_timeline_range(
+            timeline, lower_time_bound, upper_time_bound);
 
       rmf_traffic::internal::Spacetime spacetime_data;
       spacetime_data.lower_time_bound = lower_time_bound;
       spacetime_data.upper_time_bound = upper_time_bound;
+      rmf_traffic::internal::BoundingBox space_bounds;
+      spacetime_data.bounds = &space_bounds;
       for(auto space_it=region.begin(); space_it != region.end(); ++space_it)
       {
         spacetime_data.pose = space_it->get_pose();
         spacetime_data.shape = space_it->get_shape();
+        space_bounds = rmf_traffic::internal::get_bounding_box(
+              spacetime_data.pose, *spacetime_data.shape);
+
+        if(grid)
+        {
+          grid->inspect(space_bounds, [&](internal::ConstEntryPtr entry_ptr)
+          {
+            // The cells of the grid are not sorted by time, so the entries
+            // that are entirely outside of the time window get skipped here.
+            const Trajectory& trajectory = entry_ptr->trajectory;
+            if(lower_time_bound
+               && *trajectory.finish_time() < *lower_time_bound)
+              return;
+
+            if(upper_time_bound
+               && *upper_time_bound < *trajectory.start_time())
+              return;
+
+            // The grid still holds the last version of an erased trajectory.
+            // We always go to the latest version so that the inspector can
+            // see that it has been erased.
+            if(entry_ptr->succeeded_by)
+            {
+              const internal::Entry* latest = entry_ptr->succeeded_by;
+              while(latest->succeeded_by)
+                latest = latest->succeeded_by;
+
+              entry_ptr = all_entries.find(latest->version);
+            }
+
+            if(!checked.insert(*entry_ptr))
+              return;
+
+            inspector.inspect(entry_ptr, spacetime_data);
+          });
+
+          continue;
+        }
 
-        auto timeline_it = timeline_begin;
-        for(; timeline_it != timeline_end; ++timeline_it)
+        for(std::size_t i = timeline_range.first;
+            i < timeline_range.second; ++i)
         {
-          const Bucket& bucket = timeline_it->second;
+          const Bucket& bucket = timeline[i];
 
           auto entry_it = bucket.begin();
           for(; entry_it != bucket.end(); ++entry_it)
           {
             const internal::ConstEntryPtr& entry_ptr = *entry_it;
             // Test if we have already checked this entry
-            if(!checked.insert(entry_ptr->version).second)
+            if(!checked.insert(*entry_ptr))
               continue;
 
             inspector.inspect(entry_ptr, spacetime_data);
@@ -369,8 +874,7 @@ public:
       const Time* upper_time_bound,
       RelevanceInspectorT& inspector) const
   {
-    std::unordered_set<Version> checked;
-    checked.reserve(all_entries.size());
+    internal::VisitedSet checked(slots.capacity());
 
     for(const std::string& map : maps)
     {
@@ -378,24 +882,20 @@ public:
       if(map_it == timelines.end())
         continue;
 
-      const Timeline& timeline = map_it->second;
+      const internal::Timeline& timeline = map_it->second;
+      const auto timeline_range = get_timeline_range(
+            timeline, lower_time_bound, upper_time_bound);
 
-      const auto timeline_begin =
-          (lower_time_bound == nullptr)?
-            timeline.begin() : timeline.lower_bound(*lower_time_bound);
-
-      const auto timeline_end = get_timeline_end(timeline, upper_time_bound);
-
-      auto timeline_it = timeline_begin;
-      for(; timeline_it != timeline_end; ++timeline_it)
+      for(std::size_t i = timeline_range.first;
+          i < timeline_range.second; ++i)
       {
-        const Bucket& bucket = timeline_it->second;
+        const Bucket& bucket = timeline[i];
 
         auto entry_it = bucket.begin();
         for(; entry_it != bucket.end(); ++entry_it)
         {
           const internal::ConstEntryPtr& entry_ptr = *entry_it;
-          if(!checked.insert(entry_ptr->version).second)
+          if(!checked.insert(*entry_ptr))
             continue;
 
           inspector.inspect(entry_ptr, lower_time_bound, upper_time_bound);
@@ -407,11 +907,10 @@ public:
   template<typename RelevanceInspectorT>
   void inspect_all(RelevanceInspectorT& inspector) const
   {
-    for(const auto pair : all_entries)
+    all_entries.for_each([&](const internal::ConstEntryPtr& entry_ptr)
     {
-      const internal::ConstEntryPtr& entry_ptr = pair.second;
       inspector.inspect(entry_ptr, nullptr, nullptr);
-    }
+    });
   }
 
   template<typename RelevanceInspectorT>
@@ -495,6 +994,28 @@ public:
 
 };
 
+//==============================================================================
+class Viewer::View::Implementation
+{
+public:
+
+  std::vector<Element> elements;
+
+  // Keeps the trajectories of the elements alive when they belong to a
+  // Database::Snapshot instead of a Viewer
+  std::shared_ptr<const void> owner;
+
+  static View make_view(
+      std::vector<Element> elements,
+      std::shared_ptr<const void> owner = nullptr)
+  {
+    View view;
+    view._pimpl = rmf_utils::make_impl<Implementation>(
+          Implementation{std::move(elements), std::move(owner)});
+    return view;
+  }
+};
+
 //==============================================================================
 Trajectory add_interruption(
     Trajectory old_trajectory,
@@ -507,6 +1028,14 @@ Trajectory add_delay(
     const Time time,
     const Duration delay);
 
+//==============================================================================
+/// Same as add_delay(), but modifies the trajectory in place instead of making
+/// a new one.
+void apply_delay(
+    Trajectory& trajectory,
+    const Time time,
+    const Duration delay);
+
 } // namespace schedule
 } // namespace rmf_traffic
 
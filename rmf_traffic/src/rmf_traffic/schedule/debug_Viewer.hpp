@@ -29,6 +29,29 @@ public:
 
   static std::size_t get_num_entries(const Viewer& viewer);
 
+  /// Get the trajectory of any version that the viewer still has an entry for,
+  /// even if it has been succeeded by a newer version. A nullptr is returned if
+  /// there is no entry for the version.
+  static const Trajectory* get_trajectory(
+      const Viewer& viewer, Version version);
+
+  /// All slots that are being used by entries of the viewer are less than
+  /// this value.
+  static std::size_t get_slot_capacity(const Viewer& viewer);
+
+  /// Set the epoch of the visit stamps on the calling thread. The next query
+  /// on this thread will use the epoch after this one.
+  static void set_visit_epoch(uint64_t epoch);
+
+  /// Get the number of visit stamps on the calling thread.
+  static std::size_t get_visit_stamp_count();
+
+  /// Get the number of entries that a query for these regions would inspect
+  /// in detail.
+  static std::size_t count_region_candidates(
+      const Viewer& viewer,
+      const Query::Spacetime::Regions& regions);
+
 };
 
 } // namespace schedule
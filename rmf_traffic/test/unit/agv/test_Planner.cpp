@@ -125,6 +125,49 @@ rmf_traffic::Trajectory test_with_obstacle(
 
   REQUIRE(plan->get_trajectories().size() == 1);
   t_obs = plan->get_trajectories().front();
+
+  // Validating with a pool of threads must give exactly the same plan. The
+  // pool only gets used when there are several trajectories to check, so we
+  // plan against a schedule that has several copies of each trajectory. The
+  // copies do not change which motions are in conflict.
+  rmf_traffic::schedule::Database crowded;
+  for (const auto& element :
+       database.query(rmf_traffic::schedule::query_everything()))
+  {
+    if (element.trajectory.size() < 2)
+      continue;
+
+    for (std::size_t i=0; i < 4; ++i)
+      crowded.insert(element.trajectory);
+  }
+
+  auto serial_options = original_plan.get_options();
+  serial_options.schedule_viewer(crowded);
+  const auto serial_plan = original_plan.replan(
+        original_plan.get_start(), serial_options);
+
+  auto parallel_options = serial_options;
+  parallel_options.validation_threads(2);
+  const auto parallel_plan = original_plan.replan(
+        original_plan.get_start(), std::move(parallel_options));
+
+  REQUIRE(serial_plan);
+  REQUIRE(parallel_plan);
+  REQUIRE(parallel_plan->get_trajectories().size() == 1);
+  CHECK(serial_plan->get_trajectories().front().duration()
+        == t_obs.duration());
+  CHECK(parallel_plan->get_trajectories().front().duration()
+        == t_obs.duration());
+
+  const auto& serial_waypoints = serial_plan->get_waypoints();
+  const auto& parallel_waypoints = parallel_plan->get_waypoints();
+  REQUIRE(parallel_waypoints.size() == serial_waypoints.size());
+  for (std::size_t i=0; i < serial_waypoints.size(); ++i)
+  {
+    CHECK(parallel_waypoints[i].time() == serial_waypoints[i].time());
+    CHECK((parallel_waypoints[i].position()
+           - serial_waypoints[i].position()).norm() == Approx(0.0));
+  }
   const Eigen::Vector2d initial_position = [&]() -> Eigen::Vector2d
   {
     if (original_plan.get_start().location())
@@ -424,6 +467,17 @@ SCENARIO("Test Options", "[options]")
     CHECK(*default_options.interrupt_flag());
   }
 
+  WHEN("Get the validation_threads")
+  {
+    CHECK(default_options.validation_threads() == 1);
+  }
+
+  WHEN("Set the validation_threads")
+  {
+    default_options.validation_threads(4);
+    CHECK(default_options.validation_threads() == 4);
+  }
+
 }
 
 SCENARIO("Test Start")
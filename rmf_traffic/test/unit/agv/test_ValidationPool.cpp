@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include "src/rmf_traffic/agv/ValidationPool.hpp"
+
+#include <rmf_utils/catch.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+
+SCENARIO("Validation pool")
+{
+  using rmf_traffic::internal::planning::ValidationPool;
+
+  for(const std::size_t num_threads : {1u, 2u, 4u})
+  {
+    DYNAMIC_SECTION("Using " << num_threads << " threads")
+    {
+      ValidationPool pool(num_threads);
+      CHECK(pool.size() == num_threads);
+
+      // Nothing satisfies the predicate
+      std::atomic<std::size_t> checked(0);
+      CHECK_FALSE(pool.any_of(1000, [&](std::size_t) -> bool
+      {
+        ++checked;
+        return false;
+      }));
+
+      // Every index must be checked exactly once
+      CHECK(checked == 1000);
+
+      // One index satisfies the predicate. We run several rounds to make sure
+      // the pool can be reused.
+      for(std::size_t round=0; round < 10; ++round)
+      {
+        const std::size_t target = 37*round;
+        CHECK(pool.any_of(1000, [&](const std::size_t i) -> bool
+        {
+          return i == target;
+        }));
+      }
+
+      // There is nothing to check
+      CHECK_FALSE(pool.any_of(0, [](std::size_t) { return true; }));
+
+      // The predicate throws. The exception must reach the caller, and every
+      // thread must be finished with the predicate by then.
+      std::atomic<std::size_t> running(0);
+      std::atomic<std::size_t> most_running(0);
+      const auto throwing = [&](const std::size_t i) -> bool
+      {
+        ++running;
+        most_running = std::max<std::size_t>(most_running, running);
+        if(i == 500)
+        {
+          --running;
+          throw std::runtime_error("test exception");
+        }
+
+        --running;
+        return false;
+      };
+
+      CHECK_THROWS_AS(pool.any_of(1000, throwing), std::runtime_error);
+      CHECK(running == 0);
+      CHECK(most_running <= num_threads);
+
+      // The pool is still usable after an exception
+      CHECK(pool.any_of(100, [](const std::size_t i) { return i == 99; }));
+    }
+  }
+}
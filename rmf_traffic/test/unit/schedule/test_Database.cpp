@@ -16,13 +16,21 @@
 */
 
 #include "utils_Database.hpp"
+#include "../utils_Trajectory.hpp"
 #include <rmf_traffic/schedule/Database.hpp>
+#include <rmf_traffic/schedule/Mirror.hpp>
 #include <rmf_traffic/geometry/Box.hpp>
 
+#include "src/rmf_traffic/debug_Trajectory.hpp"
 #include "src/rmf_traffic/schedule/debug_Viewer.hpp"
 
 #include <rmf_utils/catch.hpp>
+#include <rmf_utils/optional.hpp>
 #include<iostream>
+#include <limits>
+#include <map>
+#include <set>
+#include <thread>
 using namespace std::chrono_literals;
 
 
@@ -199,3 +207,1030 @@ SCENARIO("Test Database Conflicts")
 
 }
 
+namespace {
+
+//==============================================================================
+std::set<rmf_traffic::schedule::Version> query_ids(
+    const rmf_traffic::schedule::Viewer& viewer,
+    const rmf_traffic::schedule::Query& query)
+{
+  std::set<rmf_traffic::schedule::Version> ids;
+  for(const auto& element : viewer.query(query))
+    ids.insert(element.id);
+
+  return ids;
+}
+
+//==============================================================================
+rmf_traffic::schedule::Query make_box_query(
+    const rmf_traffic::Time start,
+    const rmf_traffic::Time finish,
+    const Eigen::Vector2d& center,
+    const double size)
+{
+  Eigen::Isometry2d tf = Eigen::Isometry2d::Identity();
+  tf.translate(center);
+
+  rmf_traffic::Region region{"test_map", start, finish, {}};
+  region.push_back(rmf_traffic::geometry::Space{
+      rmf_traffic::geometry::make_final_convex<
+        rmf_traffic::geometry::Box>(size, size), tf});
+
+  return rmf_traffic::schedule::make_query({region});
+}
+
+} // anonymous namespace
+
+//==============================================================================
+SCENARIO("Spatially indexed schedule queries")
+{
+  const rmf_traffic::Time time = std::chrono::steady_clock::now();
+  const auto profile = make_schedule_test_profile();
+
+  // Robots drive back and forth along rows that are 10 meters apart
+  rmf_traffic::schedule::Database db;
+  std::vector<rmf_traffic::schedule::Version> versions;
+  for(std::size_t i=0; i < 10; ++i)
+  {
+    versions.push_back(db.insert(make_row_trajectory(
+        "test_map", 10.0*static_cast<double>(i),
+        time + std::chrono::seconds(5*i), 20s, 40.0)));
+  }
+
+  // One long diagonal trajectory covers too many cells to be put in the grid
+  rmf_traffic::Trajectory diagonal("test_map");
+  diagonal.insert(time, profile, Eigen::Vector3d(-500, -500, 0),
+                  Eigen::Vector3d::Zero());
+  diagonal.insert(time + 60s, profile, Eigen::Vector3d(500, 500, 0),
+                  Eigen::Vector3d::Zero());
+  db.insert(diagonal);
+
+  db.replace(versions[3],
+             make_row_trajectory("test_map", 35.0, time, 20s, 40.0));
+  db.delay(versions[4], time, 10s);
+  db.erase(versions[5]);
+
+  std::vector<rmf_traffic::schedule::Query> queries;
+  for(std::size_t i=0; i < 10; ++i)
+  {
+    const double y = 10.0*static_cast<double>(i);
+    queries.push_back(make_box_query(
+          time, time + 120s, Eigen::Vector2d(20, y), 2.0));
+    queries.push_back(make_box_query(
+          time + 30s, time + 40s, Eigen::Vector2d(5, y + 5.0), 12.0));
+  }
+  queries.push_back(make_box_query(
+        time, time + 120s, Eigen::Vector2d(20, 50), 1000.0));
+
+  std::vector<std::set<rmf_traffic::schedule::Version>> expected;
+  for(const auto& query : queries)
+    expected.push_back(query_ids(db, query));
+
+  CHECK(expected.front().size() == 1);
+  CHECK(expected.back().size() == 10);
+  CHECK(db.get_spatial_cell_size() == 0.0);
+
+  WHEN("A spatial index is enabled")
+  {
+    for(const double cell_size : {0.5, 3.0, 25.0})
+    {
+      db.set_spatial_cell_size(cell_size);
+      CHECK(db.get_spatial_cell_size() == cell_size);
+
+      for(std::size_t i=0; i < queries.size(); ++i)
+        CHECK(query_ids(db, queries[i]) == expected[i]);
+    }
+
+    THEN("Entries are kept in the index as the database changes")
+    {
+      const auto row_7 = versions[7];
+      const auto moved = db.replace(
+            row_7, make_row_trajectory("test_map", 1000.0, time, 20s, 40.0));
+      CHECK(query_ids(db, queries[14]).count(row_7) == 0);
+      CHECK(query_ids(db, queries[14]).count(moved) == 0);
+      CHECK(query_ids(db, make_box_query(
+              time, time + 120s, Eigen::Vector2d(20, 1000), 2.0)).count(moved));
+
+      db.cull(time + 200s);
+      for(const auto& query : queries)
+        CHECK(query_ids(db, query).empty());
+    }
+
+    THEN("Entries outside of the time window of a region are not inspected")
+    {
+      using Debug = rmf_traffic::schedule::Viewer::Debug;
+      auto query = queries[0];
+      const auto& regions = *query.spacetime().regions();
+      const std::size_t candidates = Debug::count_region_candidates(db, regions);
+
+      // This is in the same cells as row 0, but long after the query window
+      const auto late = db.insert(make_row_trajectory(
+            "test_map", 0.0, time + 10min, 20s, 40.0));
+
+      CHECK(Debug::count_region_candidates(db, regions) == candidates);
+      CHECK(query_ids(db, query) == expected[0]);
+      CHECK(query_ids(db, make_box_query(
+              time + 10min, time + 11min, Eigen::Vector2d(20, 0), 2.0))
+            == std::set<rmf_traffic::schedule::Version>({late}));
+    }
+
+    THEN("Invalid cell sizes are rejected")
+    {
+      CHECK_THROWS_AS(db.set_spatial_cell_size(-1.0), std::invalid_argument);
+    }
+  }
+
+  WHEN("A mirror with a spatial index follows the database")
+  {
+    rmf_traffic::schedule::Mirror mirror;
+    mirror.set_spatial_cell_size(3.0);
+    mirror.update(db.changes(rmf_traffic::schedule::query_everything()));
+
+    THEN("It gives the same query results")
+    {
+      for(std::size_t i=0; i < queries.size(); ++i)
+        CHECK(query_ids(mirror, queries[i]) == expected[i]);
+    }
+
+    THEN("It stays consistent after more changes")
+    {
+      const auto last_version = mirror.latest_version();
+      db.delay(versions[8], time, 5s);
+      db.erase(versions[9]);
+      mirror.update(db.changes(rmf_traffic::schedule::make_query(last_version)));
+
+      for(const auto& query : queries)
+        CHECK(query_ids(mirror, query) == query_ids(db, query));
+    }
+  }
+}
+
+//==============================================================================
+SCENARIO("Patches for mirrors that are catching up")
+{
+  using Mode = rmf_traffic::schedule::Database::Change::Mode;
+
+  const rmf_traffic::Time time = std::chrono::steady_clock::now();
+
+  rmf_traffic::schedule::Database db;
+  std::vector<rmf_traffic::schedule::Version> versions;
+  for(std::size_t i=0; i < 20; ++i)
+  {
+    versions.push_back(db.insert(make_row_trajectory(
+        "test_map", static_cast<double>(i), time, 10s)));
+  }
+  const auto other_map =
+      db.insert(make_row_trajectory("other_map", 0.0, time, 10s));
+
+  rmf_traffic::schedule::Query query =
+      rmf_traffic::schedule::make_query({"test_map"}, nullptr, nullptr);
+  rmf_traffic::schedule::Mirror mirror;
+  mirror.update(db.changes(query));
+  CHECK(query_ids(mirror, rmf_traffic::schedule::query_everything()).size()
+        == 20);
+  CHECK(query_ids(mirror, query) == query_ids(db, query));
+
+  const auto catch_up = [&]()
+  {
+    query.versions().query_after(mirror.latest_version());
+    const auto patch = db.changes(query);
+    mirror.update(patch);
+    return patch;
+  };
+
+  WHEN("A single change is made")
+  {
+    const auto delayed = db.delay(versions[3], time, 5s);
+    const auto patch = catch_up();
+
+    THEN("Only that change is sent")
+    {
+      REQUIRE(patch.size() == 1);
+      CHECK(patch.begin()->id() == delayed);
+      CHECK(patch.begin()->get_mode() == Mode::Delay);
+      CHECK(query_ids(mirror, query) == query_ids(db, query));
+    }
+  }
+
+  WHEN("A trajectory is changed several times")
+  {
+    const auto v1 = db.replace(
+          versions[4], make_row_trajectory("test_map", 40.0, time, 10s));
+    const auto v2 = db.delay(v1, time, 2s);
+    db.insert(make_row_trajectory("other_map", 1.0, time, 10s));
+    const auto patch = catch_up();
+
+    THEN("The whole chain is sent, but not changes on other maps")
+    {
+      REQUIRE(patch.size() == 2);
+      CHECK(patch.begin()->id() == v1);
+      CHECK((++patch.begin())->id() == v2);
+      CHECK(query_ids(mirror, query) == query_ids(db, query));
+    }
+  }
+
+  WHEN("A trajectory is erased")
+  {
+    const auto erased = db.erase(versions[5]);
+    db.erase(other_map);
+    const auto patch = catch_up();
+
+    THEN("The mirror is told to erase it")
+    {
+      REQUIRE(patch.size() == 1);
+      CHECK(patch.begin()->id() == erased);
+      CHECK(patch.begin()->get_mode() == Mode::Erase);
+      CHECK(query_ids(mirror, query).count(versions[5]) == 0);
+      CHECK(query_ids(mirror, query) == query_ids(db, query));
+    }
+  }
+
+  WHEN("The schedule gets culled")
+  {
+    db.cull(time + 20s);
+    const auto inserted =
+        db.insert(make_row_trajectory("test_map", 0.0, time, 10s));
+    const auto patch = catch_up();
+
+    THEN("The cull is sent along with the newer changes")
+    {
+      REQUIRE(patch.size() == 2);
+      CHECK(patch.begin()->get_mode() == Mode::Cull);
+      CHECK((++patch.begin())->id() == inserted);
+      CHECK(query_ids(mirror, query) == query_ids(db, query));
+    }
+  }
+
+  WHEN("A cull happens before any trajectory has finished")
+  {
+    const auto version = db.latest_version();
+    CHECK(db.cull(time) == version);
+    const auto patch = catch_up();
+
+    THEN("Nothing changes and nothing is sent")
+    {
+      CHECK(db.latest_version() == version);
+      CHECK(patch.size() == 0);
+      CHECK(query_ids(mirror, query) == query_ids(db, query));
+    }
+  }
+
+  WHEN("The mirror is already up to date")
+  {
+    const auto patch = catch_up();
+
+    THEN("Nothing is sent")
+    {
+      CHECK(patch.size() == 0);
+    }
+  }
+}
+
+//==============================================================================
+SCENARIO("Schedule entries are looked up by version")
+{
+  const rmf_traffic::Time time = std::chrono::steady_clock::now();
+
+  rmf_traffic::schedule::Database db;
+  std::vector<rmf_traffic::schedule::Version> versions;
+  for(std::size_t i=0; i < 10; ++i)
+  {
+    versions.push_back(db.insert(make_row_trajectory(
+        "test_map", static_cast<double>(i),
+        time + std::chrono::seconds(10*i), 10s)));
+  }
+  CHECK_TRAJECTORY_COUNT(db, 10);
+
+  WHEN("Entries in the middle are erased")
+  {
+    db.erase(versions[4]);
+    db.erase(versions[5]);
+    CHECK_TRAJECTORY_COUNT(db, 8);
+
+    THEN("Versions that were never issued cannot be changed")
+    {
+      CHECK_THROWS_AS(
+            db.delay(db.latest_version() + 1, time, 1s), std::runtime_error);
+      CHECK_NOTHROW(db.delay(versions[6], time, 1s));
+      CHECK_TRAJECTORY_COUNT(db, 8);
+    }
+  }
+
+  WHEN("The oldest entries are culled")
+  {
+    db.cull(time + 35s);
+    CHECK_TRAJECTORY_COUNT(db, 7);
+    CHECK(db.oldest_version() == versions[3]);
+
+    THEN("Only the remaining versions can be changed")
+    {
+      CHECK_THROWS_AS(db.delay(versions[0], time, 1s), std::runtime_error);
+      CHECK_NOTHROW(db.delay(versions[3], time, 1s));
+    }
+  }
+
+  WHEN("A mirror receives versions out of order")
+  {
+    // The first patch only has the newer half of the schedule, and then the
+    // whole schedule gets sent, so the older versions arrive afterwards.
+    const rmf_traffic::Time lower = time + 55s;
+    rmf_traffic::schedule::Mirror mirror;
+    mirror.update(db.changes(
+        rmf_traffic::schedule::make_query({"test_map"}, &lower, nullptr)));
+    const auto partial = query_ids(
+          mirror, rmf_traffic::schedule::query_everything());
+    CHECK(partial.size() == 5);
+    CHECK(partial.count(versions[0]) == 0);
+
+    mirror.update(db.changes(rmf_traffic::schedule::query_everything()));
+
+    THEN("The mirror has every version")
+    {
+      const auto all = rmf_traffic::schedule::query_everything();
+      CHECK(query_ids(mirror, all) == query_ids(db, all));
+
+      const auto v = db.replace(
+            versions[0], make_row_trajectory("test_map", 0.5, time, 10s));
+      mirror.update(db.changes(rmf_traffic::schedule::make_query(v - 1)));
+      CHECK(query_ids(mirror, all) == query_ids(db, all));
+    }
+  }
+}
+
+//==============================================================================
+SCENARIO("Trajectories that are delayed many times")
+{
+  const rmf_traffic::Time time = std::chrono::steady_clock::now();
+  rmf_traffic::schedule::Database db;
+  std::vector<rmf_traffic::schedule::Version> versions;
+  for(std::size_t i=0; i < 5; ++i)
+  {
+    versions.push_back(db.insert(make_row_trajectory(
+        "test_map", static_cast<double>(i), time)));
+  }
+
+  rmf_traffic::schedule::Mirror mirror;
+  mirror.update(db.changes(rmf_traffic::schedule::query_everything()));
+
+  // Each delay pushes the trajectories into the next time bucket
+  for(std::size_t d=0; d < 10; ++d)
+  {
+    for(auto& v : versions)
+      v = db.delay(v, time, 40s);
+  }
+  db.erase(versions.back());
+  versions.pop_back();
+
+  mirror.update(db.changes(rmf_traffic::schedule::make_query(5)));
+
+  const auto finish_times = [](const rmf_traffic::schedule::Viewer& viewer,
+      const rmf_traffic::Time* lower, const rmf_traffic::Time* upper)
+  {
+    std::vector<rmf_traffic::Time> times;
+    for(const auto& element : viewer.query(
+          rmf_traffic::schedule::make_query({"test_map"}, lower, upper)))
+      times.push_back(*element.trajectory.finish_time());
+
+    return times;
+  };
+
+  THEN("Only the latest versions are found by queries")
+  {
+    // A delay from the start time shifts the whole trajectory, so nothing is
+    // left at the original times.
+    const rmf_traffic::Time before = time + 60s;
+    CHECK(finish_times(db, nullptr, &before).empty());
+    CHECK(finish_times(mirror, nullptr, &before).empty());
+
+    const rmf_traffic::Time lower = time + 90s + 399s;
+    const rmf_traffic::Time upper = time + 90s + 401s;
+    for(const auto* viewer : std::vector<const rmf_traffic::schedule::Viewer*>{
+        &db, &mirror})
+    {
+      const auto times = finish_times(*viewer, &lower, &upper);
+      CHECK(times.size() == 4);
+      for(const auto t : times)
+        CHECK(t == time + 90s + 400s);
+    }
+
+    const rmf_traffic::Time after = time + 90s + 401s;
+    CHECK(finish_times(db, &after, nullptr).empty());
+    CHECK(finish_times(mirror, &after, nullptr).empty());
+  }
+
+  THEN("Culling removes every version of the trajectories")
+  {
+    CHECK(rmf_traffic::schedule::Viewer::Debug::get_num_entries(db) == 56);
+    db.cull(time + 1h);
+    CHECK(rmf_traffic::schedule::Viewer::Debug::get_num_entries(db) == 0);
+
+    mirror.update(db.changes(
+        rmf_traffic::schedule::make_query(db.latest_version() - 1)));
+    CHECK(rmf_traffic::schedule::Viewer::Debug::get_num_entries(mirror) == 0);
+  }
+}
+
+//==============================================================================
+SCENARIO("Delayed versions share the segments that were not delayed")
+{
+  using Debug = rmf_traffic::schedule::Viewer::Debug;
+  using rmf_traffic::Trajectory;
+
+  const rmf_traffic::Time time = std::chrono::steady_clock::now();
+  const auto profile = make_schedule_test_profile();
+
+  // One segment finishes every 10s from the start time
+  Trajectory trajectory("test_map");
+  for(std::size_t i=0; i < 10; ++i)
+  {
+    trajectory.insert(
+          time + std::chrono::seconds(10*i), profile,
+          Eigen::Vector3d(static_cast<double>(i), 0.0, 0.0),
+          Eigen::Vector3d::Zero());
+  }
+
+  rmf_traffic::schedule::Database db;
+  const auto v1 = db.insert(trajectory);
+
+  const auto check_delayed = [&](
+      const Trajectory& original,
+      const Trajectory& delayed,
+      const std::size_t first_delayed,
+      const rmf_traffic::Duration delay)
+  {
+    REQUIRE(delayed.size() == original.size());
+    auto it = original.begin();
+    auto delayed_it = delayed.begin();
+    for(std::size_t i=0; i < original.size(); ++i, ++it, ++delayed_it)
+    {
+      const auto expected = i < first_delayed?
+            it->get_finish_time() : it->get_finish_time() + delay;
+      CHECK(delayed_it->get_finish_time() == expected);
+      CHECK(delayed_it->get_finish_position() == it->get_finish_position());
+    }
+
+    CHECK(Trajectory::Debug::check_iterator_time_consistency(delayed, true));
+  };
+
+  WHEN("A version is delayed from the middle of its trajectory")
+  {
+    // The delay applies from the segment before the one that contains the
+    // from-time, so segments 4 onwards get delayed.
+    const auto v2 = db.delay(v1, time + 45s, 5s);
+
+    const Trajectory* const t1 = Debug::get_trajectory(db, v1);
+    const Trajectory* const t2 = Debug::get_trajectory(db, v2);
+    REQUIRE(t1);
+    REQUIRE(t2);
+
+    THEN("The segments before the delay share storage with the old version")
+    {
+      check_delayed(*t1, *t2, 4, 5s);
+      CHECK(Trajectory::Debug::count_shared_segments(*t1, *t2) == 4);
+    }
+
+    THEN("Changing a copy of the new version does not change the others")
+    {
+      Trajectory copy = *t2;
+      copy.begin()->set_finish_position(Eigen::Vector3d(-1.0, 0.0, 0.0));
+      CHECK(t1->begin()->get_finish_position() == Eigen::Vector3d::Zero());
+      CHECK(t2->begin()->get_finish_position() == Eigen::Vector3d::Zero());
+      CHECK(Trajectory::Debug::count_shared_segments(*t2, copy) == 0);
+      check_delayed(trajectory, *t1, 10, 0s);
+      check_delayed(*t1, *t2, 4, 5s);
+    }
+
+    THEN("Delaying it again keeps sharing the earliest segments")
+    {
+      const auto v3 = db.delay(v2, time + 85s, 5s);
+      const Trajectory* const t3 = Debug::get_trajectory(db, v3);
+      REQUIRE(t3);
+      check_delayed(*t2, *t3, 7, 5s);
+      CHECK(Trajectory::Debug::count_shared_segments(*t1, *t3) == 4);
+    }
+  }
+
+  WHEN("A version is delayed in a batch")
+  {
+    rmf_traffic::schedule::Database::Batch batch;
+    batch.delay(v1, time + 45s, 5s);
+    const auto v2 = db.apply(std::move(batch));
+
+    const Trajectory* const t1 = Debug::get_trajectory(db, v1);
+    const Trajectory* const t2 = Debug::get_trajectory(db, v2);
+    REQUIRE(t1);
+    REQUIRE(t2);
+
+    THEN("The segments before the delay share storage with the old version")
+    {
+      check_delayed(*t1, *t2, 4, 5s);
+      CHECK(Trajectory::Debug::count_shared_segments(*t1, *t2) == 4);
+    }
+  }
+}
+
+SCENARIO("Change history is compacted for mirrors that keep up")
+{
+  const rmf_traffic::Time time = std::chrono::steady_clock::now();
+
+  const std::size_t interval = 10;
+  rmf_traffic::schedule::Database db;
+  db.set_compaction_interval(interval);
+
+  std::vector<rmf_traffic::schedule::Version> versions;
+  for(std::size_t i=0; i < 4; ++i)
+    versions.push_back(db.insert(make_row_trajectory(
+        "test_map", static_cast<double>(i), time, 10s)));
+
+  const auto everything = rmf_traffic::schedule::query_everything();
+  rmf_traffic::schedule::Mirror mirror;
+  mirror.update(db.changes(everything));
+
+  const auto catch_up = [&]()
+  {
+    mirror.update(db.changes(
+        rmf_traffic::schedule::make_query(mirror.latest_version())));
+    db.set_oldest_needed_version(mirror.latest_version());
+  };
+
+  for(std::size_t d=0; d < 50; ++d)
+  {
+    for(auto& v : versions)
+      v = db.delay(v, time, 1s);
+
+    catch_up();
+  }
+
+  using Debug = rmf_traffic::schedule::Viewer::Debug;
+  const std::size_t bound = versions.size() + interval + versions.size();
+
+  THEN("Only the recent history is kept")
+  {
+    CHECK(Debug::get_num_entries(db) <= bound);
+    CHECK(query_ids(mirror, everything) == query_ids(db, everything));
+    for(const auto& element : db.query(everything))
+      CHECK(*element.trajectory.finish_time() == time + 10s + 50s);
+  }
+
+  WHEN("A trajectory is erased")
+  {
+    db.erase(versions.back());
+    versions.pop_back();
+    catch_up();
+
+    for(std::size_t d=0; d < 10; ++d)
+    {
+      for(auto& v : versions)
+        v = db.delay(v, time, 1s);
+
+      catch_up();
+    }
+
+    THEN("The erasure is eventually discarded too")
+    {
+      CHECK(query_ids(mirror, everything) == query_ids(db, everything));
+      CHECK(query_ids(db, everything).size() == 3);
+      CHECK(Debug::get_num_entries(db) <= bound);
+    }
+  }
+
+  WHEN("A new mirror joins")
+  {
+    rmf_traffic::schedule::Mirror new_mirror;
+    new_mirror.update(db.changes(rmf_traffic::schedule::make_query(0)));
+
+    THEN("It receives the latest version of every trajectory")
+    {
+      CHECK(query_ids(new_mirror, everything) == query_ids(db, everything));
+      CHECK(query_ids(new_mirror, everything).size() == 4);
+    }
+  }
+
+  WHEN("A trajectory gets a very long history before it is culled")
+  {
+    rmf_traffic::schedule::Database long_db;
+    rmf_traffic::schedule::Version v =
+        long_db.insert(make_row_trajectory("test_map", 0.0, time, 10s));
+    for(std::size_t d=0; d < 100000; ++d)
+      v = long_db.delay(v, time, 1ms);
+
+    THEN("The history can be culled without running out of stack")
+    {
+      CHECK(Debug::get_num_entries(long_db) == 100001);
+      long_db.cull(time + 1h);
+      CHECK(Debug::get_num_entries(long_db) == 0);
+    }
+
+    THEN("The database can be destroyed without running out of stack")
+    {
+      CHECK(Debug::get_num_entries(long_db) == 100001);
+    }
+  }
+}
+
+SCENARIO("Batches of changes")
+{
+  const rmf_traffic::Time time = std::chrono::steady_clock::now();
+  const auto profile = make_schedule_test_profile();
+
+  // One database gets each change separately while the other gets them all
+  // in batches, and they should end up the same.
+  rmf_traffic::schedule::Database separate;
+  rmf_traffic::schedule::Database batched;
+  for(auto* db : {&separate, &batched})
+  {
+    for(std::size_t i=0; i < 6; ++i)
+      db->insert(make_row_trajectory("test_map", static_cast<double>(i), time));
+  }
+
+  const auto everything = rmf_traffic::schedule::query_everything();
+  rmf_traffic::schedule::Mirror mirror;
+  mirror.update(batched.changes(everything));
+
+  const auto finish_times = [&](const rmf_traffic::schedule::Viewer& viewer)
+  {
+    std::map<rmf_traffic::schedule::Version, rmf_traffic::Time> times;
+    for(const auto& element : viewer.query(everything))
+    {
+      // Erasures show up with empty trajectories, so we skip those
+      if(element.trajectory.finish_time())
+        times[element.id] = *element.trajectory.finish_time();
+    }
+
+    return times;
+  };
+
+  WHEN("A fleet of trajectories gets delayed several times")
+  {
+    rmf_traffic::schedule::Database::Batch batch;
+    for(std::size_t d=0; d < 3; ++d)
+    {
+      for(rmf_traffic::schedule::Version v=1; v <= 6; ++v)
+      {
+        const auto id = v + 6*d;
+        separate.delay(id, time, 40s);
+        batch.delay(id, time, 40s);
+      }
+    }
+
+    CHECK(batch.size() == 18);
+    const auto version = batched.apply(std::move(batch));
+    mirror.update(batched.changes(
+          rmf_traffic::schedule::make_query(mirror.latest_version())));
+
+    THEN("The result matches making the changes one at a time")
+    {
+      CHECK(version == separate.latest_version());
+      CHECK(finish_times(batched) == finish_times(separate));
+      CHECK(finish_times(mirror) == finish_times(separate));
+      CHECK(finish_times(batched).size() == 6);
+
+      const rmf_traffic::Time before = time + 119s;
+      CHECK(batched.query(rmf_traffic::schedule::make_query(
+              {"test_map"}, nullptr, &before)).size() == 0);
+    }
+  }
+
+  WHEN("A batch mixes every kind of change")
+  {
+    rmf_traffic::Trajectory interruption("test_map");
+    interruption.insert(time + 10s, profile, Eigen::Vector3d(1, 0, 0),
+                        Eigen::Vector3d::Zero());
+    interruption.insert(time + 20s, profile, Eigen::Vector3d(1, 0, 0),
+                        Eigen::Vector3d::Zero());
+
+    separate.insert(make_row_trajectory("other_map", 0.0, time));
+    separate.delay(7, time, 5s);
+    separate.interrupt(1, interruption, 2s);
+    separate.replace(2, make_row_trajectory("other_map", 2.0, time));
+    separate.erase(3);
+    separate.erase(9);
+
+    rmf_traffic::schedule::Database::Batch batch;
+    batch.insert(make_row_trajectory("other_map", 0.0, time))
+        .delay(7, time, 5s)
+        .interrupt(1, interruption, 2s)
+        .replace(2, make_row_trajectory("other_map", 2.0, time))
+        .erase(3)
+        .erase(9);
+
+    batched.apply(std::move(batch));
+    mirror.update(batched.changes(
+          rmf_traffic::schedule::make_query(mirror.latest_version())));
+
+    THEN("The result matches making the changes one at a time")
+    {
+      CHECK(batched.latest_version() == separate.latest_version());
+      CHECK(finish_times(batched) == finish_times(separate));
+      CHECK(finish_times(mirror) == finish_times(separate));
+      CHECK(query_ids(batched, rmf_traffic::schedule::make_query(
+                        {"other_map"}, nullptr, nullptr)).size() == 2);
+    }
+  }
+
+  WHEN("A batch refers to a version that does not exist")
+  {
+    const auto version = batched.latest_version();
+    const auto entries =
+        rmf_traffic::schedule::Viewer::Debug::get_num_entries(batched);
+
+    rmf_traffic::schedule::Database::Batch batch;
+    batch.delay(1, time, 5s).erase(2).delay(100, time, 5s);
+    CHECK_THROWS(batched.apply(std::move(batch)));
+
+    THEN("Nothing is changed")
+    {
+      CHECK(batched.latest_version() == version);
+      CHECK(rmf_traffic::schedule::Viewer::Debug::get_num_entries(batched)
+            == entries);
+      CHECK(finish_times(batched) == finish_times(separate));
+    }
+  }
+}
+
+namespace {
+
+//==============================================================================
+std::map<rmf_traffic::schedule::Version, rmf_traffic::Time> snapshot_finishes(
+    const rmf_traffic::schedule::Database::Snapshot& snapshot,
+    const rmf_traffic::schedule::Query& query)
+{
+  std::map<rmf_traffic::schedule::Version, rmf_traffic::Time> times;
+  for(const auto& element : snapshot.query(query))
+    times[element.id] = *element.trajectory.finish_time();
+
+  return times;
+}
+
+//==============================================================================
+std::map<rmf_traffic::schedule::Version, rmf_traffic::Time> viewer_finishes(
+    const rmf_traffic::schedule::Viewer& viewer,
+    const rmf_traffic::schedule::Query& query)
+{
+  std::map<rmf_traffic::schedule::Version, rmf_traffic::Time> times;
+  for(const auto& element : viewer.query(query))
+  {
+    // Erasures show up with empty trajectories, so we skip those
+    if(element.trajectory.finish_time())
+      times[element.id] = *element.trajectory.finish_time();
+  }
+
+  return times;
+}
+
+} // anonymous namespace
+
+//==============================================================================
+SCENARIO("Snapshots of the schedule")
+{
+  const rmf_traffic::Time time = std::chrono::steady_clock::now();
+
+  rmf_traffic::schedule::Database db;
+  for(std::size_t i=0; i < 5; ++i)
+  {
+    db.insert(make_row_trajectory(
+                "test_map", static_cast<double>(i), time + i*30s, 60s));
+  }
+  db.insert(make_row_trajectory("other_map", 0.0, time, 60s));
+
+  const auto everything = rmf_traffic::schedule::query_everything();
+  const rmf_traffic::Time lower = time + 70s;
+  const rmf_traffic::Time upper = time + 100s;
+  const auto timespan = rmf_traffic::schedule::make_query(
+        {"test_map"}, &lower, &upper);
+  const auto box = make_box_query(time, time + 200s, {5.0, 1.0}, 1.5);
+
+  rmf_utils::optional<rmf_traffic::schedule::Database::Snapshot> snapshot =
+      db.snapshot();
+  CHECK(snapshot->latest_version() == db.latest_version());
+
+  const auto original_everything = viewer_finishes(db, everything);
+  const auto original_timespan = viewer_finishes(db, timespan);
+  const auto original_box = viewer_finishes(db, box);
+  CHECK(original_everything.size() == 6);
+  CHECK(original_timespan.size() == 3);
+  CHECK(original_box.size() == 3);
+
+  CHECK(snapshot_finishes(*snapshot, everything) == original_everything);
+  CHECK(snapshot_finishes(*snapshot, timespan) == original_timespan);
+  CHECK(snapshot_finishes(*snapshot, box) == original_box);
+
+  // A snapshot taken while nothing has changed shares the same data
+  const auto same = db.snapshot();
+  CHECK(&snapshot->query(everything).begin()->trajectory
+        == &same.query(everything).begin()->trajectory);
+
+  WHEN("The schedule changes after the snapshot is taken")
+  {
+    db.delay(2, time, 100s);
+    db.erase(3);
+    db.insert(make_row_trajectory("test_map", 2.0, time + 80s, 60s));
+    db.replace(6, make_row_trajectory("other_map", 5.0, time + 30s, 60s));
+
+    THEN("The snapshot still has the original schedule")
+    {
+      CHECK(snapshot->latest_version() == 6);
+      CHECK(snapshot_finishes(*snapshot, everything) == original_everything);
+      CHECK(snapshot_finishes(*snapshot, timespan) == original_timespan);
+      CHECK(snapshot_finishes(*snapshot, box) == original_box);
+    }
+
+    THEN("A new snapshot matches the current schedule")
+    {
+      const auto latest = db.snapshot();
+      CHECK(latest.latest_version() == db.latest_version());
+      CHECK(snapshot_finishes(latest, everything)
+            == viewer_finishes(db, everything));
+      CHECK(snapshot_finishes(latest, timespan)
+            == viewer_finishes(db, timespan));
+      CHECK(snapshot_finishes(latest, box) == viewer_finishes(db, box));
+      CHECK(snapshot_finishes(latest, everything).count(3) == 0);
+
+      const auto newer = snapshot_finishes(
+            latest, rmf_traffic::schedule::make_query(6));
+      CHECK(newer.size() == 3);
+      CHECK(newer.count(7) == 1);
+      CHECK(newer.count(9) == 1);
+      CHECK(newer.count(10) == 1);
+    }
+  }
+
+  WHEN("A snapshot is taken of only one map")
+  {
+    const auto other_map = db.snapshot({"other_map"});
+    const auto other_everything = snapshot_finishes(other_map, everything);
+    CHECK(other_everything.size() == 1);
+    CHECK(other_everything.count(6) == 1);
+    CHECK(snapshot_finishes(other_map, timespan).empty());
+
+    THEN("Changes to other maps do not affect it")
+    {
+      db.delay(1, time, 10s);
+      db.insert(make_row_trajectory("test_map", 3.0, time, 60s));
+
+      const auto next = db.snapshot({"other_map", "missing_map"});
+      CHECK(next.latest_version() == db.latest_version());
+      CHECK(snapshot_finishes(next, everything) == other_everything);
+      CHECK(&next.query(everything).begin()->trajectory
+            == &other_map.query(everything).begin()->trajectory);
+    }
+  }
+
+  WHEN("The schedule gets culled while a view of the snapshot exists")
+  {
+    const auto view = snapshot->query(everything);
+    snapshot = rmf_utils::nullopt;
+
+    db.cull(time + 1000s);
+    CHECK(db.query(everything).size() == 0);
+    CHECK(db.snapshot().query(everything).size() == 0);
+
+    THEN("The view is still valid")
+    {
+      std::map<rmf_traffic::schedule::Version, rmf_traffic::Time> times;
+      for(const auto& element : view)
+        times[element.id] = *element.trajectory.finish_time();
+
+      CHECK(times == original_everything);
+    }
+  }
+}
+
+//==============================================================================
+SCENARIO("Queries keep track of visited entries by slot")
+{
+  using Debug = rmf_traffic::schedule::Viewer::Debug;
+  const rmf_traffic::Time time = std::chrono::steady_clock::now();
+
+  // Each trajectory lasts for several time buckets, so every query needs to
+  // skip the entries that it has already visited.
+  rmf_traffic::schedule::Database db;
+  std::vector<rmf_traffic::schedule::Version> versions;
+  for(std::size_t i=0; i < 10; ++i)
+  {
+    versions.push_back(db.insert(make_row_trajectory(
+        "test_map", static_cast<double>(i), time + (i < 5? 0s : 10min), 3min)));
+  }
+
+  const auto timespan =
+      rmf_traffic::schedule::make_query({"test_map"}, nullptr, nullptr);
+
+  rmf_traffic::schedule::Mirror mirror;
+  mirror.update(db.changes(rmf_traffic::schedule::query_everything()));
+  CHECK(query_ids(mirror, timespan) == query_ids(db, timespan));
+
+  const std::size_t capacity = Debug::get_slot_capacity(db);
+  const std::size_t mirror_capacity = Debug::get_slot_capacity(mirror);
+  CHECK(capacity == 10);
+  CHECK(mirror_capacity == 10);
+
+  WHEN("Slots are freed by a cull")
+  {
+    db.cull(time + 5min);
+
+    std::set<rmf_traffic::schedule::Version> expected(
+          versions.begin() + 5, versions.end());
+    for(std::size_t i=0; i < 5; ++i)
+    {
+      expected.insert(db.insert(make_row_trajectory(
+          "test_map", 20.0 + static_cast<double>(i), time + 10min, 3min)));
+    }
+
+    THEN("New entries reuse them")
+    {
+      CHECK(Debug::get_slot_capacity(db) == capacity);
+      CHECK(query_ids(db, timespan) == expected);
+      CHECK(db.query(timespan).size() == expected.size());
+    }
+  }
+
+  WHEN("Slots are freed by erasures in a mirror")
+  {
+    const auto last_version = mirror.latest_version();
+    for(const std::size_t i : {1, 3, 7})
+      db.erase(versions[i]);
+
+    for(std::size_t i=0; i < 3; ++i)
+    {
+      db.insert(make_row_trajectory(
+          "test_map", 20.0 + static_cast<double>(i), time, 3min));
+    }
+
+    mirror.update(db.changes(rmf_traffic::schedule::make_query(last_version)));
+
+    THEN("New entries reuse them")
+    {
+      CHECK(Debug::get_slot_capacity(mirror) == mirror_capacity);
+      CHECK(query_ids(mirror, timespan) == query_ids(db, timespan));
+      CHECK(mirror.query(timespan).size() == 10);
+    }
+  }
+
+  rmf_traffic::schedule::Database small_db;
+  for(std::size_t i=0; i < 2; ++i)
+  {
+    small_db.insert(make_row_trajectory(
+        "test_map", static_cast<double>(i), time, 3min));
+  }
+
+  // The visit stamps are thread-local, so each of these runs in a new thread
+  // to start from a clean set of stamps. Catch assertions are not thread-safe,
+  // so the results are only checked after the thread has finished.
+  WHEN("The visit epoch wraps around")
+  {
+    std::vector<std::size_t> sizes;
+    std::thread thread([&]()
+    {
+      // Every slot of db gets stamped with the first epoch
+      sizes.push_back(db.query(timespan).size());
+
+      // Only the first slots get stamped while the epoch wraps around
+      Debug::set_visit_epoch(std::numeric_limits<uint64_t>::max() - 1);
+      sizes.push_back(small_db.query(timespan).size());
+      sizes.push_back(small_db.query(timespan).size());
+
+      sizes.push_back(db.query(timespan).size());
+      sizes.push_back(db.query(timespan).size());
+    });
+    thread.join();
+
+    THEN("Stamps from before the wraparound are not mistaken for visits")
+    {
+      CHECK(sizes == std::vector<std::size_t>({10, 2, 2, 10, 10}));
+    }
+  }
+
+  WHEN("The number of slots grows between queries on one thread")
+  {
+    std::vector<std::size_t> sizes;
+    std::vector<std::size_t> stamp_counts;
+    std::thread thread([&]()
+    {
+      sizes.push_back(small_db.query(timespan).size());
+      stamp_counts.push_back(Debug::get_visit_stamp_count());
+
+      sizes.push_back(db.query(timespan).size());
+      stamp_counts.push_back(Debug::get_visit_stamp_count());
+
+      for(std::size_t i=0; i < 10; ++i)
+      {
+        db.insert(make_row_trajectory(
+            "test_map", 20.0 + static_cast<double>(i), time, 3min));
+      }
+
+      sizes.push_back(db.query(timespan).size());
+      stamp_counts.push_back(Debug::get_visit_stamp_count());
+
+      // The stamps do not shrink back down for a smaller schedule
+      sizes.push_back(small_db.query(timespan).size());
+      stamp_counts.push_back(Debug::get_visit_stamp_count());
+    });
+    thread.join();
+
+    THEN("The stamps grow to fit the slots of each query")
+    {
+      CHECK(sizes == std::vector<std::size_t>({2, 10, 20, 2}));
+      CHECK(stamp_counts == std::vector<std::size_t>({2, 10, 20, 20}));
+    }
+  }
+}
@@ -16,6 +16,7 @@
 */
 
 #include "utils_Database.hpp"
+#include "../utils_Trajectory.hpp"
 #include <rmf_traffic/schedule/Database.hpp>
 #include <rmf_traffic/geometry/Box.hpp>
 
@@ -431,3 +432,105 @@ COMMENTED DUE TO NON-DETERMINISTIC BEHAVIOR OF FCL
 
 
 }
+
+//==============================================================================
+SCENARIO("Mirrors that receive many updates to crowded buckets")
+{
+  const rmf_traffic::Time time = std::chrono::steady_clock::now();
+  // Every trajectory spans several time buckets, and they all overlap
+  rmf_traffic::schedule::Database db;
+  std::vector<rmf_traffic::schedule::Version> versions;
+  for(std::size_t i=0; i < 30; ++i)
+  {
+    versions.push_back(db.insert(make_row_trajectory(
+        "test_map", static_cast<double>(i),
+        time + std::chrono::seconds(10*i), 5min)));
+  }
+
+  rmf_traffic::schedule::Mirror mirror;
+  mirror.update(db.changes(rmf_traffic::schedule::query_everything()));
+
+  const auto count_in = [](
+      const rmf_traffic::schedule::Viewer& viewer,
+      const std::string& map,
+      const rmf_traffic::Time* lower,
+      const rmf_traffic::Time* upper) -> std::size_t
+  {
+    return viewer.query(
+          rmf_traffic::schedule::make_query({map}, lower, upper)).size();
+  };
+
+  const auto check_consistent = [&]()
+  {
+    for(int minute = -2; minute < 15; ++minute)
+    {
+      const rmf_traffic::Time lower = time + std::chrono::minutes(minute);
+      const rmf_traffic::Time upper = lower + 30s;
+      for(const std::string map : {"test_map", "other_map"})
+      {
+        CHECK(count_in(mirror, map, &lower, &upper)
+              == count_in(db, map, &lower, &upper));
+      }
+    }
+  };
+
+  WHEN("Trajectories are delayed and erased repeatedly")
+  {
+    for(std::size_t round=0; round < 5; ++round)
+    {
+      const auto last_version = mirror.latest_version();
+      for(std::size_t i=round; i < versions.size(); i += 3)
+        versions[i] = db.delay(versions[i], time, 50s);
+
+      for(std::size_t i=round; i < versions.size(); i += 7)
+      {
+        if(versions[i] == 0)
+          continue;
+
+        db.erase(versions[i]);
+        versions[i] = 0;
+      }
+
+      // Keep the erased trajectories out of the next round of delays
+      std::vector<rmf_traffic::schedule::Version> remaining;
+      for(const auto v : versions)
+      {
+        if(v != 0)
+          remaining.push_back(v);
+      }
+      versions = remaining;
+
+      mirror.update(db.changes(
+          rmf_traffic::schedule::make_query(last_version)));
+      check_consistent();
+    }
+
+    CHECK(mirror.query(rmf_traffic::schedule::query_everything()).size()
+          == versions.size());
+  }
+
+  WHEN("A replacement moves a trajectory to another map")
+  {
+    const auto last_version = mirror.latest_version();
+    db.replace(versions[10],
+               make_row_trajectory("other_map", 0.0, time, 5min));
+    mirror.update(db.changes(
+        rmf_traffic::schedule::make_query(last_version)));
+
+    CHECK(count_in(mirror, "other_map", nullptr, nullptr) == 1);
+    CHECK(count_in(mirror, "test_map", nullptr, nullptr) == 29);
+    check_consistent();
+  }
+
+  WHEN("The schedule is culled in the middle of the trajectories")
+  {
+    const auto last_version = mirror.latest_version();
+    db.cull(time + 5min + 2min);
+    for(std::size_t i=20; i < versions.size(); ++i)
+      db.delay(versions[i], time, 10s);
+
+    mirror.update(db.changes(
+        rmf_traffic::schedule::make_query(last_version)));
+    check_consistent();
+  }
+}
@@ -0,0 +1,379 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include "../utils_Trajectory.hpp"
+#include <rmf_traffic/schedule/ShardedDatabase.hpp>
+#include <rmf_traffic/schedule/Mirror.hpp>
+#include <rmf_traffic/geometry/Box.hpp>
+
+#include <rmf_utils/catch.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <set>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+using Finishes = std::map<rmf_traffic::schedule::Version, rmf_traffic::Time>;
+
+//==============================================================================
+Finishes view_finishes(const rmf_traffic::schedule::Viewer::View& view)
+{
+  Finishes times;
+  for(const auto& element : view)
+  {
+    // Erasures show up with empty trajectories, so we skip those
+    if(element.trajectory.finish_time())
+      times[element.id] = *element.trajectory.finish_time();
+  }
+
+  return times;
+}
+
+//==============================================================================
+rmf_traffic::Region make_box_region(
+    const std::string& map,
+    const rmf_traffic::Time start,
+    const rmf_traffic::Time finish,
+    const Eigen::Vector2d& center,
+    const double size)
+{
+  Eigen::Isometry2d tf = Eigen::Isometry2d::Identity();
+  tf.translate(center);
+
+  rmf_traffic::Region region{map, start, finish, {}};
+  region.push_back(rmf_traffic::geometry::Space{
+      rmf_traffic::geometry::make_final_convex<
+        rmf_traffic::geometry::Box>(size, size), tf});
+
+  return region;
+}
+
+} // anonymous namespace
+
+//==============================================================================
+SCENARIO("Sharded databases match a single database")
+{
+  const rmf_traffic::Time time = std::chrono::steady_clock::now();
+
+  // Both databases get the same changes, one after another, so they should
+  // hand out the same versions and end up with the same trajectories.
+  rmf_traffic::schedule::Database db;
+  rmf_traffic::schedule::ShardedDatabase sharded;
+  for(const std::string map : {"map_A", "map_B"})
+  {
+    for(std::size_t i=0; i < 4; ++i)
+    {
+      const auto trajectory =
+          make_row_trajectory(map, static_cast<double>(i), time);
+      CHECK(sharded.insert(trajectory) == db.insert(trajectory));
+    }
+  }
+
+  const auto everything = rmf_traffic::schedule::query_everything();
+  rmf_traffic::schedule::Mirror mirror;
+  mirror.update(sharded.changes(everything));
+  CHECK(mirror.latest_version() == 8);
+  CHECK(view_finishes(mirror.query(everything))
+        == view_finishes(db.query(everything)));
+
+  const auto check_match = [&]()
+  {
+    CHECK(sharded.latest_version() == db.latest_version());
+    CHECK(sharded.snapshot().latest_version() == db.latest_version());
+
+    const auto expected = view_finishes(db.query(everything));
+    CHECK(view_finishes(sharded.query(everything)) == expected);
+    CHECK(view_finishes(sharded.snapshot().query(everything)) == expected);
+
+    // A mirror that gets updated from the last version it knows about and
+    // a mirror that gets rebuilt from scratch should both match
+    const auto last_version = mirror.latest_version();
+    mirror.update(sharded.changes(
+          rmf_traffic::schedule::make_query(last_version)));
+    CHECK(mirror.latest_version() == db.latest_version());
+    CHECK(view_finishes(mirror.query(everything)) == expected);
+
+    rmf_traffic::schedule::Mirror fresh;
+    fresh.update(sharded.changes(everything));
+    CHECK(view_finishes(fresh.query(everything)) == expected);
+
+    const auto map_A = rmf_traffic::schedule::make_query(
+          {"map_A"}, nullptr, nullptr);
+    CHECK(view_finishes(sharded.query(map_A))
+          == view_finishes(db.query(map_A)));
+  };
+
+  WHEN("Trajectories are delayed, interrupted, replaced and erased")
+  {
+    rmf_traffic::Trajectory interruption("map_A");
+    interruption.insert(time + 10s, make_schedule_test_profile(),
+                        Eigen::Vector3d(1, 0, 0), Eigen::Vector3d::Zero());
+    interruption.insert(time + 20s, make_schedule_test_profile(),
+                        Eigen::Vector3d(1, 0, 0), Eigen::Vector3d::Zero());
+
+    CHECK(sharded.delay(1, time, 10s) == db.delay(1, time, 10s));
+    CHECK(sharded.interrupt(2, interruption, 5s)
+          == db.interrupt(2, interruption, 5s));
+    CHECK(sharded.erase(5) == db.erase(5));
+    CHECK(sharded.delay(9, time, 10s) == db.delay(9, time, 10s));
+
+    const auto replacement = make_row_trajectory("map_B", 0.0, time + 30s);
+    CHECK(sharded.replace(3, replacement) == db.replace(3, replacement));
+
+    THEN("The sharded database matches")
+    {
+      check_match();
+    }
+
+    THEN("A trajectory can be changed again after it moves onto a new map")
+    {
+      CHECK(sharded.delay(13, time, 5s) == db.delay(13, time, 5s));
+      CHECK(sharded.erase(14) == db.erase(14));
+      check_match();
+      CHECK(sharded.query(rmf_traffic::schedule::make_query(
+              {"map_A"}, nullptr, nullptr)).size() == 3);
+    }
+  }
+
+  WHEN("A batch changes both maps")
+  {
+    rmf_traffic::schedule::Database::Batch batch;
+    batch.insert(make_row_trajectory("map_C", 0.0, time))
+        .delay(1, time, 10s)
+        .replace(6, make_row_trajectory("map_A", 9.0, time))
+        .erase(7)
+        .delay(2, time, 20s);
+
+    rmf_traffic::schedule::Database::Batch copy = batch;
+    CHECK(sharded.apply(std::move(batch)) == db.apply(std::move(copy)));
+    CHECK(sharded.latest_version() == 13);
+
+    THEN("The sharded database matches")
+    {
+      check_match();
+    }
+  }
+
+  WHEN("Both maps have entries in the same slots")
+  {
+    // Each shard hands out its own slots, so a query that visits several
+    // maps must not mistake an entry of one map for an entry of another.
+    const auto query = rmf_traffic::schedule::make_query({
+          make_box_region("map_A", time, time + 200s, {5.0, 1.0}, 1.5),
+          make_box_region("map_B", time, time + 200s, {5.0, 1.0}, 1.5),
+          make_box_region("map_A", time, time + 200s, {5.0, 2.0}, 1.5)});
+
+    THEN("Region queries find the entries of every map")
+    {
+      const auto expected = view_finishes(db.query(query));
+      CHECK(expected.size() == 6);
+      CHECK(view_finishes(sharded.query(query)) == expected);
+      CHECK(view_finishes(sharded.snapshot().query(query)) == expected);
+    }
+  }
+
+  WHEN("A snapshot is taken of only one map")
+  {
+    const auto snapshot = sharded.snapshot({"map_B"});
+    sharded.delay(5, time, 10s);
+    sharded.insert(make_row_trajectory("map_A", 8.0, time));
+
+    THEN("Only that map is in the snapshot")
+    {
+      const auto finishes = view_finishes(snapshot.query(everything));
+      CHECK(snapshot.latest_version() == 8);
+      CHECK(finishes.size() == 4);
+      CHECK(finishes.count(5) == 1);
+      CHECK(finishes.count(1) == 0);
+    }
+  }
+
+  WHEN("The schedule gets culled")
+  {
+    sharded.insert(make_row_trajectory("map_B", 10.0, time + 1000s));
+    db.insert(make_row_trajectory("map_B", 10.0, time + 1000s));
+
+    const auto last_version = mirror.latest_version();
+    CHECK(sharded.cull(time + 500s) == db.cull(time + 500s));
+    CHECK(sharded.cull(time + 500s) == sharded.latest_version());
+
+    THEN("Mirrors hear about the cull")
+    {
+      const auto patch = sharded.changes(
+            rmf_traffic::schedule::make_query(last_version));
+      CHECK(patch.size() == 2);
+      CHECK((--patch.end())->get_mode()
+            == rmf_traffic::schedule::Database::Change::Mode::Cull);
+
+      check_match();
+      CHECK(sharded.query(everything).size() == 1);
+      CHECK(sharded.oldest_version() == 9);
+    }
+
+    THEN("Culled versions can no longer be changed")
+    {
+      CHECK_THROWS(sharded.delay(1, time, 10s));
+      CHECK(sharded.latest_version() == db.latest_version());
+    }
+  }
+
+  WHEN("A batch refers to a version that does not exist")
+  {
+    rmf_traffic::schedule::Database::Batch batch;
+    batch.insert(make_row_trajectory("map_C", 0.0, time))
+        .delay(1, time, 10s)
+        .erase(100);
+    CHECK_THROWS(sharded.apply(std::move(batch)));
+
+    THEN("Nothing is changed")
+    {
+      check_match();
+      CHECK(sharded.query(rmf_traffic::schedule::make_query(
+              {"map_C"}, nullptr, nullptr)).size() == 0);
+    }
+  }
+
+  WHEN("A batch refers to a version from earlier in the same batch")
+  {
+    rmf_traffic::schedule::Database::Batch batch;
+    batch.insert(make_row_trajectory("map_A", 0.0, time)).delay(9, time, 10s);
+
+    THEN("It is rejected")
+    {
+      CHECK_THROWS(sharded.apply(std::move(batch)));
+      check_match();
+    }
+  }
+}
+
+//==============================================================================
+SCENARIO("Sharded databases take changes from many threads")
+{
+  const rmf_traffic::Time time = std::chrono::steady_clock::now();
+  const auto everything = rmf_traffic::schedule::query_everything();
+
+  rmf_traffic::schedule::ShardedDatabase sharded;
+  sharded.set_compaction_interval(10);
+
+  // Each writer has its own map. Catch assertions are not thread-safe, so the
+  // results are only checked after the threads have finished.
+  const std::size_t num_writers = 4;
+  const std::size_t num_trajectories = 25;
+  std::vector<std::vector<rmf_traffic::schedule::Version>> versions(
+        num_writers);
+  std::vector<std::vector<rmf_traffic::schedule::Version>> batch_ends(
+        num_writers);
+  std::vector<std::thread> writers;
+  for(std::size_t w=0; w < num_writers; ++w)
+  {
+    writers.emplace_back([&, w]()
+    {
+      const std::string map = "map_" + std::to_string(w);
+      std::vector<rmf_traffic::schedule::Version> ids;
+      for(std::size_t i=0; i < num_trajectories; ++i)
+      {
+        ids.push_back(sharded.insert(make_row_trajectory(
+            map, static_cast<double>(i), time)));
+        versions[w].push_back(ids.back());
+      }
+
+      for(auto& id : ids)
+      {
+        id = sharded.delay(id, time, 10s);
+        versions[w].push_back(id);
+      }
+
+      // The changes of a batch get one block of versions
+      for(std::size_t b=0; b < ids.size(); b += 5)
+      {
+        rmf_traffic::schedule::Database::Batch batch;
+        for(std::size_t i=b; i < b+5; ++i)
+          batch.delay(ids[i], time, 10s);
+
+        const auto last = sharded.apply(std::move(batch));
+        for(std::size_t i=b; i < b+5; ++i)
+        {
+          ids[i] = last - (b + 4 - i);
+          versions[w].push_back(ids[i]);
+        }
+        batch_ends[w].push_back(last);
+      }
+    });
+  }
+
+  // A mirror keeps up with the changes while they are being made, and the
+  // history that it no longer needs gets compacted
+  rmf_traffic::schedule::Mirror mirror;
+  std::atomic_bool done(false);
+  std::thread reader([&]()
+  {
+    while(!done)
+    {
+      mirror.update(sharded.changes(
+            rmf_traffic::schedule::make_query(mirror.latest_version())));
+      sharded.set_oldest_needed_version(mirror.latest_version());
+      sharded.snapshot().query(everything);
+    }
+  });
+
+  for(auto& writer : writers)
+    writer.join();
+
+  done = true;
+  reader.join();
+
+  const std::size_t total = num_writers * num_trajectories * 3;
+  CHECK(sharded.latest_version() == total);
+
+  std::set<rmf_traffic::schedule::Version> all_versions;
+  for(const auto& v : versions)
+    all_versions.insert(v.begin(), v.end());
+
+  CHECK(all_versions.size() == total);
+  CHECK(*all_versions.begin() == 1);
+  CHECK(*all_versions.rbegin() == total);
+
+  // Each writer took its versions in order
+  for(const auto& v : versions)
+    CHECK(std::is_sorted(v.begin(), v.end()));
+
+  const auto expected = view_finishes(sharded.snapshot().query(everything));
+  CHECK(expected.size() == num_writers * num_trajectories);
+  for(const auto& entry : expected)
+    CHECK(entry.second == time + 90s + 20s);
+
+  mirror.update(sharded.changes(
+        rmf_traffic::schedule::make_query(mirror.latest_version())));
+  CHECK(mirror.latest_version() == total);
+  CHECK(view_finishes(mirror.query(everything)) == expected);
+
+  rmf_traffic::schedule::Mirror fresh;
+  fresh.update(sharded.changes(everything));
+  CHECK(view_finishes(fresh.query(everything)) == expected);
+
+  for(std::size_t w=0; w < num_writers; ++w)
+  {
+    const auto map = rmf_traffic::schedule::make_query(
+          {"map_" + std::to_string(w)}, nullptr, nullptr);
+    CHECK(sharded.query(map).size() == num_trajectories);
+  }
+}
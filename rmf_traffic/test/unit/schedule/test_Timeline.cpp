@@ -0,0 +1,267 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include "../utils_Trajectory.hpp"
+
+#include "src/rmf_traffic/schedule/ViewerInternal.hpp"
+
+#include <rmf_utils/catch.hpp>
+
+#include <unordered_set>
+
+using namespace std::chrono_literals;
+
+using rmf_traffic::schedule::internal::ConstEntryPtr;
+using rmf_traffic::schedule::internal::Entry;
+using rmf_traffic::schedule::internal::Timeline;
+
+namespace {
+
+//==============================================================================
+ConstEntryPtr make_entry(
+    const rmf_traffic::Time start,
+    const rmf_traffic::Time finish,
+    const rmf_traffic::schedule::Version version)
+{
+  return std::make_shared<Entry>(
+        make_row_trajectory("test_map", 0.0, start, finish - start), version);
+}
+
+//==============================================================================
+// Check that every entry is stored in exactly the buckets that its trajectory
+// passes through, at the positions that the entry has recorded, and that the
+// timeline is not holding onto anything else.
+void CHECK_TIMELINE(
+    const Timeline& timeline,
+    const std::vector<ConstEntryPtr>& entries)
+{
+  std::size_t expected_count = 0;
+  for(const auto& entry : entries)
+  {
+    const std::size_t first =
+        timeline.lower_bound(*entry->trajectory.start_time());
+    const std::size_t last =
+        timeline.lower_bound(*entry->trajectory.finish_time());
+
+    REQUIRE(last < timeline.size());
+    REQUIRE(entry->bucket_slots.size() == last - first + 1);
+    for(std::size_t k = 0; k < entry->bucket_slots.size(); ++k)
+    {
+      const auto& bucket = timeline[first + k];
+      REQUIRE(entry->bucket_slots[k] < bucket.size());
+      CHECK(bucket[entry->bucket_slots[k]] == entry);
+    }
+
+    expected_count += entry->bucket_slots.size();
+  }
+
+  std::size_t count = 0;
+  for(std::size_t i = 0; i < timeline.size(); ++i)
+    count += timeline[i].size();
+
+  CHECK(count == expected_count);
+}
+
+//==============================================================================
+std::unordered_set<ConstEntryPtr> collect(
+    const Timeline& timeline,
+    const std::size_t begin,
+    const std::size_t end)
+{
+  std::unordered_set<ConstEntryPtr> found;
+  for(std::size_t i = begin; i < end; ++i)
+    found.insert(timeline[i].begin(), timeline[i].end());
+
+  return found;
+}
+
+} // anonymous namespace
+
+//==============================================================================
+SCENARIO("Timeline buckets grow and shrink at both ends")
+{
+  const rmf_traffic::Time t0 = std::chrono::steady_clock::now();
+
+  Timeline timeline;
+  const auto a = make_entry(t0, t0 + 30s, 0);
+  timeline.insert(a);
+  CHECK(timeline.size() == 1);
+  CHECK_TIMELINE(timeline, {a});
+
+  WHEN("An entry is inserted before the origin of the timeline")
+  {
+    const auto b = make_entry(t0 - 5min, t0 - 4min, 1);
+    timeline.insert(b);
+
+    THEN("Buckets are added to the front and the old entries stay put")
+    {
+      CHECK(timeline.size() == 6);
+      CHECK(timeline.lower_bound(t0) == 5);
+      CHECK(timeline[5].size() == 1);
+      CHECK_TIMELINE(timeline, {a, b});
+
+      const auto early = collect(
+            timeline, timeline.lower_bound(t0 - 5min),
+            timeline.upper_bound(t0 - 4min));
+      CHECK(early.count(b) == 1);
+      CHECK(early.count(a) == 0);
+    }
+
+    THEN("The entries can still be erased")
+    {
+      timeline.erase(b);
+      CHECK(b->bucket_slots.empty());
+      CHECK_TIMELINE(timeline, {a});
+
+      timeline.erase(a);
+      CHECK_TIMELINE(timeline, {});
+    }
+  }
+
+  WHEN("An entry extends past both ends of the timeline")
+  {
+    const auto c = make_entry(t0 - 3min, t0 + 5min, 1);
+    timeline.insert(c);
+
+    THEN("Buckets are added to both ends")
+    {
+      CHECK(timeline.size() == 9);
+      CHECK(c->bucket_slots.size() == 9);
+      CHECK(timeline.lower_bound(t0) == 3);
+      CHECK_TIMELINE(timeline, {a, c});
+    }
+
+    THEN("A replacement can extend both ends again")
+    {
+      const auto d = make_entry(t0 - 10min, t0 + 10min, 2);
+      timeline.replace(c, d);
+      CHECK(c->bucket_slots.empty());
+      CHECK_TIMELINE(timeline, {a, d});
+
+      timeline.replace(a, a);
+      CHECK_TIMELINE(timeline, {a, d});
+
+      timeline.erase(d);
+      CHECK_TIMELINE(timeline, {a});
+    }
+  }
+
+  WHEN("A cull empties the buckets at the front")
+  {
+    const auto b = make_entry(t0 + 3min, t0 + 4min, 1);
+    timeline.insert(b);
+    CHECK(timeline.size() == 5);
+
+    std::unordered_set<rmf_traffic::schedule::Version> culled;
+    timeline.cull(t0 + 2min, culled);
+
+    THEN("The empty buckets are dropped")
+    {
+      CHECK(culled == std::unordered_set<rmf_traffic::schedule::Version>{0});
+      CHECK(timeline.size() == 2);
+      CHECK(timeline.lower_bound(t0) == 0);
+      CHECK_TIMELINE(timeline, {b});
+    }
+
+    THEN("New entries can be inserted on either side")
+    {
+      const auto c = make_entry(t0, t0 + 1min, 2);
+      const auto d = make_entry(t0 + 10min, t0 + 11min, 3);
+      timeline.insert(c);
+      timeline.insert(d);
+      CHECK_TIMELINE(timeline, {b, c, d});
+
+      timeline.erase(b);
+      CHECK_TIMELINE(timeline, {c, d});
+
+      const auto e = make_entry(t0 + 30s, t0 + 10min, 4);
+      timeline.replace(c, e);
+      CHECK_TIMELINE(timeline, {d, e});
+    }
+  }
+}
+
+//==============================================================================
+SCENARIO("Timeline queries that land exactly on bucket edges")
+{
+  const rmf_traffic::Time t0 = std::chrono::steady_clock::now();
+
+  // The first bucket key is PartialBucketDuration (50s) after the start of
+  // the first entry, and each key after that is one BucketDuration (1min)
+  // later.
+  const rmf_traffic::Time key0 = t0 + 50s;
+  const rmf_traffic::Time key1 = key0 + 1min;
+  const rmf_traffic::Time key2 = key1 + 1min;
+
+  Timeline timeline;
+  const auto x = make_entry(t0, t0 + 10s, 0);
+  const auto h = make_entry(key1, key2, 1);
+  timeline.insert(x);
+  timeline.insert(h);
+
+  // Bucket i holds the entries that intersect ( key(i) - 1min, key(i) ]
+  REQUIRE(timeline.size() == 3);
+  CHECK(timeline[0].size() == 1);
+  CHECK(timeline[1].size() == 1);
+  CHECK(timeline[2].size() == 1);
+  CHECK_TIMELINE(timeline, {x, h});
+
+  CHECK(timeline.lower_bound(key0) == 0);
+  CHECK(timeline.upper_bound(key0) == 1);
+  CHECK(timeline.lower_bound(key1) == 1);
+  CHECK(timeline.upper_bound(key1) == 2);
+  CHECK(timeline.lower_bound(key1 + 1ns) == 2);
+  CHECK(timeline.upper_bound(key1 - 1ns) == 1);
+  CHECK(timeline.lower_bound(key2) == 2);
+  CHECK(timeline.lower_bound(key2 + 1ns) == 3);
+
+  using Implementation = rmf_traffic::schedule::Viewer::Implementation;
+
+  GIVEN("An upper bound on the start of the entry")
+  {
+    const auto range =
+        Implementation::get_timeline_range(timeline, nullptr, &key1);
+    CHECK(collect(timeline, range.first, range.second).count(h) == 1);
+
+    // Without the extra bucket that get_timeline_range adds, the entry is
+    // still found, because its start time is the key of its first bucket.
+    CHECK(collect(timeline, 0, timeline.upper_bound(key1)).count(h) == 1);
+    CHECK(collect(timeline, 0, timeline.upper_bound(key1 - 1ns)).count(h)
+          == 0);
+  }
+
+  GIVEN("A lower bound on the finish of the entry")
+  {
+    const auto range =
+        Implementation::get_timeline_range(timeline, &key2, nullptr);
+    CHECK(collect(timeline, range.first, range.second).count(h) == 1);
+
+    const rmf_traffic::Time after = key2 + 1ns;
+    const auto after_range =
+        Implementation::get_timeline_range(timeline, &after, nullptr);
+    CHECK(collect(timeline, after_range.first, after_range.second).empty());
+  }
+
+  GIVEN("Both bounds on the same bucket edge")
+  {
+    const auto range =
+        Implementation::get_timeline_range(timeline, &key1, &key1);
+    const auto found = collect(timeline, range.first, range.second);
+    CHECK(found.count(h) == 1);
+    CHECK(found.count(x) == 0);
+  }
+}
@@ -631,4 +631,307 @@ SCENARIO("DetectConflict unit tests")
   }
 }
 
+SCENARIO("Repeated conflict checks with changing shapes")
+{
+  using namespace rmf_traffic;
+  const Time time = std::chrono::steady_clock::now();
+
+  const auto make_stationary = [&](
+      const double radius, const Eigen::Vector3d& p) -> Trajectory
+  {
+    const auto profile = Trajectory::Profile::make_guided(
+          geometry::make_final_convex<geometry::Circle>(radius));
+
+    Trajectory t("test_map");
+    t.insert(time, profile, p, Eigen::Vector3d::Zero());
+    t.insert(time + 10s, profile, p, Eigen::Vector3d::Zero());
+    return t;
+  };
+
+  const Trajectory large_a = make_stationary(1.0, Eigen::Vector3d(0, 0, 0));
+  const Trajectory large_b = make_stationary(1.0, Eigen::Vector3d(1, 0, 0));
+  const Trajectory small_a = make_stationary(0.2, Eigen::Vector3d(0, 0, 0));
+  const Trajectory small_b = make_stationary(0.2, Eigen::Vector3d(1, 0, 0));
+
+  // The narrow phase reuses its collision objects across calls, so alternating
+  // between shapes must never give a stale answer.
+  for(std::size_t i=0; i < 3; ++i)
+  {
+    CHECK(DetectConflict::narrow_phase(large_a, large_b).size() == 1);
+    CHECK(DetectConflict::narrow_phase(small_a, small_b).empty());
+    CHECK(DetectConflict::narrow_phase(large_a, small_b).size() == 1);
+    CHECK(DetectConflict::narrow_phase(small_a, large_b).size() == 1);
+  }
+}
+
+SCENARIO("All-pairs conflict detection")
+{
+  using namespace rmf_traffic;
+  const Time time = std::chrono::steady_clock::now();
+  const auto profile = Trajectory::Profile::make_guided(
+        geometry::make_final_convex<geometry::Circle>(0.5));
+
+  // Build a grid of robots that each drive along a straight line during a
+  // staggered window of time, so that some pairs overlap in time and space,
+  // some overlap only in time, and some overlap in neither.
+  std::vector<Trajectory> trajectories;
+  for(std::size_t i=0; i < 24; ++i)
+  {
+    const std::string map = (i % 5 == 0)? "other_map" : "test_map";
+    const double y = static_cast<double>(i % 4);
+    const Time start = time + std::chrono::seconds(5*(i%6));
+    const Eigen::Vector3d direction = (i%2 == 0)?
+          Eigen::Vector3d(1, 0, 0) : Eigen::Vector3d(-1, 0, 0);
+
+    Trajectory t(map);
+    t.insert(start, profile, Eigen::Vector3d(-5, y, 0)*direction[0],
+        Eigen::Vector3d::Zero());
+    t.insert(start + 10s, profile, Eigen::Vector3d(5, y, 0)*direction[0],
+        Eigen::Vector3d::Zero());
+    t.insert(start + 15s, profile, Eigen::Vector3d(5, y+0.5, 0)*direction[0],
+        Eigen::Vector3d::Zero());
+    trajectories.emplace_back(std::move(t));
+  }
+
+  std::vector<const Trajectory*> pointers;
+  for(const auto& t : trajectories)
+    pointers.push_back(&t);
+
+  std::vector<DetectConflict::IndexPair> expected;
+  for(std::size_t i=0; i < trajectories.size(); ++i)
+  {
+    for(std::size_t j=i+1; j < trajectories.size(); ++j)
+    {
+      if(!DetectConflict::between(trajectories[i], trajectories[j]).empty())
+        expected.emplace_back(i, j);
+    }
+  }
+
+  CHECK(!expected.empty());
+  CHECK(DetectConflict::all_pairs(pointers) == expected);
+  CHECK(DetectConflict::all_pairs(pointers, 4) == expected);
+  CHECK(DetectConflict::all_pairs({}).empty());
+
+  Trajectory invalid("test_map");
+  invalid.insert(time, profile, Eigen::Vector3d::Zero(),
+                 Eigen::Vector3d::Zero());
+  pointers.push_back(&invalid);
+  CHECK_THROWS_AS(DetectConflict::all_pairs(pointers),
+                  invalid_trajectory_error);
+}
+
+SCENARIO("Parallel pair checks that throw")
+{
+  using IndexPair = rmf_traffic::DetectConflict::IndexPair;
+  using rmf_traffic::internal::check_pairs;
+
+  std::vector<IndexPair> candidates;
+  for(std::size_t i=0; i < 20; ++i)
+    candidates.emplace_back(i, i+1);
+
+  const auto even = [](const IndexPair& pair) -> bool
+  {
+    return pair.first % 2 == 0;
+  };
+
+  const IndexPair bad(13, 14);
+  const auto throw_on_bad = [&](const IndexPair& pair) -> bool
+  {
+    if(pair == bad)
+      throw std::runtime_error("bad pair");
+
+    return pair.first % 2 == 0;
+  };
+
+  for(const std::size_t num_threads : {0, 1, 3, 4, 32})
+  {
+    std::vector<IndexPair> passed = check_pairs(candidates, even, num_threads);
+    std::sort(passed.begin(), passed.end());
+    CHECK(passed.size() == 10);
+    for(const auto& pair : passed)
+      CHECK(pair.first % 2 == 0);
+
+    // The exception gets back to the caller instead of terminating
+    CHECK_THROWS_AS(check_pairs(candidates, throw_on_bad, num_threads),
+                    std::runtime_error);
+  }
+}
+
+SCENARIO("Spacetime region checks with precomputed bounds")
+{
+  using namespace rmf_traffic;
+  const Time time = std::chrono::steady_clock::now();
+  const auto profile = Trajectory::Profile::make_guided(
+        geometry::make_final_convex<geometry::Circle>(0.5));
+
+  Trajectory trajectory("test_map");
+  trajectory.insert(time, profile, Eigen::Vector3d(0, 0, 0),
+                    Eigen::Vector3d::Zero());
+  trajectory.insert(time + 10s, profile, Eigen::Vector3d(10, 0, 0),
+                    Eigen::Vector3d::Zero());
+  trajectory.insert(time + 20s, profile, Eigen::Vector3d(10, 10, 0),
+                    Eigen::Vector3d::Zero());
+
+  const internal::BoundingBox trajectory_bounds =
+      internal::get_bounding_box(trajectory);
+  CHECK(trajectory_bounds.min.x() == Approx(-0.5));
+  CHECK(trajectory_bounds.min.y() == Approx(-0.5));
+  CHECK(trajectory_bounds.max.x() == Approx(10.5));
+  CHECK(trajectory_bounds.max.y() == Approx(10.5));
+
+  const auto circle = geometry::make_final<geometry::Circle>(1.0);
+
+  GIVEN("A region that is far away from the trajectory")
+  {
+    const Eigen::Isometry2d pose(Eigen::Translation2d(-10.0, 5.0));
+    const internal::BoundingBox region_bounds =
+        internal::get_bounding_box(pose, *circle);
+    CHECK_FALSE(internal::overlap(region_bounds, trajectory_bounds));
+
+    internal::Spacetime region{nullptr, nullptr, pose, circle, &region_bounds};
+    CHECK_FALSE(internal::detect_conflicts(
+                  trajectory, region, nullptr, &trajectory_bounds));
+  }
+
+  GIVEN("A region that only overlaps the second segment")
+  {
+    const Eigen::Isometry2d pose(Eigen::Translation2d(10.0, 5.0));
+    const internal::BoundingBox region_bounds =
+        internal::get_bounding_box(pose, *circle);
+    CHECK(internal::overlap(region_bounds, trajectory_bounds));
+
+    internal::Spacetime region{nullptr, nullptr, pose, circle, &region_bounds};
+
+    std::vector<Trajectory::const_iterator> with_bounds;
+    CHECK(internal::detect_conflicts(
+            trajectory, region, &with_bounds, &trajectory_bounds));
+
+    region.bounds = nullptr;
+    std::vector<Trajectory::const_iterator> without_bounds;
+    CHECK(internal::detect_conflicts(trajectory, region, &without_bounds));
+
+    CHECK(with_bounds == without_bounds);
+    REQUIRE(with_bounds.size() == 1);
+    CHECK(with_bounds.front() == --trajectory.end());
+  }
+}
+
+SCENARIO("Conflict checks restricted to trajectory views")
+{
+  using namespace rmf_traffic;
+  const Time time = std::chrono::steady_clock::now();
+  const auto profile = Trajectory::Profile::make_guided(
+        geometry::make_final_convex<geometry::Circle>(0.5));
+
+  // Robot `a` drives through the origin and then waits at (5, 0). Robot `b`
+  // crosses the path of `a` at the origin, and later drives through the spot
+  // where `a` is waiting.
+  Trajectory a("test_map");
+  a.insert(time, profile, Eigen::Vector3d(-5, 0, 0), Eigen::Vector3d::Zero());
+  a.insert(time + 10s, profile, Eigen::Vector3d(5, 0, 0),
+           Eigen::Vector3d::Zero());
+  a.insert(time + 30s, profile, Eigen::Vector3d(5, 0, 0),
+           Eigen::Vector3d::Zero());
+
+  Trajectory b("test_map");
+  b.insert(time, profile, Eigen::Vector3d(0, -5, 0), Eigen::Vector3d::Zero());
+  b.insert(time + 10s, profile, Eigen::Vector3d(0, 5, 0),
+           Eigen::Vector3d::Zero());
+  b.insert(time + 15s, profile, Eigen::Vector3d(5, 5, 0),
+           Eigen::Vector3d::Zero());
+  b.insert(time + 25s, profile, Eigen::Vector3d(5, -5, 0),
+           Eigen::Vector3d::Zero());
+
+  const auto full_conflicts = DetectConflict::between(a, b);
+  REQUIRE(full_conflicts.size() == 2);
+  CHECK(full_conflicts.front().get_time() < time + 10s);
+  CHECK(time + 15s < full_conflicts.back().get_time());
+
+  const auto full_view_conflicts = DetectConflict::between(
+        Trajectory::View(a), Trajectory::View(b));
+  CHECK(full_view_conflicts.size() == full_conflicts.size());
+
+  WHEN("Only the later part of one trajectory is viewed")
+  {
+    const Trajectory::View late_a(a, time + 12s, time + 40s);
+    const auto conflicts = DetectConflict::between(late_a, b);
+
+    THEN("Only the later conflict is found")
+    {
+      REQUIRE(conflicts.size() == 1);
+      CHECK(time + 15s < conflicts.front().get_time());
+      CHECK(conflicts.front().get_segments().first == --a.end());
+    }
+  }
+
+  WHEN("The views do not include either conflict")
+  {
+    const Trajectory::View late_a(a, time + 12s, time + 40s);
+    const Trajectory::View early_b(b, time, time + 14s);
+
+    THEN("No conflicts are found")
+    {
+      CHECK(DetectConflict::between(late_a, early_b).empty());
+    }
+  }
+
+  WHEN("The views finish at different times")
+  {
+    // Robot `c` waits and then drives along the x axis, passing robot `d`
+    // right as `d` arrives at the x axis around time + 6s. Robot `c` is only
+    // viewed until time + 5s, so the motion of `d` that starts at time + 6s
+    // overlaps the spline of `c` without overlapping the view of `c`.
+    Trajectory c("test_map");
+    c.insert(time, profile, Eigen::Vector3d(-20, 0, 0),
+             Eigen::Vector3d::Zero());
+    c.insert(time + 4s, profile, Eigen::Vector3d(-20, 0, 0),
+             Eigen::Vector3d::Zero());
+    c.insert(time + 12s, profile, Eigen::Vector3d(20, 0, 0),
+             Eigen::Vector3d::Zero());
+
+    Trajectory d("test_map");
+    d.insert(time, profile, Eigen::Vector3d(-14, -10, 0),
+             Eigen::Vector3d::Zero());
+    d.insert(time + 3s, profile, Eigen::Vector3d(-14, -10, 0),
+             Eigen::Vector3d::Zero());
+    d.insert(time + 6s, profile, Eigen::Vector3d(-14, 0, 0),
+             Eigen::Vector3d::Zero());
+    d.insert(time + 10s, profile, Eigen::Vector3d(-14, 10, 0),
+             Eigen::Vector3d::Zero());
+
+    REQUIRE(!DetectConflict::between(c, d).empty());
+
+    const Trajectory::View early_c(c, time, time + 5s);
+    const Trajectory::View late_d(d, time + 2s, time + 10s);
+
+    THEN("Only the motion inside of both views is checked")
+    {
+      CHECK(DetectConflict::narrow_phase(early_c, Trajectory::View(d)).empty());
+      CHECK(DetectConflict::narrow_phase(Trajectory::View(d), early_c).empty());
+      CHECK(DetectConflict::narrow_phase(early_c, late_d).empty());
+      CHECK(DetectConflict::narrow_phase(late_d, early_c).empty());
+      CHECK(!DetectConflict::narrow_phase(Trajectory::View(c), late_d).empty());
+    }
+  }
+
+  WHEN("A view does not overlap its trajectory")
+  {
+    const Trajectory::View empty_a(a, time + 40s, time + 50s);
+
+    THEN("The broad phase rejects it")
+    {
+      CHECK(empty_a.empty());
+      CHECK(!DetectConflict::broad_phase(empty_a, b));
+      CHECK(DetectConflict::between(empty_a, b).empty());
+    }
+
+    THEN("The narrow phase gives back no conflicts")
+    {
+      CHECK(DetectConflict::narrow_phase(empty_a, b).empty());
+      CHECK(DetectConflict::narrow_phase(b, empty_a).empty());
+      CHECK(DetectConflict::narrow_phase(empty_a, empty_a).empty());
+    }
+  }
+}
+
 // A useful website for playing with 2D cubic splines: https://www.desmos.com/calculator/
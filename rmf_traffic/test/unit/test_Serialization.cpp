@@ -0,0 +1,289 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <rmf_traffic/Serialization.hpp>
+#include <rmf_traffic/geometry/Box.hpp>
+#include <rmf_traffic/geometry/Circle.hpp>
+#include <rmf_traffic/schedule/Query.hpp>
+
+#include <rmf_utils/catch.hpp>
+
+#include <cmath>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+//==============================================================================
+rmf_traffic::Trajectory make_trajectory(const rmf_traffic::Time start)
+{
+  using Profile = rmf_traffic::Trajectory::Profile;
+  const auto box = Profile::make_guided(
+        rmf_traffic::geometry::make_final_convex<
+          rmf_traffic::geometry::Box>(1.0, 0.5));
+  const auto circle = Profile::make_queued(
+        rmf_traffic::geometry::make_final_convex<
+          rmf_traffic::geometry::Circle>(0.3), "door_1");
+
+  rmf_traffic::Trajectory trajectory("test_map");
+  for(std::size_t i=0; i < 20; ++i)
+  {
+    const double x = 0.123*static_cast<double>(i);
+    trajectory.push_back(
+          start + std::chrono::milliseconds(250*i),
+          i < 10? box : circle,
+          Eigen::Vector3d(x, -x, 0.01*x),
+          Eigen::Vector3d(0.4, -0.4, 0.0));
+  }
+
+  return trajectory;
+}
+
+//==============================================================================
+void check_equal(
+    const rmf_traffic::Trajectory& a,
+    const rmf_traffic::Trajectory& b,
+    const double tolerance)
+{
+  REQUIRE(a.size() == b.size());
+  CHECK(a.get_map_name() == b.get_map_name());
+
+  auto it_a = a.begin();
+  auto it_b = b.begin();
+  for(; it_a != a.end(); ++it_a, ++it_b)
+  {
+    CHECK(it_a->get_finish_time() == it_b->get_finish_time());
+    CHECK((it_a->get_finish_position() - it_b->get_finish_position()).norm()
+          <= tolerance);
+    CHECK((it_a->get_finish_velocity() - it_b->get_finish_velocity()).norm()
+          <= tolerance);
+    CHECK(it_a->get_profile()->get_autonomy()
+          == it_b->get_profile()->get_autonomy());
+  }
+}
+
+} // anonymous namespace
+
+//==============================================================================
+SCENARIO("Binary serialization of trajectories")
+{
+  namespace serialization = rmf_traffic::serialization;
+
+  const rmf_traffic::Time start = std::chrono::steady_clock::now();
+  const rmf_traffic::Trajectory trajectory = make_trajectory(start);
+
+  WHEN("A trajectory is encoded losslessly")
+  {
+    const serialization::Buffer buffer = serialization::encode(trajectory);
+    const rmf_traffic::Trajectory decoded =
+        serialization::decode_trajectory(buffer);
+
+    THEN("It is decoded exactly")
+    {
+      check_equal(trajectory, decoded, 0.0);
+
+      const auto& queued = decoded.back().get_profile();
+      REQUIRE(queued->get_queue_info());
+      CHECK(queued->get_queue_info()->get_queue_id() == "door_1");
+
+      const auto& circle = static_cast<const rmf_traffic::geometry::Circle&>(
+            queued->get_shape()->source());
+      CHECK(circle.get_radius() == 0.3);
+    }
+
+    THEN("Segments that shared a profile still share one")
+    {
+      CHECK(decoded.front().get_profile()
+            == decoded.find(start + 1s)->get_profile());
+      CHECK(decoded.front().get_profile() != decoded.back().get_profile());
+    }
+  }
+
+  WHEN("A trajectory is encoded with quantization")
+  {
+    const double resolution = 1e-3;
+    const serialization::Buffer lossless = serialization::encode(trajectory);
+    const serialization::Buffer buffer = serialization::encode(
+          trajectory, serialization::Options(resolution));
+
+    THEN("It is smaller and accurate to the resolution")
+    {
+      CHECK(buffer.size() < lossless.size()/3);
+      check_equal(
+            trajectory, serialization::decode_trajectory(buffer),
+            std::sqrt(3.0)*resolution);
+    }
+  }
+
+  WHEN("An empty trajectory is encoded")
+  {
+    const rmf_traffic::Trajectory decoded = serialization::decode_trajectory(
+          serialization::encode(rmf_traffic::Trajectory("empty_map")));
+
+    THEN("It is decoded as an empty trajectory")
+    {
+      CHECK(decoded.size() == 0);
+      CHECK(decoded.get_map_name() == "empty_map");
+    }
+  }
+
+  WHEN("A malformed buffer is decoded")
+  {
+    serialization::Buffer buffer = serialization::encode(trajectory);
+
+    THEN("An exception is thrown")
+    {
+      const serialization::Buffer truncated(
+            buffer.begin(), buffer.begin() + buffer.size()/2);
+      CHECK_THROWS_AS(
+            serialization::decode_trajectory(truncated), std::runtime_error);
+
+      serialization::Buffer bad_magic = buffer;
+      bad_magic[0] = 'X';
+      CHECK_THROWS_AS(
+            serialization::decode_trajectory(bad_magic), std::runtime_error);
+
+      serialization::Buffer newer = buffer;
+      newer[4] = serialization::FormatVersion + 1;
+      CHECK_THROWS_AS(
+            serialization::decode_trajectory(newer), std::runtime_error);
+
+      CHECK_THROWS_AS(
+            serialization::decode_patch(buffer), std::runtime_error);
+    }
+  }
+
+  WHEN("A buffer has two segments that finish at the same time")
+  {
+    const auto profile = trajectory.front().get_profile();
+    const auto make_pair = [&](const rmf_traffic::Duration gap)
+    {
+      rmf_traffic::Trajectory pair("test_map");
+      pair.push_back(start, profile, Eigen::Vector3d::Zero(),
+                     Eigen::Vector3d::Zero());
+      pair.push_back(start + gap, profile, Eigen::Vector3d::UnitX(),
+                     Eigen::Vector3d::Zero());
+      return pair;
+    };
+
+    // The only byte that differs between these is the time delta of the
+    // second segment.
+    serialization::Buffer buffer = serialization::encode(make_pair(1ns));
+    const serialization::Buffer other = serialization::encode(make_pair(2ns));
+    REQUIRE(buffer.size() == other.size());
+
+    std::size_t delta_index = buffer.size();
+    for(std::size_t i=0; i < buffer.size(); ++i)
+    {
+      if(buffer[i] != other[i])
+      {
+        CHECK(delta_index == buffer.size());
+        delta_index = i;
+      }
+    }
+
+    REQUIRE(delta_index < buffer.size());
+    CHECK(buffer[delta_index] == 1);
+    CHECK(serialization::decode_trajectory(buffer).size() == 2);
+
+    buffer[delta_index] = 0;
+
+    THEN("An exception is thrown")
+    {
+      CHECK_THROWS_AS(
+            serialization::decode_trajectory(buffer), std::runtime_error);
+    }
+  }
+
+  WHEN("A position is too large to quantize")
+  {
+    const auto profile = trajectory.front().get_profile();
+    const serialization::Options options(1e-3);
+
+    rmf_traffic::Trajectory far("test_map");
+    far.push_back(start, profile, Eigen::Vector3d(1e300, 0.0, 0.0),
+                  Eigen::Vector3d::Zero());
+
+    // Each position fits on its own, but the difference between them does not
+    rmf_traffic::Trajectory jump("test_map");
+    jump.push_back(start, profile, Eigen::Vector3d(-6e15, 0.0, 0.0),
+                   Eigen::Vector3d::Zero());
+    jump.push_back(start + 1s, profile, Eigen::Vector3d(6e15, 0.0, 0.0),
+                   Eigen::Vector3d::Zero());
+
+    THEN("An exception is thrown")
+    {
+      CHECK_THROWS_AS(serialization::encode(far, options), std::runtime_error);
+      CHECK_THROWS_AS(serialization::encode(jump, options), std::runtime_error);
+      CHECK_NOTHROW(serialization::encode(far));
+    }
+  }
+}
+
+//==============================================================================
+SCENARIO("Binary serialization of schedule patches")
+{
+  namespace serialization = rmf_traffic::serialization;
+  using Change = rmf_traffic::schedule::Database::Change;
+  using Mode = Change::Mode;
+
+  const rmf_traffic::Time start = std::chrono::steady_clock::now();
+
+  rmf_traffic::schedule::Database db;
+  const auto v1 = db.insert(make_trajectory(start));
+  const auto v2 = db.insert(make_trajectory(start + 10s));
+  const auto v3 = db.delay(v1, start + 1s, 5s);
+  const auto v4 = db.replace(v2, make_trajectory(start + 20s));
+  db.erase(v3);
+  (void)(v4);
+
+  const auto patch = db.changes(rmf_traffic::schedule::query_everything());
+  const auto decoded = serialization::decode_patch(
+        serialization::encode(patch));
+
+  CHECK(decoded.latest_version() == patch.latest_version());
+  REQUIRE(decoded.size() == patch.size());
+
+  auto it = patch.begin();
+  auto dit = decoded.begin();
+  for(; it != patch.end(); ++it, ++dit)
+  {
+    CHECK(dit->get_mode() == it->get_mode());
+    CHECK(dit->id() == it->id());
+
+    if(it->get_mode() == Mode::Insert)
+    {
+      check_equal(
+            *it->insert()->trajectory(), *dit->insert()->trajectory(), 0.0);
+    }
+  }
+
+  const auto delay = Change::make_delay(v1, start + 1s, 5s, 7);
+  const auto decoded_delay = serialization::decode_change(
+        serialization::encode(delay));
+  REQUIRE(decoded_delay.delay());
+  CHECK(decoded_delay.id() == 7);
+  CHECK(decoded_delay.delay()->original_id() == v1);
+  CHECK(decoded_delay.delay()->from() == start + 1s);
+  CHECK(decoded_delay.delay()->duration() == 5s);
+
+  const auto cull = Change::make_cull(start - 5s, 9);
+  const auto decoded_cull = serialization::decode_change(
+        serialization::encode(cull));
+  REQUIRE(decoded_cull.cull());
+  CHECK(decoded_cull.cull()->time() == start - 5s);
+}
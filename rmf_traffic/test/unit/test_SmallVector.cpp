@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <src/rmf_traffic/SmallVector.hpp>
+
+#include <rmf_utils/catch.hpp>
+
+#include <memory>
+#include <vector>
+
+namespace {
+
+template<typename Container>
+std::vector<int> values(const Container& container)
+{
+  std::vector<int> result;
+  for(const auto& element : container)
+    result.push_back(*element);
+
+  return result;
+}
+
+} // anonymous namespace
+
+SCENARIO("Small vector storage")
+{
+  using Vector = rmf_traffic::internal::SmallVector<std::shared_ptr<int>, 3>;
+
+  Vector vec;
+  CHECK(vec.empty());
+  CHECK(vec.is_inline());
+
+  WHEN("Elements fit inside the inline capacity")
+  {
+    vec.emplace_back(std::make_shared<int>(1));
+    vec.emplace_back(std::make_shared<int>(3));
+    vec.emplace(vec.begin() + 1, std::make_shared<int>(2));
+
+    THEN("No heap storage is used")
+    {
+      CHECK(vec.is_inline());
+      CHECK(values(vec) == std::vector<int>({1, 2, 3}));
+    }
+
+    THEN("Copies and moves preserve the elements")
+    {
+      Vector copy = vec;
+      CHECK(values(copy) == std::vector<int>({1, 2, 3}));
+      CHECK(copy.front() == vec.front());
+
+      Vector moved = std::move(copy);
+      CHECK(copy.empty());
+      CHECK(moved.is_inline());
+      CHECK(values(moved) == std::vector<int>({1, 2, 3}));
+      CHECK(vec.front().use_count() == 2);
+    }
+  }
+
+  WHEN("Elements exceed the inline capacity")
+  {
+    for(int i=0; i < 10; ++i)
+      vec.emplace(vec.begin(), std::make_shared<int>(i));
+
+    THEN("The elements move to the heap in order")
+    {
+      CHECK(!vec.is_inline());
+      CHECK(vec.size() == 10);
+      CHECK(values(vec)
+            == std::vector<int>({9, 8, 7, 6, 5, 4, 3, 2, 1, 0}));
+    }
+
+    THEN("Erasing elements keeps the rest in order")
+    {
+      const auto kept = vec[9];
+      vec.erase(vec.begin() + 2, vec.begin() + 5);
+      vec.erase(vec.begin());
+      CHECK(values(vec) == std::vector<int>({8, 4, 3, 2, 1, 0}));
+      CHECK(kept.use_count() == 2);
+
+      vec.clear();
+      CHECK(vec.empty());
+      CHECK(kept.use_count() == 1);
+    }
+
+    THEN("Moving steals the heap storage")
+    {
+      const int* const first = vec.front().get();
+      Vector moved = std::move(vec);
+      CHECK(vec.empty());
+      CHECK(vec.is_inline());
+      CHECK(moved.front().get() == first);
+      CHECK(moved.size() == 10);
+    }
+  }
+}
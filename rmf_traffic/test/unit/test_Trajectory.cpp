@@ -866,6 +866,22 @@ SCENARIO("Trajectory and base_iterator unit tests")
       }
     }
 
+    WHEN("Erasing an empty range at the end using range notation")
+    {
+      THEN("Nothing is erased and end() is returned")
+      {
+        CHECK(trajectory.size() == 3);
+        const rmf_traffic::Trajectory::iterator next_it =
+            trajectory.erase(trajectory.end(), trajectory.end());
+        CHECK(trajectory.size() == 3);
+        CHECK(next_it == trajectory.end());
+
+        rmf_traffic::Trajectory empty("test_map");
+        CHECK(empty.erase(empty.begin(), empty.end()) == empty.end());
+        CHECK(empty.size() == 0);
+      }
+    }
+
     WHEN("Erasing the first segment using range notation")
     {
       THEN("1 Segment is erased and trajectory is rearranged")
@@ -1039,3 +1055,509 @@ SCENARIO("Trajectory and base_iterator unit tests")
     }
   }
 }
+
+SCENARIO("Trajectory iterators remain valid while the trajectory changes")
+{
+  using Debug = rmf_traffic::Trajectory::Debug;
+
+  const rmf_traffic::Time time = std::chrono::steady_clock::now();
+  const auto profile = create_test_profile(
+        UnitBox, rmf_traffic::Trajectory::Profile::Autonomy::Guided);
+
+  rmf_traffic::Trajectory trajectory("test_map");
+  for(std::size_t i=0; i < 5; ++i)
+  {
+    trajectory.insert(
+          time + std::chrono::seconds(10*i), profile,
+          Eigen::Vector3d(static_cast<double>(i), 0, 0),
+          Eigen::Vector3d::Zero());
+  }
+
+  const rmf_traffic::Trajectory::iterator first = trajectory.begin();
+  const rmf_traffic::Trajectory::iterator third = trajectory.find(time + 20s);
+  const rmf_traffic::Trajectory::iterator last = trajectory.find(time + 40s);
+  rmf_traffic::Trajectory::Segment& third_segment = *third;
+
+  WHEN("Segments are inserted into the middle of the trajectory")
+  {
+    for(std::size_t i=0; i < 20; ++i)
+    {
+      trajectory.insert(
+            time + 1s + std::chrono::milliseconds(100*i), profile,
+            Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero());
+    }
+
+    THEN("Existing iterators and references still refer to their segments")
+    {
+      CHECK(trajectory.size() == 25);
+      CHECK(Debug::check_iterator_time_consistency(trajectory, true));
+      CHECK(first == trajectory.begin());
+      CHECK(third == trajectory.find(time + 20s));
+      CHECK(&third_segment == &(*third));
+      CHECK(third->get_finish_position().x() == Approx(2.0));
+      CHECK(++rmf_traffic::Trajectory::iterator(last) == trajectory.end());
+      CHECK(--rmf_traffic::Trajectory::iterator(third) == trajectory.find(time + 10s));
+    }
+  }
+
+  WHEN("Other segments are erased")
+  {
+    trajectory.erase(trajectory.find(time + 10s));
+    trajectory.erase(last);
+
+    THEN("Existing iterators and references still refer to their segments")
+    {
+      CHECK(trajectory.size() == 3);
+      CHECK(Debug::check_iterator_time_consistency(trajectory, true));
+      CHECK(&third_segment == &(*third));
+      CHECK(--rmf_traffic::Trajectory::iterator(third) == first);
+      CHECK(--trajectory.end() == trajectory.find(time + 30s));
+    }
+  }
+
+  WHEN("Segments are moved by changing their finish times")
+  {
+    third->set_finish_time(time + 35s);
+    first->set_finish_time(time + 45s);
+    trajectory.find(time + 30s)->set_finish_time(time - 5s);
+
+    THEN("The iterators follow their segments to their new positions")
+    {
+      CHECK(trajectory.size() == 5);
+      CHECK(Debug::check_iterator_time_consistency(trajectory, true));
+      CHECK(trajectory.begin()->get_finish_position().x() == Approx(3.0));
+      CHECK(third == trajectory.find(time + 35s));
+      CHECK(++rmf_traffic::Trajectory::iterator(third) == last);
+      CHECK(++rmf_traffic::Trajectory::iterator(last) == first);
+      CHECK(first == --trajectory.end());
+      CHECK(third_segment.get_finish_position().x() == Approx(2.0));
+    }
+  }
+}
+
+SCENARIO("Trajectory copies do not affect each other")
+{
+  using Debug = rmf_traffic::Trajectory::Debug;
+
+  const rmf_traffic::Time time = std::chrono::steady_clock::now();
+  const auto profile = create_test_profile(
+        UnitBox, rmf_traffic::Trajectory::Profile::Autonomy::Guided);
+
+  rmf_traffic::Trajectory original("test_map");
+  for(std::size_t i=0; i < 4; ++i)
+  {
+    original.insert(
+          time + std::chrono::seconds(10*i), profile,
+          Eigen::Vector3d(static_cast<double>(i), 0, 0),
+          Eigen::Vector3d::Zero());
+  }
+
+  // Grab an iterator into the original before any copies are made
+  const rmf_traffic::Trajectory::iterator original_it = original.find(time + 10s);
+
+  rmf_traffic::Trajectory copy = original;
+  const rmf_traffic::Trajectory& const_copy = copy;
+  CHECK(const_copy.begin()->get_finish_position().x() == Approx(0.0));
+  CHECK(&(*const_copy.begin()) != &(*original.begin()));
+
+  WHEN("The original is modified through an old iterator")
+  {
+    original_it->set_finish_position(Eigen::Vector3d(10, 0, 0));
+    original_it->adjust_finish_times(5s);
+
+    THEN("Only the original changes")
+    {
+      CHECK(original.find(time + 15s)->get_finish_position().x()
+            == Approx(10.0));
+      CHECK(*original.finish_time() == time + 35s);
+      CHECK(copy.find(time + 10s)->get_finish_position().x() == Approx(1.0));
+      CHECK(*copy.finish_time() == time + 30s);
+      CHECK(Debug::check_iterator_time_consistency(original, true));
+      CHECK(Debug::check_iterator_time_consistency(copy, true));
+    }
+  }
+
+  WHEN("The copy is modified")
+  {
+    copy.erase(copy.begin());
+    copy.insert(time + 40s, profile,
+                Eigen::Vector3d(4, 0, 0), Eigen::Vector3d::Zero());
+    copy.find(time + 20s)->set_finish_time(time + 50s);
+
+    THEN("Only the copy changes")
+    {
+      CHECK(original.size() == 4);
+      CHECK(*original.start_time() == time);
+      CHECK(*original.finish_time() == time + 30s);
+      CHECK(original_it->get_finish_position().x() == Approx(1.0));
+
+      CHECK(copy.size() == 4);
+      CHECK(*copy.start_time() == time + 10s);
+      CHECK(*copy.finish_time() == time + 50s);
+      CHECK(copy.back().get_finish_position().x() == Approx(2.0));
+      CHECK(Debug::check_iterator_time_consistency(original, true));
+      CHECK(Debug::check_iterator_time_consistency(copy, true));
+    }
+  }
+
+  WHEN("A copy is assigned over another trajectory")
+  {
+    rmf_traffic::Trajectory other("other_map");
+    other = copy;
+    other.front().set_finish_position(Eigen::Vector3d(-1, 0, 0));
+
+    THEN("Only the assigned trajectory changes")
+    {
+      CHECK(other.get_map_name() == "test_map");
+      CHECK(other.size() == 4);
+      CHECK(other.front().get_finish_position().x() == Approx(-1.0));
+      CHECK(copy.front().get_finish_position().x() == Approx(0.0));
+      CHECK(original.front().get_finish_position().x() == Approx(0.0));
+    }
+  }
+}
+
+SCENARIO("Trajectory views")
+{
+  const rmf_traffic::Time time = std::chrono::steady_clock::now();
+  const auto profile = create_test_profile(
+        UnitBox, rmf_traffic::Trajectory::Profile::Autonomy::Guided);
+
+  rmf_traffic::Trajectory trajectory("test_map");
+  for(std::size_t i=0; i < 5; ++i)
+  {
+    trajectory.insert(
+          time + std::chrono::seconds(10*i), profile,
+          Eigen::Vector3d(static_cast<double>(i), 0, 0),
+          Eigen::Vector3d::Zero());
+  }
+
+  WHEN("Viewing the whole trajectory")
+  {
+    const rmf_traffic::Trajectory::View view(trajectory);
+
+    THEN("The view matches the trajectory")
+    {
+      CHECK(!view.empty());
+      CHECK(view.size() == 5);
+      CHECK(view.begin() == trajectory.begin());
+      CHECK(view.end() == trajectory.end());
+      CHECK(*view.start_time() == time);
+      CHECK(*view.finish_time() == time + 40s);
+      CHECK(view.duration() == 40s);
+    }
+  }
+
+  WHEN("Viewing a window inside of the trajectory")
+  {
+    const rmf_traffic::Trajectory::View view(trajectory, time + 15s, time + 25s);
+
+    THEN("The view covers the segments whose motion overlaps the window")
+    {
+      CHECK(view.size() == 2);
+      CHECK(view.begin() == trajectory.find(time + 20s));
+      CHECK(view.end() == trajectory.find(time + 40s));
+      CHECK(*view.start_time() == time + 15s);
+      CHECK(*view.finish_time() == time + 25s);
+      CHECK(&view.get_trajectory() == &trajectory);
+
+      std::size_t count = 0;
+      for(const auto& segment : view)
+      {
+        CHECK(segment.get_finish_time() >= time + 20s);
+        ++count;
+      }
+      CHECK(count == view.size());
+    }
+  }
+
+  WHEN("Viewing a window that extends past the trajectory")
+  {
+    const rmf_traffic::Trajectory::View view(trajectory, time + 35s, time + 60s);
+
+    THEN("The window is clipped")
+    {
+      CHECK(view.size() == 1);
+      CHECK(*view.finish_time() == time + 40s);
+      CHECK(view.end() == trajectory.end());
+    }
+  }
+
+  WHEN("Viewing a window outside of the trajectory")
+  {
+    const rmf_traffic::Trajectory::View view(trajectory, time + 50s, time + 60s);
+    const rmf_traffic::Trajectory empty_trajectory("test_map");
+    const rmf_traffic::Trajectory::View empty_view(empty_trajectory);
+
+    THEN("The view is empty")
+    {
+      CHECK(view.empty());
+      CHECK(view.size() == 0);
+      CHECK(view.begin() == view.end());
+      CHECK(view.start_time() == nullptr);
+      CHECK(empty_view.empty());
+      CHECK(empty_view.begin() == empty_trajectory.end());
+    }
+  }
+}
+
+SCENARIO("Bulk trajectory construction")
+{
+  using Debug = rmf_traffic::Trajectory::Debug;
+
+  const rmf_traffic::Time time = std::chrono::steady_clock::now();
+  const auto profile = create_test_profile(
+        UnitBox, rmf_traffic::Trajectory::Profile::Autonomy::Guided);
+
+  const auto position = [](const double x) { return Eigen::Vector3d(x, 0, 0); };
+
+  rmf_traffic::Trajectory trajectory("test_map");
+  trajectory.reserve(10);
+  for(std::size_t i=0; i < 10; ++i)
+  {
+    trajectory.push_back(
+          time + std::chrono::seconds(i), profile,
+          position(static_cast<double>(i)), Eigen::Vector3d::Zero());
+  }
+
+  CHECK(trajectory.size() == 10);
+  CHECK(*trajectory.start_time() == time);
+  CHECK(*trajectory.finish_time() == time + 9s);
+  CHECK(Debug::check_iterator_time_consistency(trajectory, true));
+
+  WHEN("Segments are pushed back out of order")
+  {
+    trajectory.push_back(time + 500ms, profile, position(0.5),
+                         Eigen::Vector3d::Zero());
+    trajectory.push_back(time + 3s, profile, position(-1.0),
+                         Eigen::Vector3d::Zero());
+
+    THEN("They behave like insert()")
+    {
+      CHECK(trajectory.size() == 11);
+      CHECK(trajectory.find(time + 500ms)->get_finish_position().x()
+            == Approx(0.5));
+      CHECK(trajectory.find(time + 3s)->get_finish_position().x()
+            == Approx(3.0));
+      CHECK(Debug::check_iterator_time_consistency(trajectory, true));
+    }
+  }
+
+  WHEN("Another trajectory is appended at its joining point")
+  {
+    rmf_traffic::Trajectory next("test_map");
+    for(std::size_t i=9; i < 15; ++i)
+    {
+      next.push_back(
+            time + std::chrono::seconds(i), profile,
+            position(10.0 + static_cast<double>(i)), Eigen::Vector3d::Zero());
+    }
+
+    const rmf_traffic::Trajectory::iterator last = --trajectory.end();
+    trajectory.append(next);
+
+    THEN("The segments are joined end to end")
+    {
+      CHECK(trajectory.size() == 15);
+      CHECK(next.size() == 6);
+      CHECK(*trajectory.finish_time() == time + 14s);
+      CHECK(last->get_finish_position().x() == Approx(9.0));
+      CHECK((++rmf_traffic::Trajectory::iterator(last))->get_finish_time()
+            == time + 10s);
+      CHECK(Debug::check_iterator_time_consistency(trajectory, true));
+    }
+  }
+
+  WHEN("An overlapping trajectory is appended")
+  {
+    rmf_traffic::Trajectory overlap("test_map");
+    overlap.push_back(time + 5s, profile, position(0.0),
+                      Eigen::Vector3d::Zero());
+    overlap.push_back(time + 20s, profile, position(0.0),
+                      Eigen::Vector3d::Zero());
+
+    THEN("An exception is thrown and nothing changes")
+    {
+      CHECK_THROWS_AS(trajectory.append(overlap), std::invalid_argument);
+      CHECK(trajectory.size() == 10);
+      CHECK(*trajectory.finish_time() == time + 9s);
+    }
+  }
+
+  WHEN("A trajectory is appended to an empty trajectory")
+  {
+    rmf_traffic::Trajectory empty("test_map");
+    empty.append(trajectory);
+    empty.front().set_finish_position(position(-5.0));
+
+    THEN("The empty trajectory becomes an independent copy")
+    {
+      CHECK(empty.size() == 10);
+      CHECK(empty.front().get_finish_position().x() == Approx(-5.0));
+      CHECK(trajectory.front().get_finish_position().x() == Approx(0.0));
+      CHECK(Debug::check_iterator_time_consistency(empty, true));
+    }
+  }
+}
+
+SCENARIO("Hinted trajectory lookups")
+{
+  const rmf_traffic::Time time = std::chrono::steady_clock::now();
+  const auto profile = create_test_profile(
+        UnitBox, rmf_traffic::Trajectory::Profile::Autonomy::Guided);
+
+  rmf_traffic::Trajectory trajectory("test_map");
+  for(std::size_t i=0; i < 40; ++i)
+  {
+    const double x = static_cast<double>(i);
+    trajectory.push_back(
+          time + std::chrono::seconds(i), profile,
+          Eigen::Vector3d(x, x*x, 0), Eigen::Vector3d(1, 2*x, 0));
+  }
+
+  std::vector<rmf_traffic::Time> times;
+  for(int i=-2; i < 42*4; ++i)
+    times.push_back(time + std::chrono::milliseconds(250*i));
+
+  WHEN("Any hint is given to find()")
+  {
+    std::vector<rmf_traffic::Trajectory::const_iterator> hints;
+    for(auto it = trajectory.cbegin(); it != trajectory.cend(); ++it)
+      hints.push_back(it);
+    hints.push_back(trajectory.cend());
+
+    THEN("The result matches find() without a hint")
+    {
+      for(const auto& t : times)
+      {
+        const auto expected = trajectory.find(t);
+        for(const auto& hint : hints)
+          CHECK(trajectory.find(t, hint) == expected);
+      }
+    }
+  }
+
+  WHEN("Positions are sampled in a batch")
+  {
+    std::vector<rmf_traffic::Time> in_range;
+    for(const auto& t : times)
+    {
+      if(*trajectory.start_time() <= t && t <= *trajectory.finish_time())
+        in_range.push_back(t);
+    }
+
+    const auto positions = trajectory.sample_positions(in_range);
+
+    THEN("They match the motion of each segment")
+    {
+      REQUIRE(positions.size() == in_range.size());
+      for(std::size_t i=0; i < in_range.size(); ++i)
+      {
+        const auto it = trajectory.find(in_range[i]);
+        REQUIRE(it != trajectory.end());
+        const Eigen::Vector3d expected =
+            it->compute_motion()->compute_position(in_range[i]);
+        CHECK((positions[i] - expected).norm() == Approx(0.0).margin(1e-9));
+      }
+    }
+
+    THEN("Times outside of the trajectory are rejected")
+    {
+      CHECK_THROWS_AS(trajectory.sample_positions({times.front()}),
+                      std::invalid_argument);
+      CHECK_THROWS_AS(trajectory.sample_positions({times.back()}),
+                      std::invalid_argument);
+    }
+  }
+}
+
+SCENARIO("Copies that are delayed from a middle segment")
+{
+  using Debug = rmf_traffic::Trajectory::Debug;
+
+  const rmf_traffic::Time time = std::chrono::steady_clock::now();
+  const auto profile = create_test_profile(
+        UnitBox, rmf_traffic::Trajectory::Profile::Autonomy::Guided);
+
+  rmf_traffic::Trajectory original("test_map");
+  for(std::size_t i=0; i < 10; ++i)
+  {
+    original.insert(
+          time + std::chrono::seconds(10*i), profile,
+          Eigen::Vector3d(static_cast<double>(i), 0, 0),
+          Eigen::Vector3d::Zero());
+  }
+
+  rmf_traffic::Trajectory delayed = original;
+  CHECK(Debug::count_shared_segments(original, delayed) == 10);
+
+  delayed.find(time + 60s)->adjust_finish_times(5s);
+
+  const auto finish_times = [](const rmf_traffic::Trajectory& trajectory)
+  {
+    std::vector<rmf_traffic::Time> times;
+    for(const auto& segment : trajectory)
+      times.push_back(segment.get_finish_time());
+
+    return times;
+  };
+
+  std::vector<rmf_traffic::Time> expected;
+  for(std::size_t i=0; i < 10; ++i)
+    expected.push_back(time + std::chrono::seconds(10*i + (i < 6? 0 : 5)));
+
+  CHECK(finish_times(delayed) == expected);
+  CHECK(Debug::count_shared_segments(original, delayed) == 6);
+  CHECK(Debug::check_iterator_time_consistency(delayed, true));
+  CHECK(*original.finish_time() == time + 90s);
+
+  WHEN("The copy is delayed from an earlier segment")
+  {
+    delayed.find(time + 20s)->adjust_finish_times(1s);
+    for(std::size_t i=2; i < 10; ++i)
+      expected[i] += 1s;
+
+    THEN("Only the segments before that one are still shared")
+    {
+      CHECK(finish_times(delayed) == expected);
+      CHECK(Debug::count_shared_segments(original, delayed) == 2);
+      CHECK(Debug::check_iterator_time_consistency(delayed, true));
+    }
+  }
+
+  WHEN("Segments are inserted into and erased from the copy")
+  {
+    delayed.insert(time + 15s, profile, Eigen::Vector3d::Zero(),
+                   Eigen::Vector3d::Zero());
+    expected.insert(expected.begin() + 2, time + 15s);
+    CHECK(finish_times(delayed) == expected);
+    CHECK(Debug::count_shared_segments(original, delayed) == 0);
+
+    delayed.erase(delayed.find(time + 15s));
+    expected.erase(expected.begin() + 2);
+
+    THEN("The copy has every segment and the original is unchanged")
+    {
+      CHECK(finish_times(delayed) == expected);
+      CHECK(Debug::check_iterator_time_consistency(delayed, true));
+      CHECK(original.size() == 10);
+      CHECK(*original.finish_time() == time + 90s);
+    }
+  }
+
+  WHEN("Motions and samples are computed across the shared boundary")
+  {
+    const auto motion = delayed.find(time + 60s)->compute_motion();
+    CHECK((motion->compute_position(time + 50s)
+           - Eigen::Vector3d(5, 0, 0)).norm() == Approx(0.0).margin(1e-9));
+    CHECK((motion->compute_position(time + 65s)
+           - Eigen::Vector3d(6, 0, 0)).norm() == Approx(0.0).margin(1e-9));
+
+    const auto positions = delayed.sample_positions({time + 50s, time + 65s});
+    REQUIRE(positions.size() == 2);
+    CHECK((positions[0] - Eigen::Vector3d(5, 0, 0)).norm()
+          == Approx(0.0).margin(1e-9));
+    CHECK((positions[1] - Eigen::Vector3d(6, 0, 0)).norm()
+          == Approx(0.0).margin(1e-9));
+  }
+}
@@ -128,4 +128,33 @@ inline rmf_traffic::Trajectory make_test_trajectory(rmf_traffic::Time t, int len
   return trajectory;
 }
 
+//==============================================================================
+/// The profile of a guided circular robot with a radius of 0.5
+inline rmf_traffic::Trajectory::ProfilePtr make_schedule_test_profile()
+{
+  return rmf_traffic::Trajectory::Profile::make_guided(
+        rmf_traffic::geometry::make_final_convex<
+          rmf_traffic::geometry::Circle>(0.5));
+}
+
+//==============================================================================
+/// A trajectory where a robot with the profile of make_schedule_test_profile()
+/// drives from (0, y) to (length, y), starting and stopping at rest. This is
+/// meant for tests that need to fill a schedule with many simple trajectories.
+inline rmf_traffic::Trajectory make_row_trajectory(
+    const std::string& map,
+    const double y,
+    const rmf_traffic::Time start,
+    const rmf_traffic::Duration duration = std::chrono::seconds(90),
+    const double length = 10.0)
+{
+  const auto profile = make_schedule_test_profile();
+  rmf_traffic::Trajectory trajectory(map);
+  trajectory.insert(start, profile, Eigen::Vector3d(0, y, 0),
+                    Eigen::Vector3d::Zero());
+  trajectory.insert(start + duration, profile, Eigen::Vector3d(length, y, 0),
+                    Eigen::Vector3d::Zero());
+  return trajectory;
+}
+
 #endif // RMF_TRAFFIC__TEST__UNIT__UTILS_TRAJECTORY_HPP
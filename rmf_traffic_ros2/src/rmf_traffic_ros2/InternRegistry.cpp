@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include "InternRegistry.hpp"
+
+#include <rmf_traffic/geometry/Box.hpp>
+#include <rmf_traffic/geometry/Circle.hpp>
+
+#include <rmf_traffic_msgs/msg/trajectory_profile.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <tuple>
+
+namespace rmf_traffic_ros2 {
+namespace internal {
+
+namespace {
+//==============================================================================
+/// A thread-safe map from keys to weakly held values. Values are kept alive by
+/// whoever is using them, so the registry never holds onto geometry that no
+/// trajectory refers to anymore.
+template<typename Key, typename Value>
+class WeakRegistry
+{
+public:
+
+  using ValuePtr = std::shared_ptr<const Value>;
+
+  template<typename Factory>
+  ValuePtr get(const Key& key, Factory&& factory)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::weak_ptr<const Value>& entry = _entries[key];
+    if(ValuePtr value = entry.lock())
+      return value;
+
+    ValuePtr value = factory();
+    entry = value;
+
+    // Occasionally sweep out the entries whose values have expired, so that
+    // the registry does not grow forever while a system runs.
+    if(_entries.size() >= 2*_last_sweep_size)
+    {
+      for(auto it = _entries.begin(); it != _entries.end();)
+      {
+        if(it->second.expired())
+          it = _entries.erase(it);
+        else
+          ++it;
+      }
+
+      _last_sweep_size = std::max<std::size_t>(16, _entries.size());
+    }
+
+    return value;
+  }
+
+private:
+  std::mutex _mutex;
+  std::map<Key, std::weak_ptr<const Value>> _entries;
+  std::size_t _last_sweep_size = 16;
+};
+
+//==============================================================================
+using ShapeRegistry = WeakRegistry<
+    std::array<double, 2>, rmf_traffic::geometry::FinalConvexShape>;
+
+//==============================================================================
+ShapeRegistry& box_registry()
+{
+  static ShapeRegistry registry;
+  return registry;
+}
+
+//==============================================================================
+ShapeRegistry& circle_registry()
+{
+  static ShapeRegistry registry;
+  return registry;
+}
+
+//==============================================================================
+using ProfileKey = std::tuple<
+    const rmf_traffic::geometry::FinalConvexShape*, uint16_t, std::string>;
+
+using ProfileRegistry = WeakRegistry<
+    ProfileKey, rmf_traffic::Trajectory::Profile>;
+
+//==============================================================================
+ProfileRegistry& profile_registry()
+{
+  static ProfileRegistry registry;
+  return registry;
+}
+
+} // anonymous namespace
+
+//==============================================================================
+rmf_traffic::geometry::ConstFinalConvexShapePtr intern_box(
+    const double x_length, const double y_length)
+{
+  const auto make_box = [&]()
+  {
+    return rmf_traffic::geometry::make_final_convex<
+        rmf_traffic::geometry::Box>(x_length, y_length);
+  };
+
+  // NaN cannot be ordered, so it would break the registry's map. A shape with
+  // a size that is not finite is not worth sharing anyway.
+  if(!std::isfinite(x_length) || !std::isfinite(y_length))
+    return make_box();
+
+  return box_registry().get({x_length, y_length}, make_box);
+}
+
+//==============================================================================
+rmf_traffic::geometry::ConstFinalConvexShapePtr intern_circle(
+    const double radius)
+{
+  const auto make_circle = [&]()
+  {
+    return rmf_traffic::geometry::make_final_convex<
+        rmf_traffic::geometry::Circle>(radius);
+  };
+
+  if(!std::isfinite(radius))
+    return make_circle();
+
+  return circle_registry().get({radius, 0.0}, make_circle);
+}
+
+//==============================================================================
+rmf_traffic::Trajectory::ConstProfilePtr intern_profile(
+    const rmf_traffic::geometry::ConstFinalConvexShapePtr& shape,
+    const uint16_t autonomy,
+    const std::string& queue_id)
+{
+  using rmf_traffic_msgs::msg::TrajectoryProfile;
+  using Profile = rmf_traffic::Trajectory::Profile;
+  using ConstProfilePtr = rmf_traffic::Trajectory::ConstProfilePtr;
+
+  if(TrajectoryProfile::GUIDED != autonomy
+     && TrajectoryProfile::QUEUED != autonomy
+     && TrajectoryProfile::AUTONOMOUS != autonomy)
+  {
+    throw std::runtime_error(
+          "Invalid trajectory profile autonomy type: "
+          + std::to_string(autonomy));
+  }
+
+  // A live profile keeps its shape alive, so the address of the shape cannot
+  // be reused by a different shape while the entry for that profile is valid.
+  const bool queued = TrajectoryProfile::QUEUED == autonomy;
+  ProfileKey key{shape.get(), autonomy, queued? queue_id : std::string()};
+
+  return profile_registry().get(key, [&]() -> ConstProfilePtr
+  {
+    if(TrajectoryProfile::GUIDED == autonomy)
+      return Profile::make_guided(shape);
+
+    if(queued)
+      return Profile::make_queued(shape, queue_id);
+
+    return Profile::make_autonomous(shape);
+  });
+}
+
+} // namespace internal
+} // namespace rmf_traffic_ros2
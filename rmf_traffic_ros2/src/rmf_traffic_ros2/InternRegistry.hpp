@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef SRC__RMF_TRAFFIC_ROS2__INTERNREGISTRY_HPP
+#define SRC__RMF_TRAFFIC_ROS2__INTERNREGISTRY_HPP
+
+#include <rmf_traffic/Trajectory.hpp>
+#include <rmf_traffic/geometry/ConvexShape.hpp>
+
+#include <cstdint>
+#include <string>
+
+namespace rmf_traffic_ros2 {
+namespace internal {
+
+//==============================================================================
+/// Get the one shared Box with the given dimensions. Every message that
+/// describes a box of the same size will be given the same shape object, so
+/// they all share a single copy of the collision geometry.
+///
+/// Dimensions that are not finite numbers are not interned, so each call with
+/// them will create a new shape.
+rmf_traffic::geometry::ConstFinalConvexShapePtr intern_box(
+    double x_length, double y_length);
+
+//==============================================================================
+/// Get the one shared Circle with the given radius. Like intern_box(), a
+/// radius that is not finite will not be interned.
+rmf_traffic::geometry::ConstFinalConvexShapePtr intern_circle(double radius);
+
+//==============================================================================
+/// Get the one shared Profile with the given shape, autonomy, and queue ID.
+/// The shape should itself come from intern_box() or intern_circle(), because
+/// shapes are identified by their address.
+///
+/// The queue_id is ignored unless the autonomy is QUEUED. An exception is
+/// thrown if the autonomy value is not recognized.
+rmf_traffic::Trajectory::ConstProfilePtr intern_profile(
+    const rmf_traffic::geometry::ConstFinalConvexShapePtr& shape,
+    uint16_t autonomy,
+    const std::string& queue_id);
+
+} // namespace internal
+} // namespace rmf_traffic_ros2
+
+#endif // SRC__RMF_TRAFFIC_ROS2__INTERNREGISTRY_HPP
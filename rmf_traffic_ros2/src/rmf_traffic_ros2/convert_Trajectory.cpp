@@ -21,6 +21,8 @@
 #include <rmf_traffic/geometry/Box.hpp>
 #include <rmf_traffic/geometry/Circle.hpp>
 
+#include "InternRegistry.hpp"
+
 #include <unordered_map>
 #include <vector>
 
@@ -50,41 +52,21 @@ rmf_traffic::Trajectory convert(const rmf_traffic_msgs::msg::Trajectory& from)
 
   geometry::ConvexShapeContext context = convert(from.convex_shape_context);
 
-  std::vector<rmf_traffic::Trajectory::ProfilePtr> profiles;
+  // Profiles are interned, so identical profiles from different messages are
+  // all represented by the same object.
+  std::vector<rmf_traffic::Trajectory::ConstProfilePtr> profiles;
   profiles.reserve(from.profiles.size());
   for(const auto& profile : from.profiles)
   {
-    using rmf_traffic_msgs::msg::ConvexShape;
-    const auto shape = context.at(profile.shape);
-
-    using rmf_traffic_msgs::msg::TrajectoryProfile;
-    if(TrajectoryProfile::GUIDED == profile.autonomy)
-    {
-      profiles.emplace_back(
-            rmf_traffic::Trajectory::Profile::make_guided(shape));
-    }
-    else if(TrajectoryProfile::QUEUED == profile.autonomy)
-    {
-      profiles.emplace_back(
-            rmf_traffic::Trajectory::Profile::make_queued(
-              shape, profile.queue_id));
-    }
-    else if(TrajectoryProfile::AUTONOMOUS == profile.autonomy)
-    {
-      profiles.emplace_back(
-            rmf_traffic::Trajectory::Profile::make_autonomous(shape));
-    }
-    else
-    {
-      throw std::runtime_error(
-            "Invalid trajectory profile autonomy type: "
-            + std::to_string(profile.autonomy));
-    }
+    profiles.emplace_back(
+          internal::intern_profile(
+            context.at(profile.shape), profile.autonomy, profile.queue_id));
   }
 
+  output.reserve(from.segments.size());
   for(const auto& segment : from.segments)
   {
-    output.insert(
+    output.push_back(
           rmf_traffic::Time(rmf_traffic::Duration(segment.finish_time)),
           profiles.at(segment.profile_index),
           to_eigen(segment.finish_position),
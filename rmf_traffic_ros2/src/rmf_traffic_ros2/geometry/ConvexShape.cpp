@@ -20,6 +20,7 @@
 #include <rmf_traffic_ros2/geometry/Circle.hpp>
 
 #include "ShapeInternal.hpp"
+#include "../InternRegistry.hpp"
 
 namespace rmf_traffic_ros2 {
 namespace geometry {
@@ -46,6 +47,11 @@ public:
   {
     return *parent._pimpl;
   }
+
+  static Implementation& get(ConvexShapeContext& parent)
+  {
+    return *parent._pimpl;
+  }
 };
 
 //==============================================================================
@@ -75,14 +81,21 @@ rmf_traffic::geometry::ConstFinalConvexShapePtr ConvexShapeContext::at(
 geometry::ConvexShapeContext convert(
     const rmf_traffic_msgs::msg::ConvexShapeContext& from)
 {
-  using namespace rmf_traffic::geometry;
+  using rmf_traffic_msgs::msg::ConvexShape;
 
+  // Shapes are interned so that every message which describes the same shape
+  // shares a single copy of its collision geometry.
   geometry::ConvexShapeContext context;
+  auto& impl = geometry::ConvexShapeContext::Implementation::get(context);
   for(const auto& box : from.boxes)
-    context.insert(make_final_convex<Box>(convert(box)));
+  {
+    impl.append(
+          internal::intern_box(box.dimensions[0], box.dimensions[1]),
+          ConvexShape::BOX);
+  }
 
   for(const auto& circle : from.circles)
-    context.insert(make_final_convex<Circle>(convert(circle)));
+    impl.append(internal::intern_circle(circle.radius), ConvexShape::CIRCLE);
 
   return context;
 }
@@ -118,6 +118,18 @@ public:
     return std::move(shape_msg);
   }
 
+  /// Add a shape to the end of the bucket for the given type, even if the
+  /// same shape is already in the context. This keeps the indices of a context
+  /// that is being read from a message aligned with the message, even when the
+  /// message describes the same shape more than once.
+  void append(ShapeTypePtr shape, const std::size_t type)
+  {
+    std::vector<ShapeTypePtr>& derived_shapes = shapes.at(type);
+    entry_map.insert(
+          std::make_pair(shape, Entry{type, derived_shapes.size()}));
+    derived_shapes.emplace_back(std::move(shape));
+  }
+
   ShapeTypePtr at(const ShapeMsgType& shape) const
   {
     const std::vector<ShapeTypePtr>& bucket = shapes.at(shape.type);
@@ -18,38 +18,43 @@
 #include "ScheduleNode.hpp"
 
 #include <rmf_traffic_ros2/StandardNames.hpp>
+#include <rmf_traffic_ros2/Time.hpp>
 #include <rmf_traffic_ros2/Trajectory.hpp>
 #include <rmf_traffic_ros2/schedule/Query.hpp>
 #include <rmf_traffic_ros2/schedule/Patch.hpp>
 
 #include <rmf_traffic/Conflict.hpp>
-#include <rmf_traffic/schedule/Mirror.hpp>
 
 #include <rmf_utils/optional.hpp>
 
+#include <algorithm>
+#include <thread>
+
 namespace rmf_traffic_schedule {
 
 //==============================================================================
 std::unordered_set<rmf_traffic::schedule::Version> get_conflicts(
-    const rmf_traffic::schedule::Viewer::View& view)
+    const rmf_traffic::schedule::Viewer::View& view,
+    const std::size_t num_threads)
 {
   // TODO(MXG): Make this function more efficient by only checking the latest
   // unchecked changes against the ones that came before them, and then
   // appending that list onto the conflicts of the previous version.
 
+  std::vector<const rmf_traffic::Trajectory*> trajectories;
+  std::vector<rmf_traffic::schedule::Version> versions;
+  for (const auto& element : view)
+  {
+    trajectories.push_back(&element.trajectory);
+    versions.push_back(element.id);
+  }
+
   std::unordered_set<rmf_traffic::schedule::Version> conflicts;
-  for (auto v0 = view.begin(); v0 != view.end(); ++v0)
+  for (const auto& pair : rmf_traffic::DetectConflict::all_pairs(
+         trajectories, num_threads))
   {
-    auto v1 = ++rmf_traffic::schedule::Viewer::View::const_iterator{v0};
-    for (; v1 != view.end(); ++v1)
-    {
-      if (!rmf_traffic::DetectConflict::between(
-            v0->trajectory, v1->trajectory, true).empty())
-      {
-        conflicts.insert(v0->id);
-        conflicts.insert(v1->id);
-      }
-    }
+    conflicts.insert(versions[pair.first]);
+    conflicts.insert(versions[pair.second]);
   }
 
   return conflicts;
@@ -59,6 +64,43 @@ std::unordered_set<rmf_traffic::schedule::Version> get_conflicts(
 ScheduleNode::ScheduleNode()
   : Node("rmf_traffic_schedule_node")
 {
+  // The spatial index of the database is disabled unless a cell size is given
+  // for this deployment.
+  database.set_spatial_cell_size(
+        declare_parameter("spatial_cell_size", 0.0));
+
+  // The database compacts the change history that no mirror needs anymore
+  // each time this many new versions have been added.
+  database.set_compaction_interval(static_cast<std::size_t>(
+        declare_parameter("history_compaction_interval", 100)));
+
+  // Trajectories that finished longer ago than the retention period get culled
+  // from the database on a timer. Mirrors receive the cull in their next patch.
+  // Setting either parameter to zero disables the culling.
+  const double retention_period =
+      declare_parameter("cull_retention_period", 600.0);
+  const double cull_check_period =
+      declare_parameter("cull_check_period", 60.0);
+  if(retention_period > 0.0 && cull_check_period > 0.0)
+  {
+    const auto retention =
+        std::chrono::duration_cast<rmf_traffic::Duration>(
+          std::chrono::duration<double>(retention_period));
+
+    cull_timer = create_wall_timer(
+          std::chrono::duration<double>(cull_check_period),
+          [=]() { this->cull(retention); });
+  }
+
+  // Each conflict check spreads its narrow phase across this many threads.
+  // The threads are started and joined on every check, so the default is
+  // capped well below the core count of a large machine.
+  const int default_conflict_check_threads = static_cast<int>(
+        std::min(4u, std::max(1u, std::thread::hardware_concurrency())));
+  conflict_check_threads = static_cast<std::size_t>(std::max(1,
+        declare_parameter(
+          "conflict_check_threads", default_conflict_check_threads)));
+
   // TODO(MXG): As soon as possible, all of these services should be made
   // multi-threaded so they can be parallel processed.
 
@@ -140,19 +182,16 @@ ScheduleNode::ScheduleNode()
   conflict_check_thread = std::thread(
         [&]()
   {
-    rmf_traffic::schedule::Mirror mirror;
-
     Version last_checked_version = 0;
 
     while (rclcpp::ok() && !conflict_check_quit)
     {
-      const auto next_query =
-          rmf_traffic::schedule::make_query(last_checked_version);
-      rmf_utils::optional<rmf_traffic::schedule::Database::Patch> next_patch;
+      rmf_utils::optional<rmf_traffic::schedule::Database::Snapshot> snapshot;
 
-      // Use this scope to minimize how long we lock the database for
+      // Every shard of the database is locked while the snapshot is taken. The
+      // conflicts get checked afterwards without holding up any changes.
       {
-        std::unique_lock<std::mutex> lock(database_mutex);
+        std::unique_lock<std::mutex> lock(conflict_check_mutex);
         conflict_check_cv.wait_for(lock, std::chrono::milliseconds(100), [&]()
         {
           return (database.latest_version() > last_checked_version)
@@ -166,26 +205,28 @@ ScheduleNode::ScheduleNode()
           continue;
         }
 
-        next_patch = database.changes(next_query);
-
-        // TODO(MXG): Check whether the database really needs to remain locked
-        // during this update.
-        try
-        {
-          mirror.update(*next_patch);
-          last_checked_version = next_patch->latest_version();
-        }
-        catch(const std::exception& e)
-        {
-          RCLCPP_ERROR(get_logger(), e.what());
-          continue;
-        }
+        snapshot = database.snapshot();
+        last_checked_version = snapshot->latest_version();
       }
 
-      const auto view = mirror.query(
+      const auto view = snapshot->query(
             rmf_traffic::schedule::query_everything());
 
-      const auto conflicts = get_conflicts(view);
+      std::unordered_set<Version> conflicts;
+      try
+      {
+        conflicts = get_conflicts(view, conflict_check_threads);
+      }
+      catch (const std::exception& e)
+      {
+        RCLCPP_ERROR(
+              get_logger(),
+              "Failed to check schedule version ["
+              + std::to_string(last_checked_version) + "] for conflicts: "
+              + e.what());
+        continue;
+      }
+
       if (!conflicts.empty())
       {
         {
@@ -276,7 +317,13 @@ std::unordered_set<uint64_t> ScheduleNode::process_trajectories(
       throw std::runtime_error(error);
     }
 
-    const auto view = database.query(
+    // Only the shard of this trajectory's map gets locked and copied out of
+    // the database, so the traffic on other maps does not slow this down, and
+    // the shard does not stay locked while we check for conflicts.
+    const auto snapshot =
+        database.snapshot({requested_trajectory.get_map_name()});
+
+    const auto view = snapshot.query(
           rmf_traffic::schedule::make_query(
               {requested_trajectory.get_map_name()},
               requested_trajectory.start_time(),
@@ -377,12 +424,13 @@ void ScheduleNode::submit_trajectories(
 //    return;
 
   {
-    std::unique_lock<std::mutex> lock(database_mutex);
+    rmf_traffic::schedule::Database::Batch batch;
     for(auto&& request : requested_trajectories)
-      database.insert(std::move(request));
+      batch.insert(std::move(request));
+
+    response->current_version = database.apply(std::move(batch));
   }
 
-  response->current_version = database.latest_version();
   wakeup_mirrors();
 
   RCLCPP_INFO(
@@ -398,24 +446,28 @@ void ScheduleNode::perform_replacement(
     uint64_t& latest_trajectory_version,
     uint64_t& current_version)
 {
+  rmf_traffic::schedule::Database::Batch batch;
   std::size_t index=0;
-  std::unique_lock<std::mutex> lock(database_mutex);
   while (index < replace_ids.size() &&
          index < trajectories.size())
   {
-    database.replace(replace_ids[index], std::move(trajectories[index]));
+    batch.replace(replace_ids[index], std::move(trajectories[index]));
     ++index;
   }
 
   for (; index < trajectories.size(); ++index)
-    database.insert(std::move(trajectories[index]));
+    batch.insert(std::move(trajectories[index]));
 
-  latest_trajectory_version = database.latest_version();
+  // The erasures come last in the batch, so the trajectories get the versions
+  // right before them.
+  const std::size_t num_erasures = replace_ids.size() - std::min(
+        replace_ids.size(), trajectories.size());
 
   for (; index < replace_ids.size(); ++index)
-    database.erase(replace_ids[index]);
+    batch.erase(replace_ids[index]);
 
-  current_version = database.latest_version();
+  current_version = database.apply(std::move(batch));
+  latest_trajectory_version = current_version - num_erasures;
 }
 
 //==============================================================================
@@ -488,12 +540,12 @@ void ScheduleNode::delay_trajectories(
   const auto delay = std::chrono::nanoseconds(request->delay);
 
   {
-    std::unique_lock<std::mutex> lock(database_mutex);
+    rmf_traffic::schedule::Database::Batch batch;
     for (const rmf_traffic::schedule::Version id : request->delay_ids)
-      database.delay(id, from_time, delay);
-  }
+      batch.delay(id, from_time, delay);
 
-  response->current_version = database.latest_version();
+    response->current_version = database.apply(std::move(batch));
+  }
 
   wakeup_mirrors();
 }
@@ -505,12 +557,13 @@ void ScheduleNode::erase_trajectories(
     const EraseTrajectories::Response::SharedPtr& response)
 {
   {
-    std::unique_lock<std::mutex> lock(database_mutex);
+    rmf_traffic::schedule::Database::Batch batch;
     for(const uint64_t id : request->erase_ids)
-      database.erase(id);
+      batch.erase(id);
+
+    response->version = database.apply(std::move(batch));
   }
 
-  response->version = database.latest_version();
   wakeup_mirrors();
 }
 
@@ -650,6 +703,30 @@ void ScheduleNode::resolve_conflicts(
   wakeup_mirrors();
 }
 
+//==============================================================================
+void ScheduleNode::cull(const rmf_traffic::Duration retention)
+{
+  const rmf_traffic::Time cull_time =
+      rmf_traffic_ros2::convert(now()) - retention;
+
+  {
+    // The history that no mirror needs anymore gets compacted as the shards
+    // change, so this is a good time to refresh what the mirrors need.
+    std::unique_lock<std::mutex> lock(mirror_versions_mutex);
+    update_oldest_needed_version();
+  }
+
+  const Version original_version = database.latest_version();
+  if(database.cull(cull_time) == original_version)
+  {
+    // Nothing was old enough to be culled, so the mirrors don't need to hear
+    // about this.
+    return;
+  }
+
+  wakeup_mirrors();
+}
+
 //==============================================================================
 void ScheduleNode::register_query(
     const std::shared_ptr<rmw_request_id_t>& /*request_header*/,
@@ -706,6 +783,12 @@ void ScheduleNode::unregister_query(
   registered_queries.erase(it);
   response->confirmation = true;
 
+  {
+    std::unique_lock<std::mutex> lock(mirror_versions_mutex);
+    mirror_versions.erase(request->query_id);
+    update_oldest_needed_version();
+  }
+
   RCLCPP_INFO(
         get_logger(),
         "[" + std::to_string(request->query_id) + "] Unregistered query");
@@ -732,9 +815,44 @@ void ScheduleNode::mirror_update(
         request->latest_mirror_version);
   query.spacetime() = query_it->second;
 
+  {
+    // A mirror that does not know about any version yet will be brought up to
+    // the latest version by this patch. If the patch never reaches it, it will
+    // ask from version 0 again, which is always safe.
+    std::unique_lock<std::mutex> lock(mirror_versions_mutex);
+    const Version mirror_version = request->latest_mirror_version;
+    mirror_versions[request->query_id] =
+        mirror_version == 0? database.latest_version() : mirror_version;
+    update_oldest_needed_version();
+  }
+
+  // Only the shards of the maps in the query get locked for the patch
   response->patch = rmf_traffic_ros2::convert(database.changes(query));
 }
 
+//==============================================================================
+void ScheduleNode::update_oldest_needed_version()
+{
+  // Versions are compared by their distance from the oldest version in the
+  // database, the same way the database compares them, so that this keeps
+  // working after the version numbers overflow.
+  const Version base = database.oldest_version();
+
+  // A mirror that reports version 0 does not have any entries yet, so it can
+  // be brought up to date no matter how much history has been compacted.
+  rmf_utils::optional<Version> oldest;
+  for(const auto& entry : mirror_versions)
+  {
+    const Version v = entry.second;
+    if(v != 0 && (!oldest || (v - base) < (*oldest - base)))
+      oldest = v;
+  }
+
+  // When no mirror knows about any version, none of the history is needed.
+  database.set_oldest_needed_version(
+        oldest? *oldest : database.latest_version());
+}
+
 //==============================================================================
 void ScheduleNode::wakeup_mirrors()
 {
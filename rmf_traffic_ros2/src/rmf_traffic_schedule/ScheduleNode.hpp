@@ -18,7 +18,7 @@
 #ifndef SRC__RMF_TRAFFIC_SCHEDULE__SCHEDULENODE_HPP
 #define SRC__RMF_TRAFFIC_SCHEDULE__SCHEDULENODE_HPP
 
-#include <rmf_traffic/schedule/Database.hpp>
+#include <rmf_traffic/schedule/ShardedDatabase.hpp>
 
 #include <rclcpp/node.hpp>
 
@@ -154,6 +154,11 @@ private:
   MirrorUpdateService::SharedPtr mirror_update_service;
 
 
+  void cull(rmf_traffic::Duration retention);
+
+  rclcpp::TimerBase::SharedPtr cull_timer;
+
+
   using MirrorWakeup = rmf_traffic_msgs::msg::MirrorWakeup;
   using MirrorWakeupPublisher = rclcpp::Publisher<MirrorWakeup>;
   MirrorWakeupPublisher::SharedPtr mirror_wakeup_publisher;
@@ -166,9 +171,10 @@ private:
 
   void wakeup_mirrors();
 
-  // TODO(MXG): Consider using libguarded instead of a database_mutex
-  std::mutex database_mutex;
-  rmf_traffic::schedule::Database database;
+  // Each map of the database has its own shard and lock, so the database can
+  // be used from any thread, and changes to different maps do not wait for
+  // each other.
+  rmf_traffic::schedule::ShardedDatabase database;
 
   using QueryMap =
       std::unordered_map<uint64_t, rmf_traffic::schedule::Query::Spacetime>;
@@ -177,11 +183,29 @@ private:
   std::size_t last_query_id = 0;
   QueryMap registered_queries;
 
+  // The last version that each registered mirror reported having. The oldest
+  // of these tells the database how much change history it still needs to
+  // keep.
+  using MirrorVersionMap =
+      std::unordered_map<uint64_t, rmf_traffic::schedule::Version>;
+  MirrorVersionMap mirror_versions;
+  std::mutex mirror_versions_mutex;
+
+  // Tell the database the oldest version that any mirror still needs. This
+  // gets called whenever the mirror versions change and each time the
+  // database gets culled, while mirror_versions_mutex is locked.
+  void update_oldest_needed_version();
+
   // TODO(MXG): Make this a separate node
   std::thread conflict_check_thread;
+  std::mutex conflict_check_mutex;
   std::condition_variable conflict_check_cv;
   std::atomic_bool conflict_check_quit;
 
+  // The most threads that each conflict check may use. The threads get spawned
+  // for every check, so this is kept small by default.
+  std::size_t conflict_check_threads;
+
   using Version = rmf_traffic::schedule::Version;
   struct ConflictInfo
   {
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include "src/rmf_traffic_ros2/InternRegistry.hpp"
+
+#include <rmf_traffic_msgs/msg/trajectory_profile.hpp>
+
+#include <rmf_utils/catch.hpp>
+
+#include <limits>
+
+using rmf_traffic_ros2::internal::intern_box;
+using rmf_traffic_ros2::internal::intern_circle;
+using rmf_traffic_ros2::internal::intern_profile;
+
+SCENARIO("Interning shapes and profiles")
+{
+  using rmf_traffic_msgs::msg::TrajectoryProfile;
+
+  GIVEN("Shapes with the same dimensions")
+  {
+    const auto box = intern_box(1.0, 2.0);
+    const auto circle = intern_circle(0.5);
+
+    THEN("The same shape object is returned")
+    {
+      CHECK(intern_box(1.0, 2.0) == box);
+      CHECK(intern_circle(0.5) == circle);
+    }
+
+    THEN("Different dimensions get different shapes")
+    {
+      CHECK(intern_box(2.0, 1.0) != box);
+      CHECK(intern_circle(0.25) != circle);
+      CHECK(intern_box(0.5, 0.0) != intern_circle(0.5));
+    }
+  }
+
+  GIVEN("A shape that nothing uses anymore")
+  {
+    std::weak_ptr<const rmf_traffic::geometry::FinalConvexShape> weak_box =
+        intern_box(3.0, 4.0);
+    std::weak_ptr<const rmf_traffic::geometry::FinalConvexShape> weak_circle =
+        intern_circle(3.0);
+
+    THEN("The registry does not keep it alive")
+    {
+      CHECK(weak_box.expired());
+      CHECK(weak_circle.expired());
+
+      // A new shape is made for the next request, and it gets shared again
+      const auto box = intern_box(3.0, 4.0);
+      REQUIRE(box);
+      CHECK(intern_box(3.0, 4.0) == box);
+    }
+  }
+
+  GIVEN("Dimensions that are not finite")
+  {
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    const double inf = std::numeric_limits<double>::infinity();
+
+    THEN("The shapes are made but not shared")
+    {
+      const auto nan_box = intern_box(nan, 1.0);
+      REQUIRE(nan_box);
+      CHECK(intern_box(nan, 1.0) != nan_box);
+
+      const auto inf_circle = intern_circle(inf);
+      REQUIRE(inf_circle);
+      CHECK(intern_circle(inf) != inf_circle);
+
+      // The registry still works for finite shapes afterwards
+      const auto box = intern_box(1.0, 1.0);
+      CHECK(intern_box(1.0, 1.0) == box);
+    }
+  }
+
+  GIVEN("Profiles made from interned shapes")
+  {
+    const auto shape = intern_circle(0.5);
+    const auto guided =
+        intern_profile(shape, TrajectoryProfile::GUIDED, "");
+
+    THEN("Matching profiles are shared")
+    {
+      CHECK(intern_profile(shape, TrajectoryProfile::GUIDED, "") == guided);
+      CHECK(intern_profile(shape, TrajectoryProfile::AUTONOMOUS, "")
+            != guided);
+    }
+
+    THEN("The queue ID only matters for queued profiles")
+    {
+      CHECK(intern_profile(shape, TrajectoryProfile::GUIDED, "ignored")
+            == guided);
+
+      const auto queued =
+          intern_profile(shape, TrajectoryProfile::QUEUED, "queue_a");
+      CHECK(intern_profile(shape, TrajectoryProfile::QUEUED, "queue_a")
+            == queued);
+      CHECK(intern_profile(shape, TrajectoryProfile::QUEUED, "queue_b")
+            != queued);
+    }
+
+    THEN("An unknown autonomy is rejected")
+    {
+      CHECK_THROWS_AS(
+            intern_profile(shape, 1000, ""), std::runtime_error);
+    }
+  }
+}